@@ -0,0 +1,213 @@
+--
+-- Copyright (C) 2023 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- bench provides the helpers to measure the benchmark functions.
+---
+--- assign to local
+local format = string.format
+local floor = math.floor
+local huge = math.huge
+local collectgarbage = collectgarbage
+local write = io.write
+local gettime = require('time.clock').gettime
+
+--- max amount of memory that is allocated while the garbage collector is
+--- stopped
+local MAX_ALLOC_KB = 256 * 1024
+
+--- @class bench.result
+--- @field name string
+--- @field n integer number of operations
+--- @field elapsed number seconds
+--- @field ns_op number nanoseconds per operation
+--- @field ops number operations per second
+--- @field rows_s number rows per second
+--- @field mb_s number megabytes per second
+--- @field kb_op number kilobytes allocated per operation
+--- @field gc_ms number milliseconds to collect the garbage of all operations
+
+--- run measures the function.
+--- the function is called n times with the garbage collector stopped to
+--- measure the mutator time and the allocations, and then the garbage is
+--- collected to measure the gc time.
+--- @param name string
+--- @param fn fun():(nrow:integer?, nbyte:integer?) returns number of rows and bytes processed by an operation
+--- @param n integer? number of operations (default: 1000)
+--- @return bench.result
+local function run(name, fn, n)
+    n = n or 1000
+
+    -- warmup and estimate the allocation size
+    collectgarbage('collect')
+    local kb = collectgarbage('count')
+    for _ = 1, 10 do
+        fn()
+    end
+    kb = (collectgarbage('count') - kb) / 10
+    if kb > 0 and kb * n > MAX_ALLOC_KB then
+        n = floor(MAX_ALLOC_KB / kb)
+        if n < 1 then
+            n = 1
+        end
+    end
+
+    -- measure
+    collectgarbage('collect')
+    collectgarbage('stop')
+    local nrow, nbyte = 0, 0
+    kb = collectgarbage('count')
+    local t = gettime()
+    for _ = 1, n do
+        local r, b = fn()
+        nrow = nrow + (r or 0)
+        nbyte = nbyte + (b or 0)
+    end
+    local elapsed = gettime() - t
+    kb = collectgarbage('count') - kb
+    collectgarbage('restart')
+    t = gettime()
+    collectgarbage('collect')
+    local gc = gettime() - t
+
+    if elapsed <= 0 then
+        elapsed = 1e-9
+    end
+    return {
+        name = name,
+        n = n,
+        elapsed = elapsed,
+        ns_op = elapsed / n * 1e9,
+        ops = n / elapsed,
+        rows_s = nrow / elapsed,
+        mb_s = nbyte / elapsed / (1024 * 1024),
+        kb_op = kb / n,
+        gc_ms = gc * 1000,
+    }
+end
+
+--- header prints the header of the results
+local function header()
+    write(format('%-40s %8s %12s %12s %12s %9s %10s %9s\n', 'name', 'n',
+                 'ns/op', 'ops/s', 'rows/s', 'MB/s', 'KB/op', 'gc ms'))
+end
+
+--- report prints the result
+--- @param res bench.result
+local function report(res)
+    write(format('%-40s %8d %12.0f %12.0f %12.0f %9.2f %10.2f %9.2f\n',
+                 res.name, res.n, res.ns_op, res.ops, res.rows_s, res.mb_s,
+                 res.kb_op, res.gc_ms))
+end
+
+--- compare prints the results that are slower than the baseline by the
+--- threshold ratio
+--- @param results bench.result[]
+--- @param baseline table<string, number> ns/op of the baseline by name
+--- @param ratio number? (default: 1.2)
+--- @return integer nregress
+local function compare(results, baseline, ratio)
+    ratio = ratio or 1.2
+    local nregress = 0
+    for _, res in ipairs(results) do
+        local base = baseline[res.name] or huge
+        if res.ns_op > base * ratio then
+            nregress = nregress + 1
+            write(format('REGRESSION %s: %.0f ns/op (baseline %.0f ns/op)\n',
+                         res.name, res.ns_op, base))
+        end
+    end
+    return nregress
+end
+
+--- save writes the ns/op of the results to the file as the baseline
+--- @param results bench.result[]
+--- @param pathname string
+local function save(results, pathname)
+    local f = assert(io.open(pathname, 'w'))
+    f:write('return {\n')
+    for _, res in ipairs(results) do
+        f:write(format('    [%q] = %.0f,\n', res.name, res.ns_op))
+    end
+    f:write('}\n')
+    f:close()
+end
+
+--- @class bench.benchmark
+--- @field name string
+--- @field n integer? number of operations
+--- @field setup fun():(fn:function, ctx:any) returns the function to be measured
+--- @field teardown fun(ctx:any)?
+
+--- main runs the benchmarks with the following command line arguments;
+---
+---   --baseline <file>  compare the results with the saved results, and exit
+---                      with failure if any benchmark is slower than 1.2x.
+---   --save <file>      save the results as the baseline.
+---   pattern            run only the benchmarks whose names match the pattern.
+---
+--- @param benchmarks bench.benchmark[]
+--- @param args string[]
+local function main(benchmarks, args)
+    local baseline, pathname, pattern
+    local i = 1
+    while args[i] do
+        if args[i] == '--baseline' then
+            i = i + 1
+            baseline = assert(args[i], '--baseline requires a file')
+        elseif args[i] == '--save' then
+            i = i + 1
+            pathname = assert(args[i], '--save requires a file')
+        else
+            pattern = args[i]
+        end
+        i = i + 1
+    end
+
+    local results = {}
+    header()
+    for _, b in ipairs(benchmarks) do
+        if not pattern or string.find(b.name, pattern) then
+            local fn, ctx = b.setup()
+            local res = run(b.name, fn, b.n)
+            if b.teardown then
+                b.teardown(ctx)
+            end
+            report(res)
+            results[#results + 1] = res
+        end
+    end
+
+    if pathname then
+        save(results, pathname)
+    end
+    if baseline and compare(results, assert(dofile(baseline))) > 0 then
+        os.exit(1)
+    end
+end
+
+return {
+    run = run,
+    header = header,
+    report = report,
+    compare = compare,
+    save = save,
+    main = main,
+}
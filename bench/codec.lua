@@ -0,0 +1,260 @@
+--
+-- Copyright (C) 2023 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- micro-benchmarks of the message codecs and the type decoders with the
+--- fixtures in bench/fixtures.lua.
+---
+--- usage: lua bench/codec.lua [--baseline <file>] [--save <file>] [pattern]
+---
+---   --baseline <file>  compare the results with the saved results, and exit
+---                      with failure if any benchmark is slower than 1.2x.
+---   --save <file>      save the results as the baseline.
+---   pattern            run only the benchmarks whose names match the pattern.
+---
+package.path = './bench/?.lua;' .. package.path
+local bench = require('bench')
+local fixtures = require('fixtures')
+local message = require('postgres.message')
+local unpack = require('postgres.unpack')
+local new_buffer = require('postgres.buffer').new
+local new_pack = require('postgres.pack').new
+local new_decoder = require('postgres.decoder').new
+
+local BENCHMARKS = {}
+
+--- decode_bench defines a benchmark that decodes the message
+--- @param name string
+--- @param s string
+--- @param decodefn fun(s:string):(table?, any, boolean?)
+--- @param n integer?
+local function decode_bench(name, s, decodefn, n)
+    BENCHMARKS[#BENCHMARKS + 1] = {
+        name = name,
+        n = n,
+        setup = function()
+            local nbyte = #s
+            assert(decodefn(s))
+            return function()
+                decodefn(s)
+                return 1, nbyte
+            end
+        end,
+    }
+end
+
+local decode = message.decode
+decode_bench('decode/data_row 200x32', fixtures.data_row(1, 200, 32),
+             decode.data_row, 20000)
+decode_bench('decode/data_row 64xint4', fixtures.data_row_int4(1, 64),
+             decode.data_row, 50000)
+decode_bench('decode/row_description 200', fixtures.row_description(200),
+             decode.row_description, 5000)
+decode_bench('decode/error_response', fixtures.error_response('E'),
+             decode.error_response, 50000)
+decode_bench('decode/notice_response', fixtures.error_response('N'),
+             decode.error_response, 50000)
+decode_bench('decode/bind 1000', fixtures.bind(1000, 16), decode.bind, 1000)
+
+-- decode all messages of the result set in one call
+for _, v in ipairs({
+    {
+        nrow = 1000,
+        ncol = 20,
+        width = 16,
+    },
+    {
+        nrow = 100,
+        ncol = 200,
+        width = 32,
+    },
+}) do
+    BENCHMARKS[#BENCHMARKS + 1] = {
+        name = string.format('decode_many/%dx%dx%d', v.nrow, v.ncol, v.width),
+        n = 200,
+        setup = function()
+            local s = fixtures.result_set(v.nrow, v.ncol, v.width)
+            local nbyte = #s
+            local msgs = assert(message.decode_many(s))
+            assert(#msgs == v.nrow + 3, 'unexpected number of messages')
+            return function()
+                message.decode_many(s)
+                return v.nrow, nbyte
+            end
+        end,
+    }
+end
+
+-- decode all messages of the result set lazily and read a column of each row
+BENCHMARKS[#BENCHMARKS + 1] = {
+    name = 'decode_many/lazy 1000x20x16 read 1',
+    n = 200,
+    setup = function()
+        local s = fixtures.result_set(1000, 20, 16)
+        local nbyte = #s
+        return function()
+            local msgs = message.decode_many(s, nil, nil, true)
+            for i = 2, 1001 do
+                local _ = msgs[i].values[2]
+            end
+            return 1000, nbyte
+        end
+    end,
+}
+
+-- decode all messages of the result set from the receive buffer
+BENCHMARKS[#BENCHMARKS + 1] = {
+    name = 'decode_many/buffer 1000x20x16',
+    n = 200,
+    setup = function()
+        local s = fixtures.result_set(1000, 20, 16)
+        local nbyte = #s
+        local buf = new_buffer()
+        return function()
+            buf:write(s)
+            local _, pos = message.decode_many(buf)
+            buf:consume(pos - 1)
+            return 1000, nbyte
+        end
+    end,
+}
+
+-- unpack the header fields of the Bind message
+BENCHMARKS[#BENCHMARKS + 1] = {
+    name = 'unpack/bind header',
+    n = 100000,
+    setup = function()
+        local s = fixtures.bind(8, 16)
+        local v = {}
+        assert(unpack(v, 'b1Lsshh*', s))
+        return function()
+            unpack(v, 'b1Lsshh*', s)
+            return 1, #s
+        end
+    end,
+}
+
+--- encode_bench defines a benchmark that encodes the message
+--- @param name string
+--- @param encodefn fun():string
+--- @param n integer?
+local function encode_bench(name, encodefn, n)
+    BENCHMARKS[#BENCHMARKS + 1] = {
+        name = name,
+        n = n,
+        setup = function()
+            local nbyte = #assert(encodefn())
+            return function()
+                encodefn()
+                return 1, nbyte
+            end
+        end,
+    }
+end
+
+local encode = message.encode
+do
+    local values = fixtures.values(1000, 16)
+    encode_bench('encode/bind 1000', function()
+        return encode.bind('portal', 'stmt', values)
+    end, 1000)
+    local values10 = fixtures.values(10, 16)
+    encode_bench('encode/bind 10', function()
+        return encode.bind('', 'stmt', values10)
+    end, 50000)
+    local sql = 'SELECT * FROM bench WHERE id = $1 AND name = $2'
+    local oids = {
+        23,
+        25,
+    }
+    encode_bench('encode/parse', function()
+        return encode.parse('stmt', sql, oids)
+    end, 50000)
+    encode_bench('encode/query', function()
+        return encode.query(sql)
+    end, 50000)
+
+    -- all messages of an extended query written into a single pack
+    local write = message.write
+    local p = new_pack()
+    encode_bench('encode/extended_query batch', function()
+        p:clear()
+        write.parse(p, '', sql, oids)
+        write.bind(p, '', '', values10)
+        write.describe(p, 'portal', '')
+        write.execute(p, '')
+        write.close(p, 'statement', '')
+        write.sync(p)
+        return p:data()
+    end, 50000)
+end
+
+-- decode the text format values by type oid
+local decoder = new_decoder()
+for _, corpus in ipairs(fixtures.CORPORA) do
+    local oid, values = corpus.oid, corpus.values
+    BENCHMARKS[#BENCHMARKS + 1] = {
+        name = 'decode_by_oid/' .. corpus.name,
+        n = 20000,
+        setup = function()
+            local nbyte = 0
+            for _, s in ipairs(values) do
+                local _, err = decoder:decode_by_oid(oid, s)
+                assert(not err, err)
+                nbyte = nbyte + #s
+            end
+            return function()
+                for i = 1, #values do
+                    decoder:decode_by_oid(oid, values[i])
+                end
+                return #values, nbyte
+            end
+        end,
+    }
+end
+
+-- decode the binary format values by type oid
+for _, corpus in ipairs(fixtures.BINARY_CORPORA) do
+    local field = {
+        type_oid = corpus.oid,
+        format = 'binary',
+    }
+    local values = corpus.values
+    BENCHMARKS[#BENCHMARKS + 1] = {
+        name = 'decode_by_field/binary ' .. corpus.name,
+        n = 20000,
+        setup = function()
+            local nbyte = 0
+            for _, s in ipairs(values) do
+                local _, err = decoder:decode_by_field(field, s)
+                assert(not err, err)
+                nbyte = nbyte + #s
+            end
+            return function()
+                for i = 1, #values do
+                    decoder:decode_by_field(field, values[i])
+                end
+                return #values, nbyte
+            end
+        end,
+    }
+end
+
+bench.main(BENCHMARKS, arg)
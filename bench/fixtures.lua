@@ -0,0 +1,501 @@
+--
+-- Copyright (C) 2023 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- fixtures provides the wire messages and the per-type value corpora that
+--- are used by the codec benchmarks.
+--- all fixtures are built deterministically from the constants in this file,
+--- so the results are comparable across commits.
+---
+--- assign to local
+local concat = table.concat
+local format = string.format
+local rep = string.rep
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+
+--- msg returns a message with the type and the length header
+--- @param typ string
+--- @param body string
+--- @return string
+local function msg(typ, body)
+    return typ .. htonl(#body + 4) .. body
+end
+
+--- value returns a deterministic text value of the column
+--- @param row integer
+--- @param col integer
+--- @param width integer
+--- @return string
+local function value(row, col, width)
+    local s = format('%d:%d:', row, col)
+    return s .. rep('x', width - #s)
+end
+
+local OIDS = {
+    23, -- integer
+    25, -- text
+    20, -- bigint
+    701, -- double precision
+    16, -- boolean
+    1114, -- timestamp without time zone
+    1043, -- character varying
+    2950, -- uuid
+}
+
+--- row_description returns a RowDescription message
+--- @param ncol integer
+--- @return string
+local function row_description(ncol)
+    local list = {
+        htons(ncol),
+    }
+    for i = 1, ncol do
+        list[#list + 1] = concat({
+            format('column_name_%04d\0', i),
+            htonl(16384), -- table oid
+            htons(i), -- column attribute number
+            htonl(OIDS[(i - 1) % #OIDS + 1]),
+            htons(-1), -- type size
+            htonl(-1), -- type modifier
+            htons(0), -- text format
+        })
+    end
+    return msg('T', concat(list))
+end
+
+--- data_row returns a DataRow message that every 10th column is NULL
+--- @param row integer
+--- @param ncol integer
+--- @param width integer
+--- @return string
+local function data_row(row, ncol, width)
+    local list = {
+        htons(ncol),
+    }
+    for i = 1, ncol do
+        if i % 10 == 0 then
+            list[#list + 1] = htonl(-1)
+        else
+            local v = value(row, i, width)
+            list[#list + 1] = htonl(#v) .. v
+        end
+    end
+    return msg('D', concat(list))
+end
+
+--- data_row_int4 returns a DataRow message of the binary format integers
+--- @param row integer
+--- @param ncol integer
+--- @return string
+local function data_row_int4(row, ncol)
+    local list = {
+        htons(ncol),
+    }
+    for i = 1, ncol do
+        list[#list + 1] = htonl(4) .. htonl(row * i)
+    end
+    return msg('D', concat(list))
+end
+
+--- error_response returns an ErrorResponse or NoticeResponse message that
+--- has all the fields sent by the server
+--- @param typ string 'E' or 'N'
+--- @return string
+local function error_response(typ)
+    return msg(typ, concat({
+        'SERROR\0',
+        'VERROR\0',
+        'C23505\0',
+        'Mduplicate key value violates unique constraint "bench_pkey"\0',
+        'DKey (id)=(12345) already exists.\0',
+        'HCheck the values of the key columns.\0',
+        'P42\0',
+        'p7\0',
+        'qSELECT id FROM bench WHERE id = 12345\0',
+        'WPL/pgSQL function bench_insert() line 3 at SQL statement\0',
+        'spublic\0',
+        'tbench\0',
+        'cid\0',
+        'dinteger\0',
+        'nbench_pkey\0',
+        'Fnbtinsert.c\0',
+        'L664\0',
+        'R_bt_check_unique\0',
+        '\0',
+    }))
+end
+
+--- bind returns a Bind message with the text format parameters
+--- @param nparam integer
+--- @param width integer
+--- @return string
+local function bind(nparam, width)
+    local list = {
+        'portal\0',
+        'stmt\0',
+        htons(0), -- all parameters are text format
+        htons(nparam),
+    }
+    for i = 1, nparam do
+        local v = value(1, i, width)
+        list[#list + 1] = htonl(#v) .. v
+    end
+    list[#list + 1] = htons(0) -- all result columns are text format
+    return msg('B', concat(list))
+end
+
+--- result_set returns the response messages of a query;
+--- RowDescription, DataRows, CommandComplete and ReadyForQuery.
+--- @param nrow integer
+--- @param ncol integer
+--- @param width integer
+--- @return string
+local function result_set(nrow, ncol, width)
+    local list = {
+        row_description(ncol),
+    }
+    for i = 1, nrow do
+        list[#list + 1] = data_row(i, ncol, width)
+    end
+    list[#list + 1] = msg('C', format('SELECT %d\0', nrow))
+    list[#list + 1] = msg('Z', 'I')
+    return concat(list)
+end
+
+--- values returns the list of the bind parameter values
+--- @param nparam integer
+--- @param width integer
+--- @return string[]
+local function values(nparam, width)
+    local list = {}
+    for i = 1, nparam do
+        list[i] = value(1, i, width)
+    end
+    return list
+end
+
+--- array returns a text format array of the values that are generated by the
+--- function
+--- @param n integer
+--- @param fn fun(i:integer):string
+--- @return string
+local function array(n, fn)
+    local list = {}
+    for i = 1, n do
+        list[i] = fn(i)
+    end
+    return '{' .. concat(list, ',') .. '}'
+end
+
+--- text format values of each type oid
+local CORPORA = {
+    {
+        oid = 16,
+        name = 'boolean',
+        values = {
+            't',
+            'f',
+        },
+    },
+    {
+        oid = 21,
+        name = 'smallint',
+        values = {
+            '0',
+            '-32768',
+            '32767',
+        },
+    },
+    {
+        oid = 23,
+        name = 'integer',
+        values = {
+            '0',
+            '-2147483648',
+            '2147483647',
+        },
+    },
+    {
+        oid = 20,
+        name = 'bigint',
+        values = {
+            '0',
+            '-9007199254740991',
+            '9007199254740991',
+        },
+    },
+    {
+        oid = 701,
+        name = 'double precision',
+        values = {
+            '0',
+            '3.141592653589793',
+            '-1.7976931348623157e+308',
+        },
+    },
+    {
+        oid = 1700,
+        name = 'numeric',
+        values = {
+            '0',
+            '12345.6789',
+            '-0.000000001',
+        },
+    },
+    {
+        oid = 25,
+        name = 'text',
+        values = {
+            '',
+            rep('x', 64),
+        },
+    },
+    {
+        oid = 17,
+        name = 'bytea',
+        values = {
+            '\\x' .. rep('0123456789abcdef', 8),
+        },
+    },
+    {
+        oid = 2950,
+        name = 'uuid',
+        values = {
+            'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11',
+        },
+    },
+    {
+        oid = 1082,
+        name = 'date',
+        values = {
+            '2023-04-01',
+            '1999-12-31',
+        },
+    },
+    {
+        oid = 1083,
+        name = 'time',
+        values = {
+            '12:34:56',
+            '23:59:59.999999',
+        },
+    },
+    {
+        oid = 1266,
+        name = 'timetz',
+        values = {
+            '12:34:56+09',
+            '23:59:59.999999-05:30',
+        },
+    },
+    {
+        oid = 1114,
+        name = 'timestamp',
+        values = {
+            '2023-04-01 12:34:56',
+            '2023-04-01 12:34:56.789012',
+        },
+    },
+    {
+        oid = 1184,
+        name = 'timestamptz',
+        values = {
+            '2023-04-01 12:34:56+09',
+            '2023-04-01 12:34:56.789012-05:30',
+        },
+    },
+    {
+        oid = 1186,
+        name = 'interval',
+        values = {
+            '1 year 2 mons 3 days 04:05:06.789',
+            '-00:00:01',
+        },
+    },
+    {
+        oid = 3802,
+        name = 'jsonb',
+        values = {
+            '{"id": 12345, "name": "bench", "tags": ["a", "b", "c"]}',
+        },
+    },
+    {
+        oid = 869,
+        name = 'inet',
+        values = {
+            '192.168.0.1/24',
+            '2001:db8::1',
+        },
+    },
+    {
+        oid = 600,
+        name = 'point',
+        values = {
+            '(1.5,-2.5)',
+        },
+    },
+    {
+        oid = 604,
+        name = 'polygon',
+        values = {
+            '((0,0),(0,1),(1,1),(1,0))',
+        },
+    },
+    {
+        oid = 3904,
+        name = 'int4range',
+        values = {
+            '[1,100)',
+        },
+    },
+    {
+        oid = 3908,
+        name = 'tsrange',
+        values = {
+            '["2023-04-01 00:00:00","2023-04-02 00:00:00")',
+        },
+    },
+    {
+        oid = 1007,
+        name = 'integer[]',
+        values = {
+            array(100, function(i)
+                return tostring(i * 7919)
+            end),
+        },
+    },
+    {
+        oid = 1022,
+        name = 'double precision[]',
+        values = {
+            array(100, function(i)
+                return tostring(i / 7)
+            end),
+        },
+    },
+    {
+        oid = 1009,
+        name = 'text[]',
+        values = {
+            array(100, function(i)
+                if i % 10 == 0 then
+                    return 'NULL'
+                elseif i % 2 == 0 then
+                    return format('"quoted \\"value\\" %d"', i)
+                end
+                return format('value%d', i)
+            end),
+        },
+    },
+    {
+        oid = 1115,
+        name = 'timestamp[]',
+        values = {
+            array(20, function(i)
+                return format('"2023-04-%02d 12:34:56.789"', i)
+            end),
+        },
+    },
+}
+
+--- binary format values of each type oid
+local BINARY_CORPORA = {
+    {
+        oid = 16,
+        name = 'boolean',
+        values = {
+            '\1',
+        },
+    },
+    {
+        oid = 23,
+        name = 'integer',
+        values = {
+            htonl(-2147483648),
+        },
+    },
+    {
+        oid = 20,
+        name = 'bigint',
+        values = {
+            htonl(2097151) .. htonl(-1),
+        },
+    },
+    {
+        oid = 701,
+        name = 'double precision',
+        values = {
+            '\64\9\33\251\84\68\45\24',
+        },
+    },
+    {
+        oid = 1082,
+        name = 'date',
+        values = {
+            htonl(8491),
+        },
+    },
+    {
+        oid = 1114,
+        name = 'timestamp',
+        values = {
+            htonl(170770) .. htonl(-1536118000),
+        },
+    },
+    {
+        oid = 2950,
+        name = 'uuid',
+        values = {
+            '\160\238\188\153\156\11\78\248\187\109\107\185\189\56\10\17',
+        },
+    },
+    {
+        oid = 1007,
+        name = 'integer[]',
+        values = {
+            (function()
+                local list = {
+                    htonl(1), -- number of dimensions
+                    htonl(0), -- has no NULL
+                    htonl(23), -- element type oid
+                    htonl(100), -- size of dimension
+                    htonl(1), -- lower bound
+                }
+                for i = 1, 100 do
+                    list[#list + 1] = htonl(4) .. htonl(i * 7919)
+                end
+                return concat(list)
+            end)(),
+        },
+    },
+}
+
+return {
+    row_description = row_description,
+    data_row = data_row,
+    data_row_int4 = data_row_int4,
+    error_response = error_response,
+    bind = bind,
+    result_set = result_set,
+    values = values,
+    CORPORA = CORPORA,
+    BINARY_CORPORA = BINARY_CORPORA,
+}
@@ -0,0 +1,737 @@
+--
+-- Copyright (C) 2023 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- mockpg is a scriptable fake PostgreSQL backend that speaks the subset of
+--- the frontend/backend protocol v3 required by the benchmarks.
+--- install() replaces the net.stream.inet and net.stream.unix clients with an
+--- in-process socket that is connected to a new backend, so it must be called
+--- before the postgres modules are loaded.
+---
+--- the following queries are answered by the built-in result generator;
+---
+---   bench rows=<N> cols=<M> width=<W> type=<text|int4>
+---
+--- each row has M columns of W characters. other queries are passed to the
+--- handler function if specified.
+---
+--- assign to local
+local byte = string.byte
+local find = string.find
+local format = string.format
+local match = string.match
+local rep = string.rep
+local sub = string.sub
+local concat = table.concat
+local tonumber = tonumber
+local tostring = tostring
+local type = type
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local ntohl = require('postgres.ntohl')
+local ntohs = require('postgres.ntohs')
+local md5pswd = require('postgres.md5pswd')
+local strxor = require('postgres.strxor')
+local encode_authentication = require('postgres.message').encode.authentication
+local random = require('string.random')
+local hmac_sha256 = require('hmac').sha256
+local encode_base64 = require('base64mix').encode
+local decode_base64 = require('base64mix').decode
+
+--- constants
+local NULL = '\0'
+local OID_INT4 = 23
+local OID_TEXT = 25
+local SCRAM_ITERATIONS = 4096
+--- salt of the SCRAM secret that is stored per role by the server
+local SCRAM_SALTS = {}
+
+--- msg encodes a backend message
+--- @param typ string
+--- @param body string
+--- @return string
+local function msg(typ, body)
+    return typ .. htonl(#body + 4) .. body
+end
+
+--- do_hmac_sha256
+--- @param key string?
+--- @param data string
+--- @return string
+local function do_hmac_sha256(key, data)
+    local ctx = hmac_sha256(key)
+    ctx:update(data)
+    return ctx:final(true)
+end
+
+--- salted passwords are cached by password and salt to measure only the cost
+--- of the client
+--- @type table<string, string>
+local SALTED_PASSWORDS = {}
+
+--- salted_password
+--- @param password string
+--- @param salt string
+--- @return string
+local function salted_password(password, salt)
+    local key = password .. NULL .. salt
+    local res = SALTED_PASSWORDS[key]
+    if not res then
+        local block = do_hmac_sha256(password, salt .. '\0\0\0\1')
+        res = block
+        for _ = 2, SCRAM_ITERATIONS do
+            block = do_hmac_sha256(password, block)
+            res = strxor(res, block)
+        end
+        SALTED_PASSWORDS[key] = res
+    end
+    return res
+end
+
+--- @class mockpg.result
+--- @field fields? table[] list of {name, oid}
+--- @field rows? table[] list of column values
+--- @field tag? string command tag
+--- @field error? string error message
+
+--- @type table<string, mockpg.result>
+local GENERATED = {}
+
+--- generate returns the synthetic result of the bench query
+--- @param sql string
+--- @return mockpg.result?
+local function generate(sql)
+    local res = GENERATED[sql]
+    if res then
+        return res
+    elseif not find(sql, '^bench ') then
+        return nil
+    end
+
+    local nrow = tonumber(match(sql, 'rows=(%d+)') or 1)
+    local ncol = tonumber(match(sql, 'cols=(%d+)') or 1)
+    local width = tonumber(match(sql, 'width=(%d+)') or 8)
+    local oid = match(sql, 'type=int4') and OID_INT4 or OID_TEXT
+    if oid == OID_INT4 and width > 9 then
+        width = 9
+    end
+
+    local fields = {}
+    local row = {}
+    for i = 1, ncol do
+        fields[i] = {
+            name = 'c' .. i,
+            oid = oid,
+        }
+        row[i] = sub(rep(tostring(i % 10), width), 1, width)
+    end
+    local rows = {}
+    for i = 1, nrow do
+        rows[i] = row
+    end
+    res = {
+        fields = fields,
+        rows = rows,
+        tag = 'SELECT ' .. nrow,
+    }
+    GENERATED[sql] = res
+    return res
+end
+
+--- encode_row_description
+--- @param fields table[]
+--- @param formats integer[]?
+--- @return string
+local function encode_row_description(fields, formats)
+    local list = {
+        htons(#fields),
+    }
+    for i, field in ipairs(fields) do
+        local fmt = 0
+        if formats and #formats > 0 then
+            fmt = formats[i] or formats[1]
+        end
+        list[#list + 1] = concat({
+            field.name,
+            NULL,
+            htonl(0), -- table oid
+            htons(0), -- column attribute number
+            htonl(field.oid),
+            htons(-1), -- type size
+            htonl(-1), -- type modifier
+            htons(fmt),
+        })
+    end
+    return msg('T', concat(list))
+end
+
+--- encode_data_row
+--- @param fields table[]
+--- @param row table
+--- @param formats integer[]?
+--- @return string
+local function encode_data_row(fields, row, formats)
+    local list = {
+        htons(#fields),
+    }
+    for i = 1, #fields do
+        local v = row[i]
+        if v == nil then
+            list[#list + 1] = htonl(-1)
+        else
+            local fmt = 0
+            if formats and #formats > 0 then
+                fmt = formats[i] or formats[1]
+            end
+            if fmt == 1 and fields[i].oid == OID_INT4 then
+                v = htonl(tonumber(v))
+            end
+            list[#list + 1] = htonl(#v) .. v
+        end
+    end
+    return msg('D', concat(list))
+end
+
+--- @class mockpg.portal
+--- @field res mockpg.result
+--- @field formats integer[]
+--- @field pos integer number of rows already sent
+--- @field datarow string? encoded DataRow if all rows are the same
+
+--- @class mockpg.backend
+--- @field auth string 'trust', 'md5' or 'scram'
+--- @field user string
+--- @field password string
+--- @field handler? fun(sql:string, params:table):mockpg.result?
+--- @field out string[] pending output
+--- @field inbuf string
+--- @field state string
+--- @field stmts table<string, string>
+--- @field portals table<string, mockpg.portal>
+--- @field failed boolean
+--- @field closed boolean
+local Backend = {}
+Backend.__index = Backend
+
+--- new_backend
+--- @param opts table?
+--- @return mockpg.backend
+local function new_backend(opts)
+    opts = opts or {}
+    return setmetatable({
+        auth = opts.auth or 'trust',
+        password = opts.password or 'secret',
+        handler = opts.handler,
+        out = {},
+        inbuf = '',
+        state = 'startup',
+        stmts = {},
+        portals = {},
+        failed = false,
+        closed = false,
+    }, Backend)
+end
+
+--- emit
+--- @param s string
+function Backend:emit(s)
+    self.out[#self.out + 1] = s
+end
+
+--- error
+--- @param message string
+--- @param code string?
+function Backend:error(message, code)
+    self:emit(msg('E', concat({
+        'SERROR',
+        NULL,
+        'C',
+        code or '42000',
+        NULL,
+        'M',
+        message,
+        NULL,
+        NULL,
+    })))
+end
+
+--- ready
+function Backend:ready()
+    self:emit(msg('Z', 'I'))
+end
+
+--- authenticated
+function Backend:authenticated()
+    self:emit(encode_authentication('AuthenticationOk'))
+    self:emit(msg('S', 'server_version' .. NULL .. '16.0' .. NULL))
+    self:emit(msg('S', 'client_encoding' .. NULL .. 'UTF8' .. NULL))
+    self:emit(msg('K', htonl(1234) .. htonl(5678)))
+    self:ready()
+    self.state = 'ready'
+end
+
+--- startup
+--- @param body string
+function Backend:startup(body)
+    local params = {}
+    local pos = 5
+    while true do
+        local head, tail = find(body, NULL, pos, true)
+        if not head or head == pos then
+            break
+        end
+        local k = sub(body, pos, head - 1)
+        local vhead = find(body, NULL, tail + 1, true)
+        params[k] = sub(body, tail + 1, vhead - 1)
+        pos = vhead + 1
+    end
+    self.user = params.user or ''
+
+    if self.auth == 'md5' then
+        self.salt = random(4)
+        self.state = 'md5'
+        self:emit(encode_authentication('AuthenticationMD5Password', self.salt))
+    elseif self.auth == 'scram' then
+        self.state = 'sasl_initial'
+        self:emit(encode_authentication('AuthenticationSASL', 'SCRAM-SHA-256'))
+    else
+        self:authenticated()
+    end
+end
+
+--- password handles PasswordMessage, SASLInitialResponse and SASLResponse
+--- @param body string
+function Backend:password_message(body)
+    if self.state == 'md5' then
+        local pswd = sub(body, 1, -2)
+        if pswd ~= 'md5' .. md5pswd(self.password, self.user, self.salt) then
+            self:error('password authentication failed', '28P01')
+            self.closed = true
+            return
+        end
+        return self:authenticated()
+    elseif self.state == 'sasl_initial' then
+        -- mechanism name, Int32 length, client-first-message
+        local head = find(body, NULL, 1, true)
+        local data = sub(body, head + 5)
+        local bare = match(data, '^n,,(.+)$')
+        local cnonce = match(bare or '', 'r=([^,]+)')
+        local salt = SCRAM_SALTS[self.user]
+        if not salt then
+            salt = random(16)
+            SCRAM_SALTS[self.user] = salt
+        end
+        self.salt = salt
+        self.nonce = cnonce .. encode_base64(random(18))
+        self.client_first_bare = bare
+        self.server_first = format('r=%s,s=%s,i=%d', self.nonce,
+                                   encode_base64(self.salt), SCRAM_ITERATIONS)
+        self.state = 'sasl_response'
+        self:emit(encode_authentication('AuthenticationSASLContinue',
+                                        self.server_first))
+        return
+    end
+
+    -- SASLResponse with client-final-message
+    local without_proof, proof = match(body, '^(.+),p=(.+)$')
+    local auth_message = concat({
+        self.client_first_bare,
+        self.server_first,
+        without_proof,
+    }, ',')
+    local spassword = salted_password(self.password, self.salt)
+    local client_key = do_hmac_sha256(spassword, 'Client Key')
+    local stored_key = do_hmac_sha256(nil, client_key)
+    local signature = do_hmac_sha256(stored_key, auth_message)
+    if strxor(client_key, signature) ~= decode_base64(proof) then
+        self:error('password authentication failed', '28P01')
+        self.closed = true
+        return
+    end
+    local server_key = do_hmac_sha256(spassword, 'Server Key')
+    self:emit(encode_authentication('AuthenticationSASLFinal', 'v=' ..
+                                        encode_base64(
+                                            do_hmac_sha256(server_key,
+                                                           auth_message))))
+    self:authenticated()
+end
+
+--- run returns the result of the query
+--- @param sql string
+--- @param params table
+--- @return mockpg.result
+function Backend:run(sql, params)
+    local res = generate(sql)
+    if res then
+        return res
+    elseif self.handler then
+        res = self.handler(sql, params)
+        if res then
+            return res
+        end
+    end
+
+    if match(sql, '^%s*$') then
+        return {}
+    end
+    return {
+        tag = match(sql, '^%s*(%a+)') or 'OK',
+    }
+end
+
+--- result emits the result of the query
+--- @param res mockpg.result
+--- @param formats integer[]?
+--- @param describe boolean emit RowDescription
+function Backend:result(res, formats, describe)
+    if res.error then
+        self:error(res.error)
+        return false
+    elseif res.fields then
+        if describe then
+            self:emit(encode_row_description(res.fields, formats))
+        end
+        self:data_rows(res, formats, 1, #res.rows)
+    elseif not res.tag then
+        self:emit(msg('I', ''))
+        return true
+    end
+    self:emit(msg('C', res.tag .. NULL))
+    return true
+end
+
+--- data_rows emits the DataRow messages of the result.
+--- the encoded message is reused while the rows are the same table.
+--- @param res mockpg.result
+--- @param formats integer[]?
+--- @param first integer
+--- @param last integer
+function Backend:data_rows(res, formats, first, last)
+    local fields = res.fields
+    local rows = res.rows
+    local prev, datarow
+    for i = first, last do
+        local row = rows[i]
+        if row ~= prev then
+            prev = row
+            datarow = encode_data_row(fields, row, formats)
+        end
+        self:emit(datarow)
+    end
+end
+
+--- simple_query
+--- @param sql string
+function Backend:simple_query(sql)
+    self:result(self:run(sql, {}), nil, true)
+    self:ready()
+end
+
+--- parse
+--- @param body string
+function Backend:parse(body)
+    local head = find(body, NULL, 1, true)
+    local name = sub(body, 1, head - 1)
+    local tail = find(body, NULL, head + 1, true)
+    self.stmts[name] = sub(body, head + 1, tail - 1)
+    self:emit(msg('1', ''))
+end
+
+--- bind
+--- @param body string
+function Backend:bind(body)
+    local head = find(body, NULL, 1, true)
+    local portal = sub(body, 1, head - 1)
+    local tail = find(body, NULL, head + 1, true)
+    local sql = self.stmts[sub(body, head + 1, tail - 1)]
+    if not sql then
+        self.failed = true
+        return self:error('prepared statement does not exist', '26000')
+    end
+
+    -- skip parameter format codes
+    local pos = tail + 1
+    pos = pos + 2 + ntohs(sub(body, pos, pos + 1)) * 2
+    -- parameter values
+    local params = {}
+    local nparam = ntohs(sub(body, pos, pos + 1))
+    pos = pos + 2
+    for i = 1, nparam do
+        local len = ntohl(sub(body, pos, pos + 3))
+        pos = pos + 4
+        if len >= 0 then
+            params[i] = sub(body, pos, pos + len - 1)
+            pos = pos + len
+        end
+    end
+    -- result format codes
+    local formats = {}
+    local nformat = ntohs(sub(body, pos, pos + 1))
+    pos = pos + 2
+    for i = 1, nformat do
+        formats[i] = ntohs(sub(body, pos, pos + 1))
+        pos = pos + 2
+    end
+
+    local res = self:run(sql, params)
+    if res.error then
+        self.failed = true
+        return self:error(res.error)
+    end
+    self.portals[portal] = {
+        res = res,
+        formats = formats,
+        pos = 0,
+    }
+    self:emit(msg('2', ''))
+end
+
+--- describe
+--- @param body string
+function Backend:describe(body)
+    local name = sub(body, 2, -2)
+    if byte(body, 1) == byte('S') then
+        local sql = self.stmts[name]
+        if not sql then
+            self.failed = true
+            return self:error('prepared statement does not exist', '26000')
+        end
+        local np = 0
+        for _ in string.gmatch(sql, '%$%d+') do
+            np = np + 1
+        end
+        local list = {
+            htons(np),
+        }
+        for i = 1, np do
+            list[i + 1] = htonl(OID_TEXT)
+        end
+        self:emit(msg('t', concat(list)))
+        local res = self:run(sql, {})
+        if res.fields then
+            return self:emit(encode_row_description(res.fields))
+        end
+        return self:emit(msg('n', ''))
+    end
+
+    local portal = self.portals[name]
+    if portal.res.fields then
+        return self:emit(encode_row_description(portal.res.fields,
+                                                portal.formats))
+    end
+    self:emit(msg('n', ''))
+end
+
+--- execute
+--- @param body string
+function Backend:execute(body)
+    local head = find(body, NULL, 1, true)
+    local portal = self.portals[sub(body, 1, head - 1)]
+    local max_rows = ntohl(sub(body, head + 1, head + 4))
+    local res = portal.res
+    if not res.fields then
+        return self:result(res)
+    end
+
+    local rows = res.rows
+    local last = #rows
+    if max_rows > 0 and portal.pos + max_rows < last then
+        last = portal.pos + max_rows
+    end
+    self:data_rows(res, portal.formats, portal.pos + 1, last)
+    portal.pos = last
+    if last < #rows then
+        return self:emit(msg('s', ''))
+    end
+    self:emit(msg('C', res.tag .. NULL))
+end
+
+--- handle
+--- @param typ string
+--- @param body string
+function Backend:handle(typ, body)
+    if typ == 'X' then
+        self.closed = true
+    elseif typ == 'p' then
+        self:password_message(body)
+    elseif typ == 'Q' then
+        self:simple_query(sub(body, 1, -2))
+    elseif typ == 'S' then
+        self.failed = false
+        self:ready()
+    elseif typ == 'H' then
+        -- flush
+        return
+    elseif self.failed then
+        -- discard messages until Sync
+        return
+    elseif typ == 'P' then
+        self:parse(body)
+    elseif typ == 'B' then
+        self:bind(body)
+    elseif typ == 'D' then
+        self:describe(body)
+    elseif typ == 'E' then
+        self:execute(body)
+    elseif typ == 'C' then
+        if byte(body, 1) == byte('S') then
+            self.stmts[sub(body, 2, -2)] = nil
+        else
+            self.portals[sub(body, 2, -2)] = nil
+        end
+        self:emit(msg('3', ''))
+    else
+        self:error(format('unsupported message type %q', typ), '08P01')
+    end
+end
+
+--- feed processes the data sent by the client
+--- @param s string
+function Backend:feed(s)
+    local buf = self.inbuf .. s
+    local pos = 1
+    local len = #buf
+    while not self.closed do
+        if self.state == 'startup' then
+            if len - pos + 1 < 4 then
+                break
+            end
+            local mlen = ntohl(sub(buf, pos, pos + 3))
+            if len - pos + 1 < mlen then
+                break
+            end
+            self:startup(sub(buf, pos + 4, pos + mlen - 1))
+            pos = pos + mlen
+        else
+            if len - pos + 1 < 5 then
+                break
+            end
+            local mlen = ntohl(sub(buf, pos + 1, pos + 4))
+            if len - pos < mlen then
+                break
+            end
+            self:handle(sub(buf, pos, pos), sub(buf, pos + 5, pos + mlen))
+            pos = pos + mlen + 1
+        end
+    end
+    self.inbuf = sub(buf, pos)
+end
+
+--- @class mockpg.socket
+--- @field backend mockpg.backend
+--- @field chunk integer max size of the data returned by recv
+--- @field pending string
+local Socket = {}
+Socket.__index = Socket
+
+--- send
+--- @param s string
+--- @return integer? len
+--- @return any err
+function Socket:send(s)
+    if self.backend.closed then
+        return nil, 'connection closed by peer'
+    end
+    self.backend:feed(s)
+    return #s
+end
+
+--- recv
+--- @return string? s
+--- @return any err
+--- @return boolean? timeout
+function Socket:recv()
+    local s = self.pending
+    local out = self.backend.out
+    if #out > 0 then
+        s = s .. concat(out)
+        self.backend.out = {}
+    end
+
+    if #s == 0 then
+        if self.backend.closed then
+            return nil
+        end
+        -- no response will be sent
+        return nil, nil, true
+    elseif #s > self.chunk then
+        self.pending = sub(s, self.chunk + 1)
+        return sub(s, 1, self.chunk)
+    end
+    self.pending = ''
+    return s
+end
+
+function Socket:close()
+    self.backend.closed = true
+    return true
+end
+
+function Socket:fd()
+    return -1
+end
+
+function Socket:nonblock()
+    return true
+end
+
+function Socket:rcvtimeo()
+    return 0
+end
+
+function Socket:sndtimeo()
+    return 0
+end
+
+--- install replaces the net.stream.inet client with the mock backend.
+--- the returned options table is referred at each connection, so it can be
+--- modified to change the behavior of the subsequent connections.
+--- @param opts table?
+---| 'auth' 'trust', 'md5' or 'scram' (default: 'trust')
+---| 'password' password to be verified (default: 'secret')
+---| 'chunk' max size of the data returned by recv (default: 65536)
+---| 'handler' fun(sql:string, params:table):mockpg.result?
+--- @return table opts
+local function install(opts)
+    opts = opts or {}
+    assert(type(opts) == 'table', 'opts must be table or nil')
+    local client = {
+        new = function()
+            return setmetatable({
+                backend = new_backend(opts),
+                chunk = opts.chunk or 65536,
+                pending = '',
+            }, Socket)
+        end,
+    }
+    -- connections to the unix domain socket are served by the same backend
+    package.loaded['net.stream.inet'] = {
+        client = client,
+    }
+    package.loaded['net.stream.unix'] = {
+        client = client,
+    }
+    return opts
+end
+
+return {
+    install = install,
+    new_backend = new_backend,
+}
@@ -23,6 +23,7 @@
 local type = type
 local errorf = require('error').format
 local new_inet_client = require('net.stream.inet').client.new
+local new_unix_client = require('net.stream.unix').client.new
 local parse_conninfo = require('postgres.conninfo')
 local encode_cancel_request = require('postgres.message').encode.cancel_request
 local decode_message = require('postgres.message').decode
@@ -33,18 +34,21 @@ local decode_message = require('postgres.message').decode
 --- @field params table
 --- @field pid integer process ID of the target backend
 --- @field key integer secret key for the target backend
+--- @field host postgres.conninfo.host? host of the target backend
 local Canceler = {}
 
 --- init
 --- @param conninfo string
 --- @param pid integer process ID of the target backend
 --- @param key integer secret key for the target backend
+--- @param host? postgres.conninfo.host host of the target backend (default: first host of conninfo)
 --- @return postgres.cancel
 --- @return any err
-function Canceler:init(conninfo, pid, key)
+function Canceler:init(conninfo, pid, key, host)
     assert(type(conninfo) == 'string', 'conninfo must be string')
     assert(type(pid) == 'number', 'pid must be integer')
     assert(type(key) == 'number', 'key must be integer')
+    assert(host == nil or type(host) == 'table', 'host must be table or nil')
 
     -- parse conninfo
     local uri, err
@@ -56,6 +60,12 @@ function Canceler:init(conninfo, pid, key)
     self.uri = uri
     self.pid = pid
     self.key = key
+    self.host = host or {
+        host = uri.host,
+        port = uri.port,
+        hostaddr = uri.params.hostaddr,
+        socket = uri.socket,
+    }
     self.msg = encode_cancel_request(pid, key)
     return self
 end
@@ -66,10 +76,18 @@ end
 --- @return boolean? timeout
 function Canceler:cancel()
     -- connect to server
-    local host = self.uri.params.hostaddr or self.uri.host
-    local sock, err, timeout = new_inet_client(host, self.uri.port, {
-        deadline = self.uri.params.connect_timeout,
-    })
+    local host = self.host
+    local sock, err, timeout
+    if host.socket then
+        sock, err, timeout = new_unix_client(host.socket, {
+            deadline = self.uri.params.connect_timeout,
+        })
+    else
+        sock, err, timeout = new_inet_client(host.hostaddr or host.host,
+                                             host.port, {
+            deadline = self.uri.params.connect_timeout,
+        })
+    end
     if not sock then
         return false, err, timeout
     end
@@ -20,15 +20,26 @@
 -- THE SOFTWARE.
 --
 --- assign to local
-local sub = string.sub
 local gsub = string.gsub
+local sub = string.sub
 local concat = table.concat
+local ipairs = ipairs
+local pairs = pairs
+local random = math.random
 local pcall = pcall
+local tostring = tostring
 local type = type
+local running = coroutine.running
+local yield = coroutine.yield
 local format = require('print').format
+local gettime = require('time.clock').gettime
 local errorf = require('error').format
 local unpack = require('unpack')
+local instanceof = require('metamodule').instanceof
+local get_template = require('postgres.connection.template').get
 local new_inet_client = require('net.stream.inet').client.new
+local new_unix_client = require('net.stream.unix').client.new
+local new_buffer = require('postgres.buffer').new
 local parse_conninfo = require('postgres.conninfo')
 local new_canceler = require('postgres.canceler').new
 local encode_message = require('postgres.message').encode
@@ -40,18 +51,111 @@ local encode_sasl_initial_response = encode_message.sasl_initial_response
 local encode_sasl_response = encode_message.sasl_response
 local encode_query = encode_message.query
 local encode_parse = encode_message.parse
-local encode_bind = encode_message.bind
 local encode_describe = encode_message.describe
 local encode_execute = encode_message.execute
 local encode_close = encode_message.close
 local encode_sync = encode_message.sync
-local decode_message = require('postgres.message').decode
+local new_pack = require('postgres.pack').new
+local write_message = require('postgres.message').write
+local write_parse = write_message.parse
+local write_bind = write_message.bind
+local write_describe = write_message.describe
+local write_execute = write_message.execute
+local write_close = write_message.close
+local write_flush = write_message.flush
+local write_sync = write_message.sync
+local decode_many = require('postgres.message').decode_many
+local skip_many = require('postgres.message').skip_many
+local has_binary = require('postgres.decoder').has_binary
+local encode_param = require('postgres.binary').encode
+local new_stmtcache = require('postgres.connection.stmtcache').new
+local new_pipeline = require('postgres.pipeline').new
+local new_denque = require('denque').new
 local new_scram = require('postgres.scram').new
 local md5pswd = require('postgres.md5pswd')
+local peeruser = require('postgres.peeruser')
 
 --- constants
 local INF_POS = math.huge
 local INF_NEG = -math.huge
+--- message types that end the execution of the portal
+local END_OF_PORTAL = {
+    CommandComplete = true,
+    EmptyQueryResponse = true,
+    ErrorResponse = true,
+    PortalSuspended = true,
+}
+
+--- seconds to deprioritize the hosts that failed to connect
+local BAD_HOST_TTL = 30
+--- default maximum number of the queued NotificationResponse messages
+local DEFAULT_MAX_NOTIFICATIONS = 1024
+--- expiration times of the hosts that failed to connect recently
+--- @type table<string, number>
+local BAD_HOSTS = {}
+--- write buffer of the messages of the extended query.
+--- the messages are written and sent without yielding, so it is shared by
+--- all connections.
+local PACK = new_pack()
+
+--- host_key
+--- @param host postgres.conninfo.host
+--- @return string key
+local function host_key(host)
+    return host.socket or ((host.hostaddr or host.host) .. ':' .. host.port)
+end
+
+--- order_hosts returns the hosts in the order to try.
+--- the hosts are shuffled if load_balance_hosts is 'random', and the hosts
+--- that failed to connect recently are tried last.
+--- @param uri table
+--- @return postgres.conninfo.host[] hosts
+local function order_hosts(uri)
+    local hosts = uri.hosts or {
+        {
+            host = uri.host,
+            port = uri.port,
+            hostaddr = uri.params.hostaddr,
+            socket = uri.socket,
+        },
+    }
+    if #hosts == 1 then
+        return hosts
+    end
+
+    local list = {}
+    for i, host in ipairs(hosts) do
+        list[i] = host
+    end
+    if uri.params.load_balance_hosts == 'random' then
+        for i = #list, 2, -1 do
+            local j = random(i)
+            list[i], list[j] = list[j], list[i]
+        end
+    end
+
+    local good, bad = {}, {}
+    local now = gettime()
+    for _, host in ipairs(list) do
+        local key = host_key(host)
+        local expire = BAD_HOSTS[key]
+        if expire and expire > now then
+            bad[#bad + 1] = host
+        else
+            BAD_HOSTS[key] = nil
+            good[#good + 1] = host
+        end
+    end
+    for _, host in ipairs(bad) do
+        good[#good + 1] = host
+    end
+    return good
+end
+
+--- clear_bad_hosts forgets the hosts that failed to connect recently
+local function clear_bad_hosts()
+    BAD_HOSTS = {}
+end
 
 --- is_finite
 --- @param v any
@@ -68,24 +172,70 @@ end
 
 --- @class postgres.connection
 --- @field private sock net.Socket
+--- @field private nonblock boolean? yield the running coroutine instead of blocking
 --- @field private conninfo string url encoded connection info string
 --- @field private uri table<string, string> connection uri table
+--- @field private host postgres.conninfo.host? connected host
 --- @field private noticefn fun(postgres.message.error_response)
 --- @field private tracefn? fun(from:string, msg:string)
 --- @field private parameter_statuses table<string, string>
 --- @field private ready_for_query_status string
 --- @field private backend_key_data postgres.message.backend_key_data
 --- @field private error_response postgres.message.error_response
---- @field private buf string
+--- @field private buf postgres.buffer
+--- @field private msgs postgres.message[] decoded messages not yet received
+--- @field private msgidx integer index of the next message in msgs
+--- @field private notifications denque queued NotificationResponse messages
+--- @field private max_notifications integer maximum number of the queued notifications
+--- @field private ndropped integer number of the notifications dropped from the full queue
+--- @field private last_type string? type of the last message returned by recv
+--- @field private lazy_rows boolean? decode the column values of DataRow on access
 --- @field private ready_for_query postgres.message.ready_for_query?
+--- @field private stmtcache postgres.connection.stmtcache
+--- @field private portal postgres.connection.portal? portal being fetched in chunks
+--- @field private qstats postgres.connection.query_stats? cumulative query statistics
+--- @field private qrec postgres.connection.query_record? record of the running query
+--- @field private last_qrec postgres.connection.query_record? record of the last query
+--- @field private qlabel string? query text of the next query record
+--- @field private slowfn fun(rec:postgres.connection.query_record)?
+--- @field private slow_threshold number
 local Connection = {}
 
+--- @class postgres.connection.query_stats
+--- @field queries integer number of completed queries
+--- @field slow_queries integer number of queries that exceeded the threshold
+--- @field bytes_sent integer
+--- @field bytes_recv integer
+--- @field rows integer number of DataRow messages
+--- @field total_time number
+--- @field decode_time number
+
+--- @class postgres.connection.query_record
+--- @field query string query text, or empty string if it is sent by the other methods
+--- @field started_at number
+--- @field send_time number time spent in sending messages
+--- @field ttfb number? time to first byte from the start
+--- @field rowdesc_time number? time to RowDescription from the start
+--- @field complete_time number? time to the end of the result from the start
+--- @field stream_time number time from RowDescription to the end of the result
+--- @field total_time number time to ReadyForQuery from the start
+--- @field bytes_sent integer
+--- @field bytes_recv integer
+--- @field rows integer number of DataRow messages
+--- @field decode_time number time spent in decoding the column values
+
+--- @class postgres.connection.portal
+--- @field max_rows integer maximum number of rows to fetch at once
+--- @field close_stmt boolean close the unnamed statement after the execution
+--- @field closing boolean? close the portal at the next PortalSuspended
+
 --- init
 --- @param conninfo? string
+--- @param nonblock? boolean
 --- @return postgres.connection?
 --- @return any err
 --- @return boolean? timeout
-function Connection:init(conninfo)
+function Connection:init(conninfo, nonblock)
     assert(conninfo == nil or type(conninfo) == 'string',
            'conninfo must be string or nil')
 
@@ -96,30 +246,122 @@ function Connection:init(conninfo)
         return nil, err
     end
 
-    -- connect to server
-    local host = uri.params.hostaddr or uri.host
-    local sock, timeout
-    sock, err, timeout = new_inet_client(host, uri.port, {
-        deadline = uri.params.connect_timeout,
-    })
+    self.conninfo = conninfo
+    self.uri = uri
+    self.noticefn = DEFAULT_NOTICEFN
+    self.max_notifications = DEFAULT_MAX_NOTIFICATIONS
+    self.ndropped = 0
+
+    local attrs = uri.params.target_session_attrs or 'any'
+    local hosts = order_hosts(uri)
+    local errs = {}
+    local ok, timeout
+    for _, want in ipairs(attrs == 'prefer-standby' and {
+        'standby',
+        'any',
+    } or {
+        attrs,
+    }) do
+        -- try the hosts in order until a connection satisfies the
+        -- target_session_attrs
+        for _, host in ipairs(hosts) do
+            ok, err, timeout = self:connect(host, nonblock)
+            if ok then
+                ok, err, timeout = self:check_session_attrs(want)
+                if ok then
+                    self.host = host
+                    return self
+                end
+                self:close(true)
+                if not err then
+                    err = errorf('session attributes do not satisfy ' ..
+                                     'target_session_attrs %q', attrs)
+                end
+            end
+            errs[#errs + 1] = concat({
+                host.host,
+                ':',
+                host.port,
+                ': ',
+                tostring(err),
+            })
+        end
+    end
+
+    if #errs > 1 then
+        err = errorf('failed to connect to any host: %s', concat(errs, ', '))
+    end
+    return nil, err, timeout
+end
+
+--- connect connects to the host and waits for the ReadyForQuery message
+--- @private
+--- @param host postgres.conninfo.host
+--- @param nonblock boolean?
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:connect(host, nonblock)
+    local uri = self.uri
+    local sock, err, timeout
+    if host.socket then
+        sock, err, timeout = new_unix_client(host.socket, {
+            deadline = uri.params.connect_timeout,
+        })
+    else
+        sock, err, timeout = new_inet_client(host.hostaddr or host.host,
+                                             host.port, {
+            deadline = uri.params.connect_timeout,
+        })
+    end
     if not sock then
-        return nil, err, timeout
+        -- deprioritize the host for a while
+        BAD_HOSTS[host_key(host)] = gettime() + BAD_HOST_TTL
+        return false, err, timeout
+    end
+    if host.socket and uri.params.requirepeer then
+        -- verify the operating system user of the server process
+        local user
+        user, err = peeruser(sock:fd())
+        if not user then
+            sock:close()
+            return false, errorf('could not get peer credentials', err)
+        elseif user ~= uri.params.requirepeer then
+            sock:close()
+            return false, errorf(
+                       'requirepeer specifies %q, but actual peer user name is %q',
+                       uri.params.requirepeer, user)
+        end
+    end
+    if nonblock == true then
+        -- the startup and authentication are also performed in non-blocking
+        -- mode, but the connection above has been established in blocking
+        -- mode by the net module (bounded by connect_timeout)
+        local _
+        _, err = sock:nonblock(true)
+        if err then
+            sock:close()
+            return false, err
+        end
+        self.nonblock = true
     end
 
     self.sock = sock
-    self.conninfo = conninfo
-    self.uri = uri
-    self.noticefn = DEFAULT_NOTICEFN
     self.parameter_statuses = {}
     self.backend_key_data = {}
-    self.buf = ''
+    self.ready_for_query = nil
+    self.buf = new_buffer()
+    self.msgs = {}
+    self.msgidx = 1
+    self.notifications = new_denque()
+    self.stmtcache = new_stmtcache()
 
     -- send startup message
     local ok
     ok, err, timeout = self:startup()
     if not ok then
-        sock:close()
-        return nil, err, timeout
+        self:close(true)
+        return false, err, timeout
     end
 
     -- wait for ReadyForQuery message
@@ -127,21 +369,116 @@ function Connection:init(conninfo)
         local msg
         msg, err, timeout = self:recv()
         if not msg then
-            return nil, err, timeout
+            self:close(true)
+            return false, err, timeout
         elseif msg.type == 'ErrorResponse' then
             self:close(true)
-            return nil, errorf('[%s] %s', msg.severity, msg.message)
+            return false, errorf('[%s] %s', msg.severity, msg.message)
         elseif msg.type == 'BackendKeyData' then
             -- update backend_key_data
             self.backend_key_data = msg
         elseif msg.type == 'ReadyForQuery' then
-            return self
+            return true
         else
             self:close(true)
-            return nil, errorf('BackendKeyData|ReadyForQuery expected, got %q',
-                               msg.type)
+            return false, errorf(
+                       'BackendKeyData|ReadyForQuery expected, got %q', msg.type)
+        end
+    end
+end
+
+--- check_session_attrs checks that the session satisfies the
+--- target_session_attrs
+--- @private
+--- @param attrs string
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:check_session_attrs(attrs)
+    if attrs == 'any' then
+        return true
+    elseif attrs == 'read-write' or attrs == 'read-only' then
+        local read_only, err, timeout = self:is_read_only()
+        if read_only == nil then
+            return false, err, timeout
         end
+        return read_only == (attrs == 'read-only')
     end
+
+    -- primary or standby
+    local standby, err, timeout = self:is_in_hot_standby()
+    if standby == nil then
+        return false, err, timeout
+    end
+    return standby == (attrs == 'standby')
+end
+
+--- fetch_value executes the query and returns the first column of the first
+--- row
+--- @private
+--- @param query string
+--- @return string? value
+--- @return any err
+--- @return boolean? timeout
+function Connection:fetch_value(query)
+    local msg, err, timeout = self:simple_query(query)
+    local value, errmsg
+    while msg do
+        if msg.type == 'DataRow' and value == nil then
+            value = msg.values[1]
+        elseif msg.type == 'ErrorResponse' then
+            errmsg = errorf('[%s] %s', msg.severity, msg.message)
+        elseif msg.type == 'ReadyForQuery' then
+            if errmsg then
+                return nil, errmsg
+            elseif value == nil then
+                return nil, errorf('no value returned by %q', query)
+            end
+            return value
+        end
+        -- DataRow messages are not returned by next
+        msg, err, timeout = self:recv()
+    end
+    return nil, err, timeout
+end
+
+--- is_in_hot_standby returns true if the server is in hot standby mode
+--- @return boolean? ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:is_in_hot_standby()
+    local v = self.parameter_statuses.in_hot_standby
+    if v == nil then
+        -- servers older than 14 do not report in_hot_standby
+        local err, timeout
+        v, err, timeout = self:fetch_value('SELECT pg_catalog.pg_is_in_recovery()')
+        if not v then
+            return nil, err, timeout
+        end
+        return v == 't'
+    end
+    return v == 'on'
+end
+
+--- is_read_only returns true if the session does not accept the read-write
+--- transactions by default
+--- @return boolean? ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:is_read_only()
+    local v = self.parameter_statuses.default_transaction_read_only
+    if v == nil then
+        -- servers older than 14 do not report default_transaction_read_only
+        local err, timeout
+        v, err, timeout = self:fetch_value('SHOW transaction_read_only')
+        if not v then
+            return nil, err, timeout
+        end
+    end
+    if v == 'on' then
+        return true
+    end
+    return self:is_in_hot_standby()
 end
 
 --- set_recv_timeout
@@ -174,6 +511,52 @@ function Connection:set_send_timeout(sec)
     return err == nil, err
 end
 
+--- is_nonblock
+--- @return boolean nonblock
+function Connection:is_nonblock()
+    return self.nonblock == true
+end
+
+--- fd returns the file descriptor of the socket
+--- @return integer? fd
+function Connection:fd()
+    if self.sock then
+        return self.sock:fd()
+    end
+end
+
+--- wait suspends the running coroutine until the socket is ready for the
+--- specified operation in non-blocking mode.
+--- the coroutine yields the file descriptor of the socket, the operation and
+--- the remaining seconds until the deadline if specified, and the caller must
+--- resume the coroutine when the socket is ready or the deadline has passed.
+--- @private
+--- @param want string
+---| 'read'
+---| 'write'
+--- @param deadline? number
+--- @return boolean ok false if the operation would block
+--- @return any err
+function Connection:wait(want, deadline)
+    local co, ismain = running()
+    if not self.nonblock or not co or ismain then
+        -- cannot suspend the main thread
+        return false
+    end
+
+    if deadline then
+        local remain = deadline - gettime()
+        yield(self.sock:fd(), want, remain > 0 and remain or 0)
+    else
+        yield(self.sock:fd(), want)
+    end
+    if not self.sock then
+        -- closed while waiting
+        return false, errorf('connection is closed')
+    end
+    return true
+end
+
 --- startup
 --- @private
 --- @return boolean ok
@@ -398,18 +781,93 @@ function Connection:send(s)
         return false, errorf('connection is closed')
     end
 
-    local len, err, timeout = self.sock:send(s)
-    if not len then
-        return false, err, timeout
+    local qrec = self.qrec
+    local t
+    if self.qstats then
+        t = gettime()
+        if not qrec then
+            -- start the query record by the first message
+            qrec = self:start_query_record(t)
+        end
+    end
+
+    local msg = s
+    while true do
+        local len, err, timeout = self.sock:send(s)
+        if err or not timeout then
+            if not len then
+                return false, err, timeout
+            end
+            break
+        elseif len and len > 0 then
+            -- partially sent
+            s = sub(s, len + 1)
+        end
+
+        -- wait until the socket is writable
+        local ok
+        ok, err = self:wait('write')
+        if not ok then
+            return false, err, err == nil
+        end
     end
     self.ready_for_query = nil
+    if qrec then
+        qrec.bytes_sent = qrec.bytes_sent + #msg
+        qrec.send_time = qrec.send_time + (gettime() - t)
+    end
 
     if self.tracefn then
-        self.tracefn('client', s)
+        self.tracefn('client', msg)
     end
     return true
 end
 
+--- start_query_record
+--- @private
+--- @param t number
+--- @return postgres.connection.query_record qrec
+function Connection:start_query_record(t)
+    local qrec = {
+        query = self.qlabel or '',
+        started_at = t,
+        send_time = 0,
+        stream_time = 0,
+        total_time = 0,
+        bytes_sent = 0,
+        bytes_recv = 0,
+        rows = 0,
+        decode_time = 0,
+    }
+    self.qlabel = nil
+    self.qrec = qrec
+    return qrec
+end
+
+--- finish_query_record
+--- @private
+--- @param qrec postgres.connection.query_record
+function Connection:finish_query_record(qrec)
+    local elapsed = gettime() - qrec.started_at
+    qrec.total_time = elapsed
+    if qrec.rowdesc_time and qrec.complete_time then
+        qrec.stream_time = qrec.complete_time - qrec.rowdesc_time
+    end
+    self.qrec = nil
+    self.last_qrec = qrec
+
+    local stats = self.qstats
+    stats.queries = stats.queries + 1
+    stats.bytes_sent = stats.bytes_sent + qrec.bytes_sent
+    stats.bytes_recv = stats.bytes_recv + qrec.bytes_recv
+    stats.rows = stats.rows + qrec.rows
+    stats.total_time = stats.total_time + elapsed
+    if self.slowfn and elapsed >= self.slow_threshold then
+        stats.slow_queries = stats.slow_queries + 1
+        self.slowfn(qrec)
+    end
+end
+
 --- recv retrieves a message from the connection.
 --- if the following message types are received;
 ---   * ParameterStatus: update runtime parameters
@@ -418,52 +876,199 @@ end
 ---
 --- if a message type is other than the above message types
 --- except ReadyForQuery, return the message
+---
+--- if skip_rows is true, the buffered DataRow messages that precede the next
+--- message are discarded without decoding them. the DataRow messages that
+--- have already been decoded may still be returned.
+--- @param skip_rows? boolean
 --- @return postgres.message? msg
 --- @return any err
 --- @return boolean? timeout
-function Connection:recv()
+function Connection:recv(skip_rows)
     if not self.sock then
         return nil, errorf('connection is closed')
     end
 
     while not self.ready_for_query do
-        local msg, err, again = decode_message(self.buf)
-        if again then
-            local s, timeout
-            s, err, timeout = self.sock:recv()
-            if not s then
+        local msg, err, timeout = self:read_message(skip_rows)
+        if not msg then
+            return nil, err, timeout
+        elseif msg.type == 'ParameterStatus' then
+            -- update parameter status
+            self.parameter_statuses[msg.name] = msg.value
+        elseif msg.type == 'NoticeResponse' then
+            self.noticefn(msg)
+        elseif msg.type == 'NotificationResponse' then
+            -- queue the notification to be retrieved by wait_notification
+            self:queue_notification(msg)
+        elseif msg.type == 'PortalSuspended' and self.portal and
+            not self.portal.closing then
+            -- fetch the next rows of the portal
+            local ok
+            ok, err, timeout = self:send(concat({
+                encode_execute('', self.portal.max_rows),
+                encode_flush(),
+            }))
+            if not ok then
                 return nil, err, timeout
             end
-            self.buf = self.buf .. s
-        elseif not msg then
-            return nil, err
         else
-            -- consume bufferered data
-            local data = sub(self.buf, 1, msg.consumed)
-            self.buf = sub(self.buf, msg.consumed + 1)
+            local qrec = self.qrec
+            if qrec then
+                local t = msg.type
+                if t == 'DataRow' then
+                    qrec.rows = qrec.rows + 1
+                elseif t == 'RowDescription' then
+                    qrec.rowdesc_time = qrec.rowdesc_time or
+                                            (gettime() - qrec.started_at)
+                elseif END_OF_PORTAL[t] and t ~= 'PortalSuspended' then
+                    qrec.complete_time = gettime() - qrec.started_at
+                elseif t == 'ReadyForQuery' then
+                    self:finish_query_record(qrec)
+                end
+            end
+
+            if msg.type == 'ReadyForQuery' then
+                self.ready_for_query = msg
+            elseif self.portal and END_OF_PORTAL[msg.type] then
+                local ok
+                ok, err, timeout = self:sync_portal()
+                if not ok then
+                    return nil, err, timeout
+                end
+            end
+            self.last_type = msg.type
+            msg.conn = self
+            return msg
+        end
+        -- continue to next message
+    end
+end
+
+--- last_message_type returns the type of the last message returned by recv.
+--- it is used to know whether the result of the query has been consumed by
+--- the other object, e.g. the rows object of the pipeline.
+--- @private
+--- @return string? type
+function Connection:last_message_type()
+    return self.last_type
+end
+
+--- read_message returns the next decoded message.
+--- if no decoded message remains, all complete messages in the buffered data
+--- are decoded at once, and the data is received from the socket if no
+--- complete message is buffered.
+--- @private
+--- @param skip_rows? boolean discard the buffered DataRow messages without decoding them
+--- @param deadline? number time to stop waiting for the data
+--- @return postgres.message? msg
+--- @return any err
+--- @return boolean? timeout
+function Connection:read_message(skip_rows, deadline)
+    local buf = self.buf
+    while true do
+        local idx = self.msgidx
+        local msg = self.msgs[idx]
+        if msg then
+            self.msgs[idx] = nil
+            self.msgidx = idx + 1
             msg.consumed = nil
+            return msg
+        end
 
-            if self.tracefn then
-                self.tracefn('server', data)
+        local tracefn = self.tracefn
+        if skip_rows and not tracefn then
+            -- discard the DataRow messages by their type and length only
+            local n, pos = skip_many('D', buf)
+            if n > 0 then
+                buf:consume(pos - 1)
+                local qrec = self.qrec
+                if qrec then
+                    qrec.rows = qrec.rows + n
+                end
+            end
+        end
+
+        -- decode all complete messages in the buffered data at once.
+        -- if tracefn is set, decode messages one by one to trace the raw
+        -- data of each message.
+        local msgs, pos = decode_many(buf, 1, tracefn and 1 or nil,
+                                      self.lazy_rows)
+        if not msgs then
+            return nil, pos
+        end
+        self.msgs = msgs
+        self.msgidx = 1
+
+        if pos > 1 then
+            if tracefn then
+                tracefn('server', buf:read(pos - 1))
+            else
+                buf:consume(pos - 1)
+            end
+        else
+            -- no complete message in the buffered data
+            if deadline then
+                local remain = deadline - gettime()
+                if remain <= 0 then
+                    return nil, nil, true
+                elseif not self.nonblock then
+                    self.sock:rcvtimeo(remain)
+                end
             end
 
-            if msg.type == 'ParameterStatus' then
-                -- update parameter status
-                self.parameter_statuses[msg.name] = msg.value
-            elseif msg.type == 'NoticeResponse' then
-                self.noticefn(msg)
+            local s, err, timeout = self.sock:recv()
+            if s then
+                buf:write(s)
+                local qrec = self.qrec
+                if qrec then
+                    qrec.bytes_recv = qrec.bytes_recv + #s
+                    if not qrec.ttfb then
+                        qrec.ttfb = gettime() - qrec.started_at
+                    end
+                end
+            elseif err or not timeout then
+                return nil, err, timeout
             else
-                if msg.type == 'ReadyForQuery' then
-                    self.ready_for_query = msg
+                -- wait until the socket is readable
+                local ok
+                ok, err = self:wait('read', deadline)
+                if not ok then
+                    return nil, err, err == nil
                 end
-                msg.conn = self
-                return msg
             end
-            -- continue to next message
         end
     end
 end
 
+--- sync_portal ends the execution of the portal that is fetched in chunks
+--- @private
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:sync_portal()
+    local portal = self.portal
+    self.portal = nil
+    return self:send(concat({
+        -- close the portal if it is suspended
+        portal.closing and encode_close('portal', '') or '',
+        portal.close_stmt and encode_close('statement', '') or '',
+        encode_sync(),
+    }))
+end
+
+--- close_portal closes the portal that is fetched in chunks at the next
+--- PortalSuspended message instead of fetching the remaining rows.
+--- the PortalSuspended message is returned by the recv method.
+--- @return boolean ok false if there is no portal being fetched
+function Connection:close_portal()
+    if self.portal then
+        self.portal.closing = true
+        return true
+    end
+    return false
+end
+
 --- close
 --- @param force? boolean
 --- @return boolean ok
@@ -484,6 +1089,8 @@ function Connection:close(force)
     -- close socket even if sending terminate message failed
     self.sock:close()
     self.sock = nil
+    self.portal = nil
+    self.qrec = nil
     if not force and not ok then
         -- failed to send terminate message
         return false, err, timeout
@@ -508,7 +1115,13 @@ end
 --- @return any err
 function Connection:get_cancel()
     return new_canceler(self.conninfo, self.backend_key_data.pid,
-                        self.backend_key_data.key)
+                        self.backend_key_data.key, self.host)
+end
+
+--- get_host returns the host that the connection is connected to
+--- @return postgres.conninfo.host? host
+function Connection:get_host()
+    return self.host
 end
 
 --- status
@@ -564,6 +1177,108 @@ function Connection:set_notice_receiver(noticefn)
     self.noticefn = noticefn
 end
 
+--- queue_notification pushes the notification to the queue, and drops the
+--- oldest one if the queue is full
+--- @private
+--- @param msg postgres.message.notification_response
+function Connection:queue_notification(msg)
+    local queue = self.notifications
+    queue:push(msg)
+    while #queue > self.max_notifications do
+        queue:shift()
+        self.ndropped = self.ndropped + 1
+    end
+end
+
+--- set_max_notifications sets the maximum number of the notifications that
+--- are queued while processing the queries. the oldest notification is
+--- dropped if the queue is full, and 0 disables the queue.
+--- @param n integer
+function Connection:set_max_notifications(n)
+    assert(type(n) == 'number' and n >= 0 and n % 1 == 0,
+           'n must be a unsigned integer')
+    self.max_notifications = n
+    local queue = self.notifications
+    if queue then
+        while #queue > n do
+            queue:shift()
+            self.ndropped = self.ndropped + 1
+        end
+    end
+end
+
+--- dropped_notifications returns the number of the notifications that have
+--- been dropped from the full queue
+--- @return integer n
+function Connection:dropped_notifications()
+    return self.ndropped
+end
+
+--- wait_notification waits for the NotificationResponse message of the
+--- channels that are listened to by the LISTEN command.
+--- the notifications received while processing the queries are queued and
+--- returned in order of arrival before waiting for the new one.
+--- @param timeout? number seconds to wait, or wait indefinitely if nil
+--- @return postgres.message.notification_response? msg
+--- @return any err
+--- @return boolean? timeout
+function Connection:wait_notification(timeout)
+    assert(timeout == nil or (type(timeout) == 'number' and timeout >= 0),
+           'timeout must be a unsigned number or nil')
+
+    if not self.sock then
+        return nil, errorf('connection is closed')
+    end
+
+    local msg = self.notifications:shift()
+    if msg then
+        msg.conn = self
+        return msg
+    elseif not self.ready_for_query then
+        return nil,
+               errorf('cannot wait for notification while the query is in progress')
+    end
+
+    local deadline = timeout and gettime() + timeout
+    local rcvtimeo
+    if deadline and not self.nonblock then
+        -- restore the receive timeout after waiting
+        rcvtimeo = self.sock:rcvtimeo()
+    end
+
+    local err, again
+    while true do
+        msg, err, again = self:read_message(nil, deadline)
+        if not msg then
+            break
+        elseif msg.type == 'NotificationResponse' then
+            msg.conn = self
+            break
+        elseif msg.type == 'ParameterStatus' then
+            -- update parameter status
+            self.parameter_statuses[msg.name] = msg.value
+        elseif msg.type == 'NoticeResponse' then
+            self.noticefn(msg)
+        elseif msg.type == 'ErrorResponse' then
+            -- the server reports the error without the query, e.g.
+            -- the connection is terminated by the administrator
+            self.error_response = msg
+            msg, err = nil, errorf('[%s] %s', msg.severity, msg.message)
+            break
+        else
+            msg, err = nil, errorf(
+                           'NotificationResponse|ErrorResponse expected, got %q',
+                           msg.type)
+            break
+        end
+    end
+
+    if rcvtimeo then
+        self.sock:rcvtimeo(rcvtimeo)
+    end
+    return msg, err, again
+end
+
 --- trace
 --- @param tracefn? fun(from:string, msg:string)
 --- @return function oldfn
@@ -575,6 +1290,80 @@ function Connection:trace(tracefn)
     return oldfn
 end
 
+--- set_lazy_rows enables or disables the lazy decoding of the DataRow
+--- messages. if enabled, the values of the DataRow message is the
+--- postgres.data_row userdata that holds the message data with the index of
+--- the column values, and the column values are created only when they are
+--- accessed.
+--- @param enabled boolean
+function Connection:set_lazy_rows(enabled)
+    assert(type(enabled) == 'boolean', 'enabled must be boolean')
+    self.lazy_rows = enabled or nil
+end
+
+--- set_query_stats enables or disables the query statistics.
+--- if disabled, the statistics are discarded.
+--- @param enabled boolean
+function Connection:set_query_stats(enabled)
+    assert(type(enabled) == 'boolean', 'enabled must be boolean')
+    if not enabled then
+        self.qstats = nil
+        self.qrec = nil
+        self.last_qrec = nil
+        self.slowfn = nil
+    elseif not self.qstats then
+        self.qstats = {
+            queries = 0,
+            slow_queries = 0,
+            bytes_sent = 0,
+            bytes_recv = 0,
+            rows = 0,
+            total_time = 0,
+            decode_time = 0,
+        }
+    end
+end
+
+--- query_stats returns a copy of the cumulative query statistics
+--- @return postgres.connection.query_stats? stats
+--- @return postgres.connection.query_record? last record of the last query
+function Connection:query_stats()
+    local stats = self.qstats
+    if stats then
+        local copy = {}
+        for k, v in pairs(stats) do
+            copy[k] = v
+        end
+        return copy, self.last_qrec
+    end
+end
+
+--- set_slow_query_handler sets the function to be called with the query
+--- record when the query takes longer than the threshold.
+--- the query statistics are enabled by this method.
+--- @param slowfn? fun(rec:postgres.connection.query_record)
+--- @param threshold? number seconds (default 0)
+function Connection:set_slow_query_handler(slowfn, threshold)
+    assert(slowfn == nil or type(slowfn) == 'function',
+           'slowfn must be function or nil')
+    assert(threshold == nil or (type(threshold) == 'number' and threshold >= 0),
+           'threshold must be unsigned number or nil')
+    if slowfn then
+        self:set_query_stats(true)
+    end
+    self.slowfn = slowfn
+    self.slow_threshold = threshold or 0
+end
+
+--- get_query_record returns the record of the running query and the
+--- cumulative statistics to account the decode time.
+--- @private
+--- @return postgres.connection.query_record? qrec
+--- @return postgres.connection.query_stats? stats
+function Connection:get_query_record()
+    return self.qrec, self.qstats
+end
+
 --- flush sends a postgres.message.flush message
 --- @return boolean ok
 --- @return any err
@@ -607,16 +1396,71 @@ local function stringify(val)
     return nil, typ
 end
 
---- replace_named_params
+--- replace_named_params_binary converts the named parameters to the
+--- positional parameters, and encodes each parameter into a single value.
+--- a table parameter is encoded as an array value instead of the list of
+--- positional parameters.
+--- @param tmpl postgres.connection.template
+--- @param params table<string, any>
+--- @return string? query
+--- @return any err
+--- @return string[]? values
+--- @return integer[]? formats
+--- @return integer[]? oids
+local function replace_named_params_binary(tmpl, params)
+    local values = {}
+    local formats = {}
+    local oids = {}
+    local nparam = 0
+
+    --- add_param adds the encoded parameter
+    --- @param val any
+    --- @return any err
+    local function add_param(val)
+        local oid, fmt = 0, 0
+        if val ~= nil then
+            val, oid, fmt = encode_param(val)
+            if not val then
+                -- oid is an error message
+                return oid
+            end
+        end
+        nparam = nparam + 1
+        values[nparam] = val
+        formats[nparam] = fmt
+        oids[nparam] = oid
+    end
+
+    -- positional parameters
+    local npos = #params
+    for i = 1, npos do
+        local err = add_param(params[i])
+        if err then
+            return nil, format('invalid parameter #%d: %s', i, err)
+        end
+    end
+
+    -- named parameters follow the positional parameters
+    local names = tmpl.names
+    for i = 1, #names do
+        local err = add_param(params[names[i]])
+        if err then
+            return nil, format('invalid parameter %q: %s', names[i], err)
+        end
+    end
+
+    return tmpl:sql(npos), nil, values, formats, oids
+end
+
+--- expand_named_params converts the named parameters to the positional
+--- parameters, and expands a table parameter into the list of positional
+--- parameters.
 --- @param query string
 --- @param params table<string, any>
 --- @return string? query
 --- @return any err
 --- @return table? params
-function Connection:replace_named_params(query, params)
-    assert(type(query) == 'string', 'query must be string')
-    assert(type(params) == 'table', 'params must be table')
-
+local function expand_named_params(query, params)
     local newparams = {
         unpack(params),
     }
@@ -690,12 +1534,127 @@ function Connection:replace_named_params(query, params)
     return res, nil, newparams
 end
 
+--- replace_named_params_text converts the named parameters to the positional
+--- parameters by the compiled template. if a table parameter is passed, the
+--- query is expanded by expand_named_params because its placeholders depend
+--- on the contents of the table.
+--- @param tmpl postgres.connection.template
+--- @param params table<string, any>
+--- @return string? query
+--- @return any err
+--- @return table? params
+local function replace_named_params_text(tmpl, params)
+    local newparams = {
+        unpack(params),
+    }
+    local npos = #newparams
+    local names = tmpl.names
+    for i = 1, #names do
+        local name = names[i]
+        local val, typ = stringify(params[name])
+        if not val then
+            return nil,
+                   format('invalid parameter %q: data type %q is not supported',
+                          name, typ)
+        elseif typ == 'table' then
+            return expand_named_params(tmpl.query, params)
+        end
+        newparams[npos + i] = val
+    end
+    return tmpl:sql(npos), nil, newparams
+end
+
+--- replace_named_params
+--- the ${name} placeholders of the query are parsed once and cached by the
+--- query string.
+--- @param query string|postgres.connection.template
+--- @param params table<string, any>
+--- @param binary boolean? encode the parameters in binary format
+--- @return string? query
+--- @return any err
+--- @return table? params
+--- @return integer[]? formats
+--- @return integer[]? oids
+function Connection:replace_named_params(query, params, binary)
+    assert(type(query) == 'string' or
+               instanceof(query, 'postgres.connection.template'),
+           'query must be string or postgres.connection.template')
+    assert(type(params) == 'table', 'params must be table')
+    assert(binary == nil or type(binary) == 'boolean',
+           'binary must be boolean or nil')
+
+    local tmpl = query
+    if type(query) == 'string' then
+        tmpl = get_template(query)
+    end
+
+    if binary then
+        return replace_named_params_binary(tmpl, params)
+    end
+    return replace_named_params_text(tmpl, params)
+end
+
 --- ping sends a empty query message
 --- @return boolean ok
 --- @return any err
 --- @return boolean? timeout
 function Connection:ping()
-    local msg, err, timeout = self:simple_query('')
+    local ok, err, timeout = self:send_ping()
+    if not ok then
+        return false, err, timeout
+    end
+    return self:recv_ping()
+end
+
+--- send_ping sends a empty query message without waiting for the response.
+--- it can be used to ping the multiple connections at once.
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:send_ping()
+    local ok, err, timeout = self:wait_ready()
+    if not ok then
+        if err then
+            err = errorf('connection is not ready', err)
+        end
+        return false, err, timeout
+    end
+    return self:send(encode_query(''))
+end
+
+--- recv_ping receives the response of the empty query message sent by
+--- send_ping.
+--- @param timeout? number seconds to wait for the response
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:recv_ping(timeout)
+    assert(timeout == nil or (type(timeout) == 'number' and timeout >= 0),
+           'timeout must be unsigned number or nil')
+    if not timeout or self.nonblock or not self.sock then
+        return self:recv_pong()
+    elseif timeout == 0 then
+        -- 0 disables the receive timeout of the socket
+        return false, nil, true
+    end
+
+    -- restore the receive timeout after waiting
+    local rcvtimeo = self.sock:rcvtimeo()
+    self.sock:rcvtimeo(timeout)
+    local ok, err, is_timeout = self:recv_pong()
+    if self.sock then
+        self.sock:rcvtimeo(rcvtimeo)
+    end
+    return ok, err, is_timeout
+end
+
+--- recv_pong receives the EmptyQueryResponse and ReadyForQuery messages
+--- @private
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Connection:recv_pong()
+    local msg, err, timeout = self:next()
     if not msg then
         return false, err, timeout
     elseif msg.type ~= 'EmptyQueryResponse' then
@@ -732,18 +1691,23 @@ function Connection:wait_ready()
 end
 
 --- query
---- @param query string
+--- @param query string|postgres.connection.template
 --- @param params table<string, any>?
 --- @param max_rows integer?
+--- @param binary boolean? use the binary format for parameters and results
 --- @return postgres.message? msg
 --- @return any err
 --- @return boolean? timeout
-function Connection:query(query, params, max_rows)
-    assert(type(query) == 'string', 'query must be string')
+function Connection:query(query, params, max_rows, binary)
+    assert(type(query) == 'string' or
+               instanceof(query, 'postgres.connection.template'),
+           'query must be string or postgres.connection.template')
     assert(params == nil or type(params) == 'table',
            'params must be table or nil')
     assert(max_rows == nil or is_finite(max_rows),
            'max_rows must be integer or nil')
+    assert(binary == nil or type(binary) == 'boolean',
+           'binary must be boolean or nil')
 
     if not self.sock then
         return nil, errorf('connection is closed')
@@ -757,15 +1721,35 @@ function Connection:query(query, params, max_rows)
         max_rows = 0
     end
 
-    local parsed_query, err, values = self:replace_named_params(query, params)
+    local parsed_query, err, values, formats, oids =
+        self:replace_named_params(query, params, binary)
     if not parsed_query then
         return nil, err
     end
 
-    if #values == 0 and max_rows == 0 then
-        return self:simple_query(parsed_query)
+    if self.qstats then
+        -- label the query record
+        self.qlabel = type(query) == 'string' and query or query.query
+    end
+
+    local msg, timeout
+    if not binary and #values == 0 and max_rows == 0 then
+        msg, err, timeout = self:simple_query(parsed_query)
+    else
+        msg, err, timeout = self:extended_query(parsed_query, values, max_rows,
+                                                binary, formats, oids)
     end
-    return self:extended_query(parsed_query, values, max_rows)
+    -- the label is consumed by the first message of the query, so clear it
+    -- if the query failed before sending it
+    self.qlabel = nil
+    return msg, err, timeout
+end
+
+--- pipeline creates a pipeline that sends multiple queries with a single Sync
+--- message
+--- @return postgres.pipeline
+function Connection:pipeline()
+    return new_pipeline(self)
 end
 
 --- simple_query
@@ -800,15 +1784,124 @@ function Connection:simple_query(query)
     return self:next()
 end
 
+--- describe_result_formats parses the query into the statement and returns
+--- the result-column format codes that request the binary format for the
+--- columns that have a binary decoder.
+--- @private
+--- @param prefix string messages to be sent before the Parse message
+--- @param stmt string name of the statement
+--- @param query string? query to be parsed, or nil if already parsed
+--- @param oids integer[]? object IDs of the parameter data types
+--- @return integer[]? formats
+--- @return any err
+--- @return boolean? timeout
+--- @return postgres.message.error_response? errmsg
+function Connection:describe_result_formats(prefix, stmt, query, oids)
+    local ok, err, timeout = self:send(concat({
+        prefix,
+
+        -- prepare query
+        -- the possible responses are:
+        --  * ParseComplete
+        --  * ErrorResponse
+        query and encode_parse(stmt, query, oids) or '',
+
+        -- describe statement
+        -- the possible responses are:
+        --  * ParameterDescription
+        --  * RowDescription
+        --  * NoData
+        --  * ErrorResponse
+        encode_describe('statement', stmt),
+
+        -- flush the responses without ending the extended query
+        encode_flush(),
+    }))
+    if not ok then
+        return nil, err, timeout
+    end
+
+    -- wait for ParseComplete, ParameterDescription and RowDescription or
+    -- NoData messages
+    local target = query and 'ParseComplete' or 'ParameterDescription'
+    while true do
+        local msg
+        msg, err, timeout = self:recv()
+        if not msg then
+            return nil, err, timeout
+        elseif msg.type == 'ErrorResponse' then
+            -- the backend discards messages until a Sync message is received
+            ok, err, timeout = self:send(encode_sync())
+            if not ok then
+                return nil, err, timeout
+            end
+            self.error_response = msg
+            return nil, nil, nil, msg
+        elseif msg.type == 'CloseComplete' then
+            -- ignore the responses to the Close messages of the prefix
+        elseif target == 'RowDescription' and msg.type == 'NoData' then
+            return {}
+        elseif msg.type ~= target then
+            return nil, errorf(
+                       target .. '|ErrorResponse expects, got %q response',
+                       msg.type)
+        elseif target == 'ParseComplete' then
+            target = 'ParameterDescription'
+        elseif target == 'ParameterDescription' then
+            target = 'RowDescription'
+        else
+            local formats = {}
+            for i, field in ipairs(msg.fields) do
+                formats[i] = has_binary(field.type_oid) and 1 or 0
+            end
+            return formats
+        end
+    end
+end
+
+--- set_stmt_cache_size sets the maximum number of the prepared statements
+--- that are cached by the extended query. 0 disables the cache.
+--- @param size integer
+function Connection:set_stmt_cache_size(size)
+    self.stmtcache:set_capacity(size)
+end
+
+--- stmt_cache_stats returns the statistics of the prepared statement cache
+--- @return table stats
+function Connection:stmt_cache_stats()
+    return self.stmtcache:stats()
+end
+
+--- uncache_stmt removes the cached statement that can no longer be used
+--- due to the error.
+--- @private
+--- @param stmt postgres.connection.stmtcache.stmt?
+--- @param errmsg postgres.message.error_response
+function Connection:uncache_stmt(stmt, errmsg)
+    if errmsg.code == '26000' then
+        -- invalid_sql_statement_name: the statements have been discarded by
+        -- DEALLOCATE or DISCARD command
+        self.stmtcache:clear(true)
+    elseif stmt and (not stmt.prepared or errmsg.code == '0A000') then
+        -- failed to parse the statement, or the cached plan must not change
+        -- result type
+        self.stmtcache:remove(stmt)
+    end
+end
+
 --- extended_query
 --- @private
 --- @param query string
 --- @param values string[]
 --- @param max_rows integer?
+--- @param binary boolean?
+--- @param formats integer[]? parameter format codes
+--- @param oids integer[]? object IDs of the parameter data types
 --- @return postgres.message? res
 --- @return any err
 --- @return boolean? timeout
-function Connection:extended_query(query, values, max_rows)
+function Connection:extended_query(query, values, max_rows, binary, formats,
+                                   oids)
     local ok, err, timeout = self:wait_ready()
     if not ok then
         if err then
@@ -817,55 +1910,122 @@ function Connection:extended_query(query, values, max_rows)
         return nil, err, timeout
     end
 
-    ok, err, timeout = self:send(concat({
+    -- use the named statement if the statement cache is enabled
+    -- the statement is identified by the query and the parameter data types
+    local key = query
+    if oids and #oids > 0 then
+        key = concat({
+            query,
+            concat(oids, ','),
+        }, '\0')
+    end
+    local stmt = self.stmtcache:get(key)
+    local name = stmt and stmt.name or '' -- or unnamed statement
+    if stmt and stmt.prepared then
+        query = nil
+    end
+
+    -- close the evicted statements
+    local prefix = {}
+    for i, v in ipairs(self.stmtcache:pop_closes()) do
+        prefix[i] = encode_close('statement', v)
+    end
+    prefix = concat(prefix)
+
+    local parse, results
+    if binary then
+        results = stmt and stmt.results
+        if not results then
+            -- the result-column format codes must be specified in the Bind
+            -- message, so describe the result columns before binding
+            local errmsg
+            results, err, timeout, errmsg = self:describe_result_formats(
+                                                prefix, name, query, oids)
+            if not results then
+                if errmsg then
+                    self:uncache_stmt(stmt, errmsg)
+                    return errmsg
+                end
+                return nil, err, timeout
+            elseif stmt then
+                stmt.prepared = true
+                stmt.results = results
+            end
+            prefix = ''
+        end
+    end
+
+    -- write all messages of the query into the pack at once
+    local p = PACK:clear():bytes(prefix)
+    if not binary and query then
         -- prepare query
         -- the possible responses are:
         --  * ParseComplete
         --  * ErrorResponse
-        encode_parse('', query), -- unnamed statement
-
-        -- bind parameters to the prepared query
-        -- the possible responses are:
-        --  * BindComplete
-        --  * ErrorResponse
-        encode_bind('', '', values), -- unnamed portal and statement
+        parse = true
+        write_parse(p, name, query, oids)
+    end
 
-        -- describe portal
-        -- the possible responses are:
-        --  * RowDescription
-        --  * NoData
-        --  * ErrorResponse
-        encode_describe('portal', ''), -- unnamed portal
+    -- bind parameters to the prepared query
+    -- the possible responses are:
+    --  * BindComplete
+    --  * ErrorResponse
+    -- unnamed portal
+    write_bind(p, '', name, values, results, formats)
 
-        -- execute portal
-        -- the possible responses are:
-        --  * CommandComplete
-        --  * CopyInResponse
-        --  * CopyOutResponse
-        --  * DataRow
-        --  * EmptyQueryResponse
-        --  * ErrorResponse
-        --  * NoticeResponse
-        encode_execute(''), -- unnamed portal
+    -- describe portal
+    -- the possible responses are:
+    --  * RowDescription
+    --  * NoData
+    --  * ErrorResponse
+    write_describe(p, 'portal', '') -- unnamed portal
 
-        -- close statement
+    -- execute portal
+    -- the possible responses are:
+    --  * CommandComplete
+    --  * CopyInResponse
+    --  * CopyOutResponse
+    --  * DataRow
+    --  * EmptyQueryResponse
+    --  * ErrorResponse
+    --  * NoticeResponse
+    --  * PortalSuspended
+    write_execute(p, '', max_rows) -- unnamed portal
+
+    -- the portal is closed by the Sync message, so if max_rows is
+    -- specified, the Sync message is sent after the execution of the
+    -- portal is completed by the recv method.
+    if max_rows > 0 then
+        write_flush(p)
+    else
+        -- close the unnamed statement
         -- the possible responses are:
         --  * CloseComplete
         --  * ErrorResponse
-        encode_close('statement', ''), -- unnamed statement
+        if not stmt then
+            write_close(p, 'statement', '')
+        end
 
         -- sync
         -- the possible responses are:
         --  * ReadyForQuery
         --  * ErrorResponse
-        encode_sync(),
-    }))
+        write_sync(p)
+    end
+
+    ok, err, timeout = self:send(p:data())
     if not ok then
         return nil, err, timeout
+    elseif max_rows > 0 then
+        -- fetch the rows in chunks of max_rows
+        self.portal = {
+            max_rows = max_rows,
+            close_stmt = not stmt,
+        }
     end
 
     -- wait for ParseComplete and BindComplete messages
-    local target = 'ParseComplete'
+    local target = parse and 'ParseComplete' or 'BindComplete'
     local msg
     while true do
         msg, err, timeout = self:recv()
@@ -873,12 +2033,18 @@ function Connection:extended_query(query, values, max_rows)
             return nil, err, timeout
         elseif msg.type == 'ErrorResponse' then
             self.error_response = msg
+            self:uncache_stmt(stmt, msg)
             return msg
+        elseif msg.type == 'CloseComplete' then
+            -- ignore the responses to the Close messages of the prefix
         elseif msg.type ~= target then
             return nil, errorf(
                        target .. '|ErrorResponse expects, got %q response',
                        msg.type)
         elseif target == 'ParseComplete' then
+            if stmt then
+                stmt.prepared = true
+            end
             target = 'BindComplete'
         elseif target == 'BindComplete' then
             break
@@ -933,7 +2099,7 @@ function Connection:next()
     --  * NoticeResponse
     --
     while true do
-        local msg, err, timeout = self:recv()
+        local msg, err, timeout = self:recv(true)
         if not msg then
             return nil, err, timeout
         elseif msg.type == 'ReadyForQuery' then
@@ -950,4 +2116,5 @@ end
 
 return {
     new = require('metamodule').new(Connection),
+    clear_bad_hosts = clear_bad_hosts,
 }
@@ -0,0 +1,201 @@
+--
+-- Copyright (C) 2023 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local format = string.format
+
+--- @class denque
+--- @field __len fun(self):integer
+--- @field push fun(self, data:any):(elm:denque.element)
+--- @field shift fun(self):(data:any)
+--- @class denque.element
+--- @field data fun(self, newdata?:any):(data:any)
+--- @field remove fun(self):(data:any)
+
+--- @type fun():denque
+local new_denque = require('denque').new
+
+--- @class postgres.connection.stmtcache.stmt
+--- @field name string name of the prepared statement
+--- @field key string cache key
+--- @field prepared boolean true if the backend has parsed the statement
+--- @field results integer[]? result-column format codes for the binary mode
+
+--- @class postgres.connection.stmtcache
+--- @field private capacity integer
+--- @field private queue denque least recently used statement at the head
+--- @field private key2elm table<string, denque.element>
+--- @field private seq integer
+--- @field private closes string[] names of statements to be closed
+--- @field private nhit integer
+--- @field private nmiss integer
+--- @field private neviction integer
+local StmtCache = {}
+
+--- init
+--- @param capacity integer? maximum number of the cached statements (default: 0)
+--- @return postgres.connection.stmtcache
+function StmtCache:init(capacity)
+    self.queue = new_denque()
+    self.key2elm = {}
+    self.seq = 0
+    self.closes = {}
+    self.nhit = 0
+    self.nmiss = 0
+    self.neviction = 0
+    self:set_capacity(capacity or 0)
+    return self
+end
+
+--- close_stmt schedules to close the prepared statement
+--- @private
+--- @param stmt postgres.connection.stmtcache.stmt
+function StmtCache:close_stmt(stmt)
+    -- it is not an error to close a nonexistent statement, so the statement
+    -- that may have been parsed by the backend is also closed.
+    self.closes[#self.closes + 1] = stmt.name
+end
+
+--- set_capacity sets the maximum number of the cached statements and evicts
+--- the least recently used statements that exceed it. 0 disables the cache.
+--- @param capacity integer
+function StmtCache:set_capacity(capacity)
+    assert(type(capacity) == 'number' and capacity >= 0 and capacity % 1 == 0,
+           'capacity must be unsigned integer')
+    self.capacity = capacity
+    while #self.queue > capacity do
+        local stmt = self.queue:shift()
+        self.key2elm[stmt.key] = nil
+        self.neviction = self.neviction + 1
+        self:close_stmt(stmt)
+    end
+end
+
+--- get_capacity
+--- @return integer capacity
+function StmtCache:get_capacity()
+    return self.capacity
+end
+
+--- size
+--- @return integer
+function StmtCache:size()
+    return #self.queue
+end
+
+--- get returns the prepared statement of the key and marks it as the most
+--- recently used. if the statement is not cached, or it is not yet prepared,
+--- a new statement is added to the cache.
+--- @param key string
+--- @return postgres.connection.stmtcache.stmt? stmt nil if the cache is disabled
+function StmtCache:get(key)
+    if self.capacity == 0 then
+        return nil
+    end
+
+    local elm = self.key2elm[key]
+    if elm then
+        local stmt = elm:remove()
+        if stmt.prepared then
+            self.nhit = self.nhit + 1
+            self.key2elm[key] = self.queue:push(stmt)
+            return stmt
+        end
+        -- the previous attempt did not complete, so the backend may or may
+        -- not have the statement.
+        self.key2elm[key] = nil
+        self:close_stmt(stmt)
+    end
+    self.nmiss = self.nmiss + 1
+
+    -- evict the least recently used statement
+    if #self.queue >= self.capacity then
+        local old = self.queue:shift()
+        self.key2elm[old.key] = nil
+        self.neviction = self.neviction + 1
+        self:close_stmt(old)
+    end
+
+    self.seq = self.seq + 1
+    local stmt = {
+        name = format('postgres_stmt_%d', self.seq),
+        key = key,
+        prepared = false,
+    }
+    self.key2elm[key] = self.queue:push(stmt)
+    return stmt
+end
+
+--- remove removes the statement from the cache and schedules to close it if
+--- it has been prepared
+--- @param stmt postgres.connection.stmtcache.stmt
+function StmtCache:remove(stmt)
+    local elm = self.key2elm[stmt.key]
+    if elm and elm:data() == stmt then
+        elm:remove()
+        self.key2elm[stmt.key] = nil
+        if stmt.prepared then
+            self:close_stmt(stmt)
+        end
+    end
+end
+
+--- clear removes all statements from the cache.
+--- @param discarded boolean? true if the backend has already discarded them
+function StmtCache:clear(discarded)
+    while #self.queue > 0 do
+        local stmt = self.queue:shift()
+        self.key2elm[stmt.key] = nil
+        if not discarded then
+            self:close_stmt(stmt)
+        end
+    end
+    if discarded then
+        self.closes = {}
+    end
+end
+
+--- pop_closes returns the names of the statements to be closed and forgets them
+--- @return string[] names
+function StmtCache:pop_closes()
+    local names = self.closes
+    if #names > 0 then
+        self.closes = {}
+    end
+    return names
+end
+
+--- stats returns the statistics of the cache
+--- @return table stats
+function StmtCache:stats()
+    return {
+        capacity = self.capacity,
+        size = #self.queue,
+        hits = self.nhit,
+        misses = self.nmiss,
+        evictions = self.neviction,
+    }
+end
+
+return {
+    new = require('metamodule').new(StmtCache),
+}
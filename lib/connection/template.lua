@@ -0,0 +1,132 @@
+--
+-- Copyright (C) 2023 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local find = string.find
+local sub = string.sub
+local concat = table.concat
+
+--- @class postgres.connection.template
+--- @field query string query text with the named parameters
+--- @field names string[] parameter names in order of first appearance
+--- @field private parts string[] query fragments around the placeholders
+--- @field private refs integer[] indexes of the names of the placeholders
+--- @field private sqls table<integer, string> compiled queries by the number of positional parameters
+local Template = {}
+
+--- init parses the ${name} placeholders of the query into a positional plan
+--- @param query string
+--- @return postgres.connection.template
+function Template:init(query)
+    assert(type(query) == 'string', 'query must be string')
+    local names = {}
+    local name2idx = {}
+    local parts = {}
+    local refs = {}
+    local pos = 1
+    while true do
+        local head, tail, name = find(query, '%${([^}]+)}', pos)
+        if not head then
+            break
+        end
+
+        local idx = name2idx[name]
+        if not idx then
+            idx = #names + 1
+            names[idx] = name
+            name2idx[name] = idx
+        end
+        parts[#parts + 1] = sub(query, pos, head - 1)
+        refs[#refs + 1] = idx
+        pos = tail + 1
+    end
+    parts[#parts + 1] = sub(query, pos)
+
+    self.query = query
+    self.names = names
+    self.parts = parts
+    self.refs = refs
+    self.sqls = {}
+    return self
+end
+
+--- sql returns the query that the placeholders are replaced with the
+--- positional parameters numbered after the positional parameters given by
+--- the caller.
+--- the compiled query is cached by the number of positional parameters.
+--- @param npos integer number of the positional parameters
+--- @return string sql
+function Template:sql(npos)
+    local sql = self.sqls[npos]
+    if not sql then
+        local parts = self.parts
+        local refs = self.refs
+        local tbl = {
+            parts[1],
+        }
+        for i = 1, #refs do
+            tbl[#tbl + 1] = '$' .. (npos + refs[i])
+            tbl[#tbl + 1] = parts[i + 1]
+        end
+        sql = concat(tbl)
+        self.sqls[npos] = sql
+    end
+    return sql
+end
+
+local new_template = require('metamodule').new(Template)
+
+--- maximum number of the cached templates.
+--- the cache is cleared when it is full.
+local CACHE_SIZE = 1024
+--- @type table<string, postgres.connection.template>
+local CACHE = {}
+local CACHE_LEN = 0
+
+--- get returns the cached template of the query, or creates and caches it
+--- @param query string
+--- @return postgres.connection.template
+local function get(query)
+    local tmpl = CACHE[query]
+    if not tmpl then
+        tmpl = new_template(query)
+        if CACHE_LEN >= CACHE_SIZE then
+            CACHE = {}
+            CACHE_LEN = 0
+        end
+        CACHE[query] = tmpl
+        CACHE_LEN = CACHE_LEN + 1
+    end
+    return tmpl
+end
+
+--- clear_cache removes all cached templates
+local function clear_cache()
+    CACHE = {}
+    CACHE_LEN = 0
+end
+
+return {
+    new = new_template,
+    get = get,
+    clear_cache = clear_cache,
+}
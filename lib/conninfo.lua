@@ -22,10 +22,19 @@
 --- assign to local
 local concat = table.concat
 local sort = table.sort
+local byte = string.byte
+local char = string.char
+local format = string.format
+local gmatch = string.gmatch
+local gsub = string.gsub
+local match = string.match
 local sub = string.sub
 local find = string.find
+local ipairs = ipairs
+local tonumber = tonumber
 local getenv = os.getenv
 local pairs = pairs
+local select = select
 local type = type
 local errorf = require('error').format
 local parse_url = require('url').parse
@@ -100,6 +109,93 @@ local HOSTPATHSPEC = {
     dbname = true,
 }
 
+local TARGET_SESSION_ATTRS = {
+    ['any'] = true,
+    ['read-write'] = true,
+    ['read-only'] = true,
+    ['primary'] = true,
+    ['standby'] = true,
+    ['prefer-standby'] = true,
+}
+
+local LOAD_BALANCE_HOSTS = {
+    disable = true,
+    random = true,
+}
+
+--- split splits the comma-separated list
+--- @param s string
+--- @return string[] list
+local function split(s)
+    local list = {}
+    for v in gmatch(s .. ',', '([^,]*),') do
+        list[#list + 1] = v
+    end
+    return list
+end
+
+--- @class postgres.conninfo.host
+--- @field host string host name or directory of the unix domain socket
+--- @field port string
+--- @field hostaddr string? IP address that is used instead of the host name
+--- @field socket string? pathname of the unix domain socket
+
+--- resolve_hosts pairs the comma-separated lists of the hosts, ports and
+--- hostaddrs in the same way as libpq.
+--- @param host string?
+--- @param port string?
+--- @param hostaddr string?
+--- @return postgres.conninfo.host[]? hosts
+--- @return any err
+local function resolve_hosts(host, port, hostaddr)
+    local hosts = split(host or '')
+    local ports = split(port or '')
+    if #ports == 1 then
+        -- a single port is used for all hosts
+        for i = 2, #hosts do
+            ports[i] = ports[1]
+        end
+    elseif #ports ~= #hosts then
+        return nil, errorf('could not match %d port numbers to %d hosts',
+                           #ports, #hosts)
+    end
+
+    local addrs
+    if hostaddr then
+        addrs = split(hostaddr)
+        if #addrs ~= #hosts then
+            return nil,
+                   errorf('could not match %d host names to %d hostaddr values',
+                          #hosts, #addrs)
+        end
+    end
+
+    local list = {}
+    for i, v in ipairs(hosts) do
+        if v == '' then
+            v = '127.0.0.1'
+        elseif find(v, '^%%2[fF]') then
+            -- host that starts with a slash is the directory of the unix
+            -- domain socket. it can be specified as a percent-encoded string
+            -- in the hostspec.
+            v = gsub(v, '%%(%x%x)', function(hex)
+                return char(tonumber(hex, 16))
+            end)
+        end
+
+        local elm = {
+            host = v,
+            port = ports[i] ~= '' and ports[i] or '5432',
+            hostaddr = addrs and addrs[i] ~= '' and addrs[i] or nil,
+        }
+        if find(v, '^/') and not elm.hostaddr then
+            elm.socket = v .. '/.s.PGSQL.' .. elm.port
+        end
+        list[i] = elm
+    end
+    return list
+end
+
 --- parse_conninfo
 --- @param conninfo string
 --- @return table? info
@@ -119,6 +215,21 @@ local function parse_conninfo(conninfo)
                            '"postgres://" or "postgresql://"')
         end
 
+        -- the URL parser accepts only a single host, so the comma-separated
+        -- list of hostspecs is extracted in advance
+        local hostlist
+        do
+            local head = select(2, find(conninfo, '://', 1, true)) + 1
+            local tail = (find(conninfo, '[/?]', head) or #conninfo + 1) - 1
+            local authority = sub(conninfo, head, tail)
+            local hostspec = match(authority, '@([^@]*)$') or authority
+            if find(hostspec, ',', 1, true) then
+                hostlist = hostspec
+                conninfo = sub(conninfo, 1, tail - #hostspec) ..
+                               sub(conninfo, tail + 1)
+            end
+        end
+
         -- parse connection string as URL
         local uri, pos, err = parse_url(conninfo, true)
         if err then
@@ -133,6 +244,27 @@ local function parse_conninfo(conninfo)
         -- hostspec
         info.host = uri.hostname
         info.port = uri.port
+        if hostlist then
+            local hosts, ports = {}, {}
+            for _, spec in ipairs(split(hostlist)) do
+                -- IPv6 address is enclosed in square brackets
+                local host, port = match(spec, '^%[(.*)%]:?(%d*)$')
+                if not host then
+                    host, port = match(spec, '^([^:]*):?(%d*)$')
+                    if not host then
+                        return nil, errorf('invalid hostspec %q', spec)
+                    end
+                end
+                hosts[#hosts + 1] = host
+                ports[#ports + 1] = port
+            end
+            info.host = concat(hosts, ',')
+            info.port = concat(ports, ',')
+            if find(info.port, '^,*$') then
+                -- use the default port
+                info.port = nil
+            end
+        end
         -- pathspec
         if find(uri.path or '', '^/.+') then
             info.dbname = sub(uri.path, 2)
@@ -161,21 +293,29 @@ local function parse_conninfo(conninfo)
         end
     end
 
-    -- fill default values
-    for k, v in pairs({
-        host = '127.0.0.1',
-        port = '5432',
-        dbname = info.user,
-    }) do
-        if info[k] == nil then
-            info[k] = v
+    -- resolve the comma-separated list of hosts
+    local hosts, err = resolve_hosts(info.host, info.port, params.hostaddr)
+    if not hosts then
+        return nil, err
+    end
+    info.host = hosts[1].host
+    info.port = hosts[1].port
+    info.socket = hosts[1].socket
+    if #hosts > 1 then
+        info.hosts = hosts
+    end
+    for _, host in ipairs(hosts) do
+        if host.socket and info.user == nil then
+            -- peer authentication requires the user name of the operating
+            -- system
+            info.user = getenv('USER') or getenv('LOGNAME')
         end
     end
+    if info.dbname == nil then
+        info.dbname = info.user
+    end
 
     -- TODO: check the following fields;
-    -- * host (comma-separated list of host names)
-    -- * hostaddr (comma-separated list of IP addresses)
-    -- * port (comma-separated list of ports)
     -- * user (default: username of effective user ID)
     -- * dbname (default: user)
     -- * password (PGPASSFILE or ~/.pgpass)
@@ -187,9 +327,16 @@ local function parse_conninfo(conninfo)
     -- * ssl_max_protocol_version (validate)
     -- * ssl_cert_mode (validate)
     -- * gssencmode (validate)
-    -- * target_session_attrs (validate)
-    -- * load_balance_hosts (validate)
     -- * client_encoding (validate)
+    if params.target_session_attrs and
+        not TARGET_SESSION_ATTRS[params.target_session_attrs] then
+        return nil, errorf('invalid target_session_attrs value: %q',
+                           params.target_session_attrs)
+    elseif params.load_balance_hosts and
+        not LOAD_BALANCE_HOSTS[params.load_balance_hosts] then
+        return nil, errorf('invalid load_balance_hosts value: %q',
+                           params.load_balance_hosts)
+    end
     if params.connect_timeout then
         params.connect_timeout = tonumber(params.connect_timeout)
         if not params.connect_timeout then
@@ -211,7 +358,20 @@ local function parse_conninfo(conninfo)
     end
 
     -- hostspec
-    arr[#arr + 1] = info.host .. ':' .. info.port
+    local hostspecs = {}
+    for i, host in ipairs(hosts) do
+        local name = host.host
+        if find(name, '^/') then
+            name = gsub(name, '[^%w%-%._~]', function(c)
+                return format('%%%02X', byte(c))
+            end)
+        elseif find(name, ':', 1, true) then
+            -- IPv6 address
+            name = '[' .. name .. ']'
+        end
+        hostspecs[i] = name .. ':' .. host.port
+    end
+    arr[#arr + 1] = concat(hostspecs, ',')
     -- dbname
     if info.dbname then
         arr[#arr + 1] = '/' .. info.dbname
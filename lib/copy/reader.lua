@@ -0,0 +1,104 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local errorf = require('error').format
+local instanceof = require('metamodule').instanceof
+
+--- @class postgres.copy.reader
+--- @field private conn postgres.connection?
+--- @field complete postgres.message.command_complete?
+--- @field error any
+--- @field is_timeout boolean?
+local Reader = {}
+
+--- init
+--- @param conn postgres.connection
+--- @return postgres.copy.reader
+function Reader:init(conn)
+    assert(instanceof(conn, 'postgres.connection'),
+           'conn must be a postgres.connection')
+    self.conn = conn
+    return self
+end
+
+--- read retrieves the data of the next CopyData message.
+--- it returns nil if the COPY data stream is completed.
+--- @return string? data
+--- @return any err
+--- @return boolean? timeout
+function Reader:read()
+    local conn = self.conn
+    if not conn then
+        return nil, self.error
+    end
+
+    while true do
+        -- the allowed message types are;
+        --  * CopyData
+        --  * CopyDone
+        --  * CommandComplete
+        --  * ErrorResponse
+        local res, err, timeout = conn:recv()
+        if not res then
+            if err then
+                self.error = errorf('failed to retrieve message: %s', err)
+            end
+            self.is_timeout = timeout
+            self.conn = nil
+            return nil, self.error, timeout
+        elseif res.type == 'CopyData' then
+            return res.data
+        elseif res.type ~= 'CopyDone' then
+            -- complete, error or unexpected message type
+            if res.type == 'CommandComplete' then
+                self.complete = res
+            elseif res.type == 'ErrorResponse' then
+                self.error = errorf('[%s] %s', res.severity, res.message)
+            else
+                self.error = errorf(
+                                 'CopyData|CopyDone|CommandComplete|ErrorResponse expected, got %q',
+                                 res.type)
+                -- close connection on unexpected message type
+                conn:close()
+            end
+            -- remove connection to prevent further read/close
+            self.conn = nil
+            return nil, self.error
+        end
+        -- CopyDone message is followed by CommandComplete message
+    end
+end
+
+--- close discards the remaining data of the COPY data stream
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Reader:close()
+    while self.conn do
+        self:read()
+    end
+    return self.complete ~= nil, self.error, self.is_timeout
+end
+
+return {
+    new = require('metamodule').new(Reader),
+}
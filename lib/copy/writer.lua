@@ -0,0 +1,305 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local tostring = tostring
+local gsub = string.gsub
+local concat = table.concat
+local errorf = require('error').format
+local instanceof = require('metamodule').instanceof
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local encode_copy_data = require('postgres.message.copy_data').encode
+local encode_copy_done = require('postgres.message.copy_done').encode
+local encode_copy_fail = require('postgres.message.copy_fail').encode
+--- constants
+local DEFAULT_BUFSIZE = 65536
+-- signature, flags field and header extension area length
+local BINARY_HEADER = 'PGCOPY\n\255\r\n\0' .. htonl(0) .. htonl(0)
+local BINARY_TRAILER = htons(-1)
+local NULL_VALUE = htonl(-1)
+local ESCAPE_CHARS = {
+    ['\\'] = '\\\\',
+    ['\n'] = '\\n',
+    ['\r'] = '\\r',
+    ['\t'] = '\\t',
+}
+
+--- @class postgres.copy.writer
+--- @field private conn postgres.connection?
+--- @field private format string 'text' | 'binary'
+--- @field private ncol integer
+--- @field private bufsize integer
+--- @field private chunks string[]
+--- @field private buflen integer
+--- @field private header boolean true if the binary header has been written
+--- @field private written boolean true if any data has been written
+--- @field complete postgres.message.command_complete?
+--- @field error any
+--- @field is_timeout boolean?
+local Writer = {}
+
+--- init
+--- @param conn postgres.connection
+--- @param format string 'text' | 'binary'
+--- @param ncol integer number of columns
+--- @param bufsize integer? size of the data to be sent at once (default: 65536)
+--- @return postgres.copy.writer
+function Writer:init(conn, format, ncol, bufsize)
+    assert(instanceof(conn, 'postgres.connection'),
+           'conn must be a postgres.connection')
+    assert(format == 'text' or format == 'binary',
+           'format must be "text" or "binary"')
+    assert(type(ncol) == 'number', 'ncol must be integer')
+    assert(bufsize == nil or (type(bufsize) == 'number' and bufsize > 0),
+           'bufsize must be positive integer or nil')
+    self.conn = conn
+    self.format = format
+    self.ncol = ncol
+    self.bufsize = bufsize or DEFAULT_BUFSIZE
+    self.chunks = {}
+    self.buflen = 0
+    self.header = false
+    self.written = false
+    return self
+end
+
+--- send sends the buffered data and the message
+--- @private
+--- @param msg string? message to be sent after the buffered data
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Writer:send(msg)
+    local conn = self.conn
+    local s = msg or ''
+    if self.buflen > 0 then
+        -- send the buffered data as a single CopyData message
+        s = encode_copy_data(concat(self.chunks)) .. s
+        self.chunks = {}
+        self.buflen = 0
+    end
+    if #s == 0 then
+        return true
+    end
+
+    local ok, err, timeout = conn:send(s)
+    if not ok then
+        -- the COPY data stream is broken
+        self.conn = nil
+        self.error = err
+        self.is_timeout = timeout
+        return false, err, timeout
+    end
+    return true
+end
+
+--- write writes the data to the COPY data stream.
+--- the data is buffered until the size of the buffered data exceeds bufsize.
+--- @param data string
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Writer:write(data)
+    assert(type(data) == 'string', 'data must be string')
+    if not self.conn then
+        return false, self.error or errorf('writer is closed')
+    end
+
+    local chunks = self.chunks
+    chunks[#chunks + 1] = data
+    self.buflen = self.buflen + #data
+    self.written = true
+    if self.buflen >= self.bufsize then
+        return self:send()
+    end
+    return true
+end
+
+--- write_row writes the row to the COPY data stream.
+--- in the text format, the column values are converted to strings and escaped,
+--- and nil is written as NULL.
+--- in the binary format, the column values must be strings of the binary
+--- representation of the column data types, or nil for NULL.
+--- @param row table array of the column values
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Writer:write_row(row)
+    assert(type(row) == 'table', 'row must be table')
+
+    local ncol = self.ncol
+    local s = {}
+    if self.format == 'text' then
+        for i = 1, ncol do
+            local v = row[i]
+            if v == nil then
+                v = '\\N'
+            elseif type(v) == 'boolean' then
+                v = v and 't' or 'f'
+            else
+                v = gsub(tostring(v), '[\\\n\r\t]', ESCAPE_CHARS)
+            end
+            s[i] = v
+        end
+        return self:write(concat(s, '\t') .. '\n')
+    end
+
+    s[1] = htons(ncol)
+    for i = 1, ncol do
+        local v = row[i]
+        if v == nil then
+            s[#s + 1] = NULL_VALUE
+        elseif type(v) ~= 'string' then
+            return false, errorf('column#%d must be string or nil', i)
+        else
+            s[#s + 1] = htonl(#v)
+            s[#s + 1] = v
+        end
+    end
+    s = concat(s)
+    if not self.header then
+        -- the header is written with the first valid row
+        self.header = true
+        s = BINARY_HEADER .. s
+    end
+    return self:write(s)
+end
+
+--- flush sends the buffered data
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Writer:flush()
+    if not self.conn then
+        return false, self.error or errorf('writer is closed')
+    end
+    return self:send()
+end
+
+--- wait_complete waits for the CommandComplete or ErrorResponse message
+--- @private
+--- @param conn postgres.connection
+--- @return postgres.message? res
+--- @return any err
+--- @return boolean? timeout
+function Writer:wait_complete(conn)
+    -- the allowed message types are;
+    --  * CommandComplete
+    --  * ErrorResponse
+    local res, err, timeout = conn:recv()
+    if not res then
+        if err then
+            self.error = errorf('failed to retrieve message: %s', err)
+        end
+        self.is_timeout = timeout
+        return nil, self.error, timeout
+    elseif res.type == 'CommandComplete' then
+        self.complete = res
+        return res
+    elseif res.type == 'ErrorResponse' then
+        self.error = errorf('[%s] %s', res.severity, res.message)
+        return res, self.error
+    end
+
+    self.error = errorf('CommandComplete|ErrorResponse expected, got %q',
+                        res.type)
+    -- close connection on unexpected message type
+    conn:close()
+    return nil, self.error
+end
+
+--- close sends the buffered data and the CopyDone message, and waits for the
+--- completion of the COPY command
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Writer:close()
+    local conn = self.conn
+    if not conn then
+        return self.complete ~= nil, self.error, self.is_timeout
+    end
+
+    if self.format == 'binary' and (self.header or not self.written) then
+        local chunks = self.chunks
+        if not self.header then
+            -- no rows have been written, but the binary format requires the
+            -- file header
+            self.header = true
+            chunks[#chunks + 1] = BINARY_HEADER
+            self.buflen = self.buflen + #BINARY_HEADER
+        end
+        -- file trailer of the binary format
+        chunks[#chunks + 1] = BINARY_TRAILER
+        self.buflen = self.buflen + #BINARY_TRAILER
+    end
+
+    local ok, err, timeout = self:send(encode_copy_done())
+    if not ok then
+        return false, err, timeout
+    end
+    self.conn = nil
+    local res
+    res, err, timeout = self:wait_complete(conn)
+    if res and res.type == 'CommandComplete' then
+        return true
+    end
+    return false, err, timeout
+end
+
+--- abort discards the buffered data and sends the CopyFail message to abort
+--- the COPY command.
+--- @param reason string? error message to report as the cause of failure
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Writer:abort(reason)
+    assert(reason == nil or type(reason) == 'string',
+           'reason must be string or nil')
+    local conn = self.conn
+    if not conn then
+        return false, self.error or errorf('writer is closed')
+    end
+
+    self.chunks = {}
+    self.buflen = 0
+    local ok, err, timeout = self:send(encode_copy_fail(reason or 'aborted'))
+    if not ok then
+        return false, err, timeout
+    end
+    self.conn = nil
+
+    -- the backend reports the failure with the ErrorResponse message
+    local res
+    res, err, timeout = self:wait_complete(conn)
+    if not res then
+        return false, err, timeout
+    elseif res.type ~= 'ErrorResponse' then
+        self.error = errorf('ErrorResponse expected, got %q', res.type)
+        return false, self.error
+    end
+    return true
+end
+
+return {
+    new = require('metamodule').new(Writer),
+}
@@ -1705,6 +1705,36 @@ NAME2DEC["datemultirange[]"] = decode_datemultirange_array
 OID2NAME[6157] = "int8multirange[]"
 NAME2DEC["int8multirange[]"] = decode_int8multirange_array
 
+-- oid to binary format decode function mapping table.
+-- the result columns of these types can be requested in binary format.
+local binary = require('postgres.binary')
+local OID2BIN = {
+    [16] = binary.bool, -- boolean
+    [17] = binary.bytea, -- bytea
+    [20] = binary.int8, -- bigint
+    [21] = binary.int2, -- smallint
+    [23] = binary.int4, -- integer
+    [700] = binary.float4, -- real
+    [701] = binary.float8, -- double precision
+    [1005] = binary.array, -- smallint[]
+    [1007] = binary.array, -- integer[]
+    [1016] = binary.array, -- bigint[]
+    [1021] = binary.array, -- real[]
+    [1022] = binary.array, -- double precision[]
+    [1082] = binary.date, -- date
+    [1114] = binary.timestamp, -- timestamp without time zone
+    [1184] = binary.timestamptz, -- timestamp with time zone
+    [2950] = binary.uuid, -- uuid
+}
+
+--- has_binary returns true if the binary format of the specified oid can be
+--- decoded.
+--- @param oid integer
+--- @return boolean ok
+local function has_binary(oid)
+    return OID2BIN[oid] ~= nil
+end
+
 --- @class postgres.decoder
 --- @field private oid2name table<integer, string> oid to name
 --- @field private name2dec table<string, function> name to decode function
@@ -1774,6 +1804,33 @@ function Decoder:decode_by_oid(oid, s)
     return self:decode_by_name(self.oid2name[oid], s)
 end
 
+--- get_decodefn returns the decode function for the type oid and the format
+--- of the specified field, or nil if the data string is used as is.
+--- @param field postgres.message.row_description.field
+--- @return function? decodefn
+function Decoder:get_decodefn(field)
+    if field.format == 'binary' then
+        return OID2BIN[field.type_oid]
+    end
+    local name = self.oid2name[field.type_oid]
+    return name and self.name2dec[name]
+end
+
+--- decode_by_field decodes a data string by the type oid and the format of
+--- the specified field
+--- @param field postgres.message.row_description.field
+--- @param s string
+--- @return any value
+--- @return any error
+function Decoder:decode_by_field(field, s)
+    local decodefn = self:get_decodefn(field)
+    if decodefn then
+        return decodefn(s)
+    end
+    return s
+end
+
 return {
     new = require('metamodule').new(Decoder),
+    has_binary = has_binary,
 }
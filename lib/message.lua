@@ -21,8 +21,11 @@
 --
 --- assign to local
 local sub = string.sub
+local pairs = pairs
+local type = type
 local errorf = require('error').format
 local setmetatable = setmetatable
+local codec_decode_many = require('postgres.codec').decode_many
 
 --- @class postgres.message
 --- @field consumed integer?
@@ -52,6 +55,11 @@ local DECODER = {
     ['2'] = require('postgres.message.bind_complete').decode,
     ['3'] = require('postgres.message.close_complete').decode,
     C = require('postgres.message.command_complete').decode,
+    d = require('postgres.message.copy_data').decode,
+    c = require('postgres.message.copy_done').decode,
+    G = require('postgres.message.copy_response').decode, -- CopyInResponse
+    H = require('postgres.message.copy_response').decode, -- CopyOutResponse
+    W = require('postgres.message.copy_response').decode, -- CopyBothResponse
     D = require('postgres.message.data_row').decode,
     I = require('postgres.message.empty_query_response').decode,
     E = require('postgres.message.error_response').decode,
@@ -67,6 +75,17 @@ local DECODER = {
     T = require('postgres.message.row_description').decode,
 }
 
+--- decoders of decode_many.
+--- DataRow, RowDescription and CopyData messages are decoded natively into the
+--- message object that has the following metatable.
+local DECODE_MANY = {}
+for k, v in pairs(DECODER) do
+    DECODE_MANY[k] = v
+end
+DECODE_MANY.D = require('postgres.message.data_row').metatable
+DECODE_MANY.T = require('postgres.message.row_description').metatable
+DECODE_MANY.d = require('postgres.message.copy_data').metatable
+
 --- decode_message
 --- @param s string
 --- @return table? msg
@@ -84,7 +103,27 @@ local function decode(s)
     return decoder(s)
 end
 
+--- decode_many decodes all complete messages in the buffer in one call.
+--- @param buf string|postgres.buffer
+--- @param offset? integer start position of the data (default: 1)
+--- @param limit? integer maximum number of messages to decode
+--- @param lazy? boolean set the values of DataRow to the postgres.data_row userdata that creates the column values on access
+--- @return postgres.message[]? msgs
+--- @return integer|any pos position of the first undecoded byte, or error
+local function decode_many(buf, offset, limit, lazy)
+    local msgs, pos = codec_decode_many(DECODE_MANY, buf, offset, limit, lazy)
+    if not msgs and type(pos) == 'string' then
+        return nil, errorf('%s', pos)
+    end
+    return msgs, pos
+end
+
 return {
+    decode_many = decode_many,
+    -- skip_many(type, buf, offset) skips the consecutive complete messages of
+    -- the type without decoding them, and returns the number of skipped
+    -- messages and the position of the first unskipped byte.
+    skip_many = require('postgres.codec').skip_many,
     encode = {
         authentication = require('postgres.message.authentication').encode,
         backend_key_data = require('postgres.message.backend_key_data').encode,
@@ -93,6 +132,10 @@ return {
         cancel_request = require('postgres.message.cancel_request').encode,
         close_complete = require('postgres.message.close_complete').encode,
         close = require('postgres.message.close').encode,
+        copy_data = require('postgres.message.copy_data').encode,
+        copy_done = require('postgres.message.copy_done').encode,
+        copy_fail = require('postgres.message.copy_fail').encode,
+        copy_response = require('postgres.message.copy_response').encode,
         describe = require('postgres.message.describe').encode,
         execute = require('postgres.message.execute').encode,
         flush = require('postgres.message.flush').encode,
@@ -105,6 +148,16 @@ return {
         sync = require('postgres.message.sync').encode,
         terminate = require('postgres.message.terminate').encode,
     },
+    -- write the frontend messages into the postgres.pack object
+    write = {
+        bind = require('postgres.message.bind').write,
+        close = require('postgres.message.close').write,
+        describe = require('postgres.message.describe').write,
+        execute = require('postgres.message.execute').write,
+        flush = require('postgres.message.flush').write,
+        parse = require('postgres.message.parse').write,
+        sync = require('postgres.message.sync').write,
+    },
     decode = setmetatable({
         authentication = require('postgres.message.authentication').decode,
         backend_key_data = require('postgres.message.backend_key_data').decode,
@@ -114,6 +167,10 @@ return {
         close_complete = require('postgres.message.close_complete').decode,
         close = require('postgres.message.close').decode,
         command_complete = require('postgres.message.command_complete').decode,
+        copy_data = require('postgres.message.copy_data').decode,
+        copy_done = require('postgres.message.copy_done').decode,
+        copy_fail = require('postgres.message.copy_fail').decode,
+        copy_response = require('postgres.message.copy_response').decode,
         data_row = require('postgres.message.data_row').decode,
         describe = require('postgres.message.describe').decode,
         empty_query_response = require('postgres.message.empty_query_response').decode,
@@ -24,14 +24,12 @@ local type = type
 local sub = string.sub
 local rep = string.rep
 local format = string.format
-local concat = table.concat
-local htonl = require('postgres.htonl')
-local htons = require('postgres.htons')
 local ntohs = require('postgres.ntohs')
 local unpack = require('postgres.unpack')
+local new_pack = require('postgres.pack').new
 local errorf = require('error').format
 --- constants
-local NULL = '\0'
+local PACK = new_pack()
 local FORMAT_NAMES = {
     [0] = 'text',
     [1] = 'binary',
@@ -324,38 +322,78 @@ local function decode(s)
     return msg
 end
 
---- encode
+--- write
+--- @param p postgres.pack
 --- @param portal string
 --- @param stmt string
 --- @param values string[]
---- @return string
-local function encode(portal, stmt, values)
+--- @param results? integer[] result-column format codes (0:text, 1:binary)
+--- @param formats? integer[] parameter format codes (0:text, 1:binary)
+--- @return postgres.pack p
+local function write(p, portal, stmt, values, results, formats)
     assert(type(portal) == 'string', 'portal must be string')
     assert(type(stmt) == 'string', 'stmt must be string')
     assert(type(values) == 'table', 'values must be table')
+    assert(results == nil or type(results) == 'table',
+           'results must be table or nil')
+    assert(formats == nil or type(formats) == 'table',
+           'formats must be table or nil')
+
+    p:begin('B'):cstring(portal):cstring(stmt)
+    local nvalue = #values
+    if not formats then
+        p:int16(0) -- all parameters use the default format (text)
+    else
+        -- the number of parameters is the number of format codes, and the
+        -- nil value is sent as NULL
+        nvalue = #formats
+        p:int16(nvalue) -- number of parameter format codes
+        for i = 1, nvalue do
+            if not FORMAT_NAMES[formats[i]] then
+                error(format('formats#%d must be 0 or 1', i))
+            end
+            p:int16(formats[i])
+        end
+    end
 
-    local tbl = {
-        portal,
-        NULL,
-        stmt,
-        NULL,
-        htons(0), -- number of parameter format codes
-    }
-    tbl[#tbl + 1] = htons(#values) -- number of parameter values
-    for i = 1, #values do
-        if type(values[i]) ~= 'string' then
+    p:int16(nvalue) -- number of parameter values
+    for i = 1, nvalue do
+        local v = values[i]
+        if formats and v == nil then
+            p:int32(-1) -- NULL
+        elseif type(v) ~= 'string' then
             error(format('values#%d must be string', i))
+        else
+            p:int32(#v):bytes(v)
         end
-        tbl[#tbl + 1] = htonl(#values[i])
-        tbl[#tbl + 1] = values[i]
     end
-    tbl[#tbl + 1] = htons(0) -- all result columns use the default format (text)
+    if not results then
+        p:int16(0) -- all result columns use the default format (text)
+    else
+        p:int16(#results) -- number of result-column format codes
+        for i = 1, #results do
+            if not FORMAT_NAMES[results[i]] then
+                error(format('results#%d must be 0 or 1', i))
+            end
+            p:int16(results[i])
+        end
+    end
+    return p:finish()
+end
 
-    local msg = concat(tbl)
-    return 'B' .. htonl(#msg + 4) .. msg
+--- encode
+--- @param portal string
+--- @param stmt string
+--- @param values string[]
+--- @param results? integer[] result-column format codes (0:text, 1:binary)
+--- @param formats? integer[] parameter format codes (0:text, 1:binary)
+--- @return string
+local function encode(portal, stmt, values, results, formats)
+    return write(PACK:clear(), portal, stmt, values, results, formats):data()
 end
 
 return {
     encode = encode,
+    write = write,
     decode = decode,
 }
@@ -0,0 +1,75 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local errorf = require('error').format
+local htonl = require('postgres.htonl')
+local decode_copy_data = require('postgres.codec').decode_copy_data
+
+--
+-- CopyData (F & B)
+--   Byte1('d')
+--     Identifies the message as COPY data.
+--
+--   Int32
+--     Length of message contents in bytes, including self.
+--
+--   Byten
+--     Data that forms part of a COPY data stream. Messages sent from the
+--     backend will always correspond to single data rows, but messages sent
+--     by frontends might divide the data stream arbitrarily.
+--
+
+--- @class postgres.message.copy_data : postgres.message
+--- @field data string
+local CopyData = require('metamodule').new({}, 'postgres.message')
+
+--- decode
+--- @param s string
+--- @return postgres.message.copy_data? msg
+--- @return any err
+--- @return boolean? again
+local function decode(s)
+    local msg = CopyData()
+    local ok, err, again = decode_copy_data(msg, s)
+    if ok then
+        return msg
+    elseif again then
+        return nil, nil, true
+    end
+    return nil, errorf('invalid CopyData message', err)
+end
+
+--- encode
+--- @param data string
+--- @return string s
+local function encode(data)
+    assert(type(data) == 'string', 'data must be string')
+    return 'd' .. htonl(4 + #data) .. data
+end
+
+return {
+    decode = decode,
+    encode = encode,
+    -- metatable of the message object to decode the message natively
+    metatable = getmetatable(CopyData()),
+}
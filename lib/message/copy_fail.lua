@@ -0,0 +1,94 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local sub = string.sub
+local errorf = require('error').format
+local htonl = require('postgres.htonl')
+local ntohl = require('postgres.ntohl')
+local unpack = require('postgres.unpack')
+--- constants
+local NULL = '\0'
+
+--
+-- CopyFail (F)
+--   Byte1('f')
+--     Identifies the message as a COPY-failure indicator.
+--
+--   Int32
+--     Length of message contents in bytes, including self.
+--
+--   String
+--     An error message to report as the cause of failure.
+--
+
+--- @class postgres.message.copy_fail : postgres.message
+--- @field message string
+local CopyFail = require('metamodule').new({}, 'postgres.message')
+
+--- decode
+--- @param s string
+--- @return postgres.message.copy_fail? msg
+--- @return any err
+--- @return boolean? again
+local function decode(s)
+    if #s < 1 then
+        return nil, nil, true
+    elseif sub(s, 1, 1) ~= 'f' then
+        return nil, errorf('invalid CopyFail message')
+    elseif #s < 5 then
+        return nil, nil, true
+    end
+
+    local len = ntohl(sub(s, 2))
+    if len < 5 then
+        return nil, errorf(
+                   'invalid CopyFail message: length is not greater than 4')
+    elseif #s < len + 1 then
+        return nil, nil, true
+    end
+
+    local v = {}
+    local consumed, err = unpack(v, 'b1Ls', s)
+    if err then
+        return nil, errorf('invalid CopyFail message: %s', err)
+    end
+
+    local msg = CopyFail()
+    msg.consumed = consumed
+    msg.type = 'CopyFail'
+    msg.message = v[3]
+    return msg
+end
+
+--- encode
+--- @param message string an error message to report as the cause of failure
+--- @return string s
+local function encode(message)
+    assert(type(message) == 'string', 'message must be string')
+    return 'f' .. htonl(4 + #message + 1) .. message .. NULL
+end
+
+return {
+    decode = decode,
+    encode = encode,
+}
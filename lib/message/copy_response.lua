@@ -0,0 +1,188 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local byte = string.byte
+local char = string.char
+local sub = string.sub
+local concat = table.concat
+local errorf = require('error').format
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local ntohl = require('postgres.ntohl')
+local unpack = require('postgres.unpack')
+local new_writer = require('postgres.copy.writer').new
+local new_reader = require('postgres.copy.reader').new
+
+--
+-- CopyInResponse (B)
+--   Byte1('G')
+--     Identifies the message as a Start Copy In response. The frontend must
+--     now send copy-in data (if not prepared to do so, send a CopyFail
+--     message).
+--
+-- CopyOutResponse (B)
+--   Byte1('H')
+--     Identifies the message as a Start Copy Out response. This message will
+--     be followed by copy-out data.
+--
+-- CopyBothResponse (B)
+--   Byte1('W')
+--     Identifies the message as a Start Copy Both response. This message is
+--     used only for Streaming Replication.
+--
+--   Int32
+--     Length of message contents in bytes, including self.
+--
+--   Int8
+--     0 indicates the overall COPY format is textual (rows separated by
+--     newlines, columns separated by separator characters, etc.). 1 indicates
+--     the overall copy format is binary (similar to DataRow format).
+--
+--   Int16
+--     The number of columns in the data to be copied.
+--
+--   Int16[N]
+--     The format codes to be used for each column. Each must presently be
+--     zero (text) or one (binary). All must be zero if the overall copy
+--     format is textual.
+--
+
+--- constants
+local TYPES = {
+    G = 'CopyInResponse',
+    H = 'CopyOutResponse',
+    W = 'CopyBothResponse',
+}
+local IDENTS = {
+    CopyInResponse = 'G',
+    CopyOutResponse = 'H',
+    CopyBothResponse = 'W',
+}
+
+--- @class postgres.message.copy_response : postgres.message
+--- @field format string 'text' | 'binary'
+--- @field formats string[] format of each column
+local CopyResponse = {}
+
+--- get_writer returns the writer to send the COPY data stream
+--- @param bufsize integer? size of the data to be sent at once
+--- @return postgres.copy.writer? writer
+function CopyResponse:get_writer(bufsize)
+    if self.type == 'CopyInResponse' then
+        return new_writer(self.conn, self.format, #self.formats, bufsize)
+    end
+end
+
+--- get_reader returns the reader to receive the COPY data stream
+--- @return postgres.copy.reader? reader
+function CopyResponse:get_reader()
+    if self.type == 'CopyOutResponse' then
+        return new_reader(self.conn)
+    end
+end
+
+CopyResponse = require('metamodule').new(CopyResponse, 'postgres.message')
+
+--- decode
+--- @param s string
+--- @return postgres.message.copy_response? msg
+--- @return any err
+--- @return boolean? again
+local function decode(s)
+    if #s < 1 then
+        return nil, nil, true
+    end
+
+    local ident = TYPES[sub(s, 1, 1)]
+    if not ident then
+        return nil, errorf('invalid CopyResponse message')
+    elseif #s < 5 then
+        return nil, nil, true
+    end
+
+    local len = ntohl(sub(s, 2))
+    if len < 7 then
+        return nil, errorf(
+                   'invalid %s message: length is not greater than 6', ident)
+    elseif #s < len + 1 then
+        return nil, nil, true
+    end
+
+    local v = {}
+    local consumed, err = unpack(v, 'b1Lb1h', s)
+    if err then
+        return nil, errorf('invalid %s message: %s', ident, err)
+    elseif v[4] < 0 or len ~= 7 + v[4] * 2 then
+        -- the format codes must fill the rest of the message exactly
+        return nil, errorf(
+                   'invalid %s message: length %d does not match the number of columns %d',
+                   ident, len, v[4])
+    end
+    -- unpack exactly the number of format codes specified by the Int16 field
+    consumed, err = unpack(v, 'b1Lb1hh*', s)
+    if err then
+        return nil, errorf('invalid %s message: %s', ident, err)
+    end
+
+    local formats = {}
+    for i = 1, v[4] do
+        formats[i] = v[4 + i] == 0 and 'text' or 'binary'
+    end
+
+    local msg = CopyResponse()
+    msg.consumed = consumed
+    msg.type = ident
+    msg.format = byte(v[3]) == 0 and 'text' or 'binary'
+    msg.formats = formats
+    return msg
+end
+
+--- encode
+--- @param ident string 'CopyInResponse', 'CopyOutResponse' or 'CopyBothResponse'
+--- @param format string 'text' or 'binary'
+--- @param ncol integer number of columns
+--- @return string s
+local function encode(ident, format, ncol)
+    assert(IDENTS[ident],
+           'ident must be "CopyInResponse", "CopyOutResponse" or "CopyBothResponse"')
+    assert(format == 'text' or format == 'binary',
+           'format must be "text" or "binary"')
+    assert(type(ncol) == 'number' and ncol >= 0 and ncol % 1 == 0,
+           'ncol must be unsigned integer')
+
+    local code = format == 'text' and 0 or 1
+    local s = {
+        char(code),
+        htons(ncol),
+    }
+    for i = 1, ncol do
+        s[i + 2] = htons(code)
+    end
+    s = concat(s)
+    return IDENTS[ident] .. htonl(4 + #s) .. s
+end
+
+return {
+    decode = decode,
+    encode = encode,
+}
@@ -22,13 +22,12 @@
 --- assign to local
 local type = type
 local sub = string.sub
-local concat = table.concat
 local errorf = require('error').format
-local htonl = require('postgres.htonl')
 local ntohl = require('postgres.ntohl')
 local unpack = require('postgres.unpack')
+local new_pack = require('postgres.pack').new
 --- constants
-local NULL = '\0'
+local PACK = new_pack()
 
 --
 -- Describe (F)
@@ -94,25 +93,31 @@ local function decode(s)
     return msg
 end
 
---- encode
+--- write
+--- @param p postgres.pack
 --- @param target string # target must be 'statement' or 'portal'
 --- @param name string # name of the prepared statement or portal to describe
---- @return string s
-local function encode(target, name)
+--- @return postgres.pack p
+local function write(p, target, name)
     assert(type(target) == 'string' and
                (target == 'statement' or target == 'portal'),
            'target must be "statement" or "portal"')
     assert(type(name) == 'string', 'portal must be string')
 
-    local s = concat({
-        target == 'statement' and 'S' or 'P',
-        name,
-        NULL,
-    })
-    return 'D' .. htonl(4 + #s) .. s
+    return p:begin('D'):bytes(target == 'statement' and 'S' or 'P')
+               :cstring(name):finish()
+end
+
+--- encode
+--- @param target string # target must be 'statement' or 'portal'
+--- @param name string # name of the prepared statement or portal to describe
+--- @return string s
+local function encode(target, name)
+    return write(PACK:clear(), target, name):data()
 end
 
 return {
     encode = encode,
+    write = write,
     decode = decode,
 }
@@ -21,15 +21,16 @@
 --
 --- assign to local
 local type = type
-local htonl = require('postgres.htonl')
+local new_pack = require('postgres.pack').new
 --- constants
-local NULL = '\0'
+local PACK = new_pack()
 
---- encode
+--- write
+--- @param p postgres.pack
 --- @param portal string
 --- @param max_rows integer?
---- @return string
-local function encode(portal, max_rows)
+--- @return postgres.pack p
+local function write(p, portal, max_rows)
     assert(type(portal) == 'string', 'portal must be string')
     assert(max_rows == nil or type(max_rows) == 'number',
            'max_rows must be integer or nil')
@@ -49,10 +50,18 @@ local function encode(portal, max_rows)
     --     Maximum number of rows to return, if portal contains a query that
     --     returns rows (ignored otherwise). Zero denotes “no limit”.
     --
-    return 'E' .. htonl(4 + #portal + 1 + 4) .. portal .. NULL ..
-               htonl(max_rows or 0)
+    return p:begin('E'):cstring(portal):int32(max_rows or 0):finish()
+end
+
+--- encode
+--- @param portal string
+--- @param max_rows integer?
+--- @return string
+local function encode(portal, max_rows)
+    return write(PACK:clear(), portal, max_rows):data()
 end
 
 return {
     encode = encode,
+    write = write,
 }
@@ -21,18 +21,21 @@
 --
 --- assign to local
 local type = type
-local htonl = require('postgres.htonl')
-local htons = require('postgres.htons')
+local format = string.format
+local new_pack = require('postgres.pack').new
 --- constants
-local NULL = '\0'
+local PACK = new_pack()
 
---- encode
+--- write
+--- @param p postgres.pack
 --- @param stmt string
 --- @param query string
---- @return string
-local function encode(stmt, query)
+--- @param oids? integer[] object IDs of the parameter data types
+--- @return postgres.pack p
+local function write(p, stmt, query, oids)
     assert(type(stmt) == 'string', 'stmt must be string')
     assert(type(query) == 'string', 'query must be string')
+    assert(oids == nil or type(oids) == 'table', 'oids must be table or nil')
     --
     -- Parse (F)
     --   Byte1('P')
@@ -60,11 +63,31 @@ local function encode(stmt, query)
     --     Specifies the object ID of the parameter data type. Placing a zero
     --     here is equivalent to leaving the type unspecified.
     --
-    return
-        'P' .. htonl(4 + #stmt + 1 + #query + 1 + 2) .. stmt .. NULL .. query ..
-            NULL .. htons(0)
+    p:begin('P'):cstring(stmt):cstring(query)
+    if not oids then
+        return p:int16(0):finish()
+    end
+
+    p:int16(#oids) -- number of parameter data types
+    for i = 1, #oids do
+        if type(oids[i]) ~= 'number' then
+            error(format('oids#%d must be integer', i))
+        end
+        p:int32(oids[i])
+    end
+    return p:finish()
+end
+
+--- encode
+--- @param stmt string
+--- @param query string
+--- @param oids? integer[] object IDs of the parameter data types
+--- @return string
+local function encode(stmt, query, oids)
+    return write(PACK:clear(), stmt, query, oids):data()
 end
 
 return {
     encode = encode,
+    write = write,
 }
@@ -20,14 +20,9 @@
 -- THE SOFTWARE.
 --
 --- assign to local
-local find = string.find
-local sub = string.sub
 local errorf = require('error').format
-local ntohl = require('postgres.ntohl')
-local ntohs = require('postgres.ntohs')
+local decode_row_description = require('postgres.codec').decode_row_description
 local new_rows = require('postgres.rows').new
---- constants
-local NULL = '\0'
 
 --- @class postgres.message.row_description.field
 --- @field col integer
@@ -98,68 +93,18 @@ local function decode(s)
     --     statement variant of Describe, the format code is not yet known and
     --     will always be zero.
     --
-    if #s < 5 then
-        return nil, nil, true
-    elseif sub(s, 1, 1) ~= 'T' then
-        return nil, errorf('invalid RowDescription message')
-    end
-
-    local len = ntohl(sub(s, 2))
-    local consumed = len + 1
-    if #s < consumed then
+    local msg = RowDescription()
+    local ok, err, again = decode_row_description(msg, s)
+    if ok then
+        return msg
+    elseif again then
         return nil, nil, true
     end
-
-    local nfield = ntohs(sub(s, 6))
-    local fields = {} --- @type postgres.message.row_description.field[]
-    local head = 8
-    for i = 1, nfield do
-        local tail = find(s, NULL, head, true)
-        if not tail or tail > consumed then
-            return nil, errorf('invalid RowDescription message')
-        end
-
-        -- field name
-        local name = sub(s, head, tail - 1)
-        head = tail + 1
-        -- table object ID
-        local table_oid = ntohl(sub(s, head))
-        head = head + 4
-        -- attribute number of the column
-        local table_col = ntohs(sub(s, head))
-        head = head + 2
-        -- object ID of the field's data type
-        local type_oid = ntohl(sub(s, head))
-        head = head + 4
-        -- data type size
-        local size = ntohs(sub(s, head))
-        head = head + 2
-        -- type modifier
-        local modifier = ntohl(sub(s, head))
-        head = head + 4
-        -- format code
-        local format = ntohs(sub(s, head))
-        head = head + 2
-        fields[i] = {
-            col = i,
-            name = name,
-            table_oid = table_oid,
-            table_col = table_col,
-            format = format == 0 and 'text' or 'binary',
-            type_oid = type_oid,
-            size = size,
-            modifier = modifier,
-        }
-        fields[name] = fields[i]
-    end
-
-    local msg = RowDescription()
-    msg.consumed = consumed
-    msg.type = 'RowDescription'
-    msg.fields = fields
-    return msg
+    return nil, errorf('invalid RowDescription message', err)
 end
 
 return {
     decode = decode,
+    -- metatable of the message object to decode the message natively
+    metatable = getmetatable(RowDescription()),
 }
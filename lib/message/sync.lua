@@ -22,6 +22,16 @@
 --- assign to local
 local htonl = require('postgres.htonl')
 
+--- constants
+local MSG = 'S' .. htonl(4)
+
+--- write
+--- @param p postgres.pack
+--- @return postgres.pack p
+local function write(p)
+    return p:bytes(MSG)
+end
+
 --- encode
 --- @return string
 local function encode()
@@ -33,9 +43,10 @@ local function encode()
     --   Int32(4)
     --     Length of message contents in bytes, including self.
     --
-    return 'S' .. htonl(4)
+    return MSG
 end
 
 return {
     encode = encode,
+    write = write,
 }
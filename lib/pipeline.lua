@@ -0,0 +1,276 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local errorf = require('error').format
+local instanceof = require('metamodule').instanceof
+local new_pack = require('postgres.pack').new
+local write_message = require('postgres.message').write
+local write_parse = write_message.parse
+local write_bind = write_message.bind
+local write_describe = write_message.describe
+local write_execute = write_message.execute
+local write_sync = write_message.sync
+--- constants
+--- message types that end the result of the query
+local END_OF_QUERY = {
+    CommandComplete = true,
+    PortalSuspended = true,
+}
+
+--- @class postgres.pipeline
+--- @field private conn postgres.connection
+--- @field private pack postgres.pack messages of the queued queries
+--- @field private nquery integer number of the queued queries
+--- @field private idx integer index of the query of the current result
+--- @field private expect string? message type expected for the current query
+--- @field private inrows boolean true if the DataRow messages may remain
+--- @field private synced boolean
+--- @field private aborted boolean
+--- @field private done boolean
+local Pipeline = {}
+
+--- init
+--- @param conn postgres.connection
+--- @return postgres.pipeline
+function Pipeline:init(conn)
+    assert(instanceof(conn, 'postgres.connection'),
+           'conn must be a postgres.connection')
+    self.conn = conn
+    self.pack = new_pack()
+    self.nquery = 0
+    self.idx = 0
+    self.inrows = false
+    self.synced = false
+    self.aborted = false
+    self.done = false
+    return self
+end
+
+--- size returns the number of the queued queries
+--- @return integer
+function Pipeline:size()
+    return self.nquery
+end
+
+--- add queues the query into the pipeline
+--- @param query string|postgres.connection.template
+--- @param params table<string, any>?
+--- @return integer? idx index of the query in the pipeline
+--- @return any err
+function Pipeline:add(query, params)
+    assert(type(query) == 'string' or
+               instanceof(query, 'postgres.connection.template'),
+           'query must be string or postgres.connection.template')
+    assert(params == nil or type(params) == 'table',
+           'params must be table or nil')
+    if self.synced then
+        return nil, errorf('pipeline has already been synced')
+    end
+
+    local qry, err, values = self.conn:replace_named_params(query,
+                                                           params or {})
+    if not qry then
+        return nil, err
+    end
+
+    local p = self.pack
+    -- the possible responses are:
+    --  * ParseComplete
+    --  * BindComplete
+    --  * RowDescription or NoData
+    --  * DataRow
+    --  * CommandComplete or EmptyQueryResponse
+    --  * ErrorResponse
+    write_parse(p, '', qry) -- unnamed statement
+    write_bind(p, '', '', values) -- unnamed portal and statement
+    write_describe(p, 'portal', '') -- unnamed portal
+    write_execute(p, '') -- unnamed portal
+    self.nquery = self.nquery + 1
+    return self.nquery
+end
+
+--- sync sends the queued queries and a Sync message at once
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Pipeline:sync()
+    if self.synced then
+        return false, errorf('pipeline has already been synced')
+    end
+
+    local conn = self.conn
+    local ok, err, timeout = conn:wait_ready()
+    if not ok then
+        if err then
+            err = errorf('connection is not ready', err)
+        end
+        return false, err, timeout
+    end
+
+    ok, err, timeout = conn:send(write_sync(self.pack):data())
+    if not ok then
+        return false, err, timeout
+    end
+    self.pack:clear()
+    self.synced = true
+    return true
+end
+
+--- next retrieves the result of the next query.
+--- the result is the first message of the following messages;
+---  * RowDescription: the DataRow messages can be retrieved by get_rows()
+---  * CommandComplete
+---  * EmptyQueryResponse
+---  * ErrorResponse
+--- if the rows are discarded and the query fails partway through them, the
+--- ErrorResponse of that query is returned by the next call.
+--- if a query fails, the subsequent queries are not executed and it returns
+--- nil and error for each of them.
+--- it returns nil if the results of all queries have been retrieved.
+--- @return postgres.message? res
+--- @return any err
+--- @return boolean? timeout
+function Pipeline:next()
+    if not self.synced then
+        return nil, errorf('pipeline is not synced')
+    end
+
+    local conn = self.conn
+    -- the rows object may have retrieved the end of the current query
+    local complete = self.inrows and
+                         END_OF_QUERY[conn:last_message_type()] or false
+    -- discard the remaining rows of the current query
+    while self.inrows do
+        local msg, err, timeout = conn:recv(true)
+        if not msg then
+            return nil, err, timeout
+        elseif msg.type == 'ParseComplete' then
+            -- the rows have been retrieved by the rows object
+            self.inrows = false
+            self.idx = self.idx + 1
+            self.expect = 'BindComplete'
+        elseif msg.type == 'CommandComplete' then
+            self.inrows = false
+        elseif msg.type == 'ErrorResponse' then
+            self.inrows = false
+            self.aborted = true
+            if complete then
+                -- the next query failed before ParseComplete, e.g. syntax
+                -- error
+                self.idx = self.idx + 1
+            end
+            -- otherwise the current query failed while returning the rows
+            return msg
+        elseif msg.type == 'ReadyForQuery' then
+            self.inrows = false
+            if self.idx < self.nquery then
+                -- the rows object has retrieved the ErrorResponse message
+                self.aborted = true
+            end
+        elseif msg.type ~= 'DataRow' then
+            return nil, errorf(
+                       'DataRow|CommandComplete|ErrorResponse expected, got %q',
+                       msg.type)
+        end
+    end
+
+    if not self.expect then
+        if self.aborted or self.idx >= self.nquery then
+            -- wait for the ReadyForQuery message of the Sync message
+            local ok, err, timeout = conn:wait_ready()
+            if not ok then
+                return nil, err, timeout
+            end
+            self.done = true
+            if self.idx < self.nquery then
+                self.idx = self.idx + 1
+                return nil, errorf(
+                           'query#%d was not executed due to the previous error',
+                           self.idx)
+            end
+            return nil
+        end
+        self.idx = self.idx + 1
+        self.expect = 'ParseComplete'
+    end
+
+    while true do
+        local msg, err, timeout = conn:recv()
+        if not msg then
+            return nil, err, timeout
+        end
+
+        local expect = self.expect
+        if msg.type == 'ErrorResponse' then
+            -- the backend discards the subsequent messages until the Sync
+            -- message
+            self.expect = nil
+            self.aborted = true
+            return msg
+        elseif expect == 'RowDescription' and msg.type == 'NoData' then
+            self.expect = 'CommandComplete'
+        elseif expect == 'CommandComplete' and msg.type ==
+            'EmptyQueryResponse' then
+            self.expect = nil
+            return msg
+        elseif msg.type ~= expect then
+            return nil, errorf('%s|ErrorResponse expected, got %q', expect,
+                               msg.type)
+        elseif expect == 'ParseComplete' then
+            self.expect = 'BindComplete'
+        elseif expect == 'BindComplete' then
+            self.expect = 'RowDescription'
+        else
+            -- RowDescription or CommandComplete
+            self.expect = nil
+            self.inrows = expect == 'RowDescription'
+            return msg
+        end
+    end
+end
+
+--- close discards the remaining results and waits for the ReadyForQuery
+--- message.
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Pipeline:close()
+    if not self.synced then
+        -- discard the queued queries
+        self.pack:clear()
+        self.nquery = 0
+        return true
+    end
+
+    while not self.done do
+        local res, err, timeout = self:next()
+        if not res and not self.done then
+            return false, err, timeout
+        end
+    end
+    return true
+end
+
+return {
+    new = require('metamodule').new(Pipeline),
+}
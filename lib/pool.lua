@@ -20,30 +20,65 @@
 -- THE SOFTWARE.
 --
 --- assign to local
+local concat = table.concat
+local find = string.find
+local pairs = pairs
 local select = select
 local type = type
+local running = coroutine.running
+local yield = coroutine.yield
+local gettime = require('time.clock').gettime
 local new_deadline = require('time.clock.deadline').new
+local new_denque = require('denque').new
 local errorf = require('error').format
 local instanceof = require('metamodule').instanceof
 local parse_conninfo = require('postgres.conninfo')
 local new_queue = require('postgres.pool.queue').new
 local new_connection = require('postgres.pool.connection').new
+local new_stats = require('postgres.pool.stats').new
 
 --- @class postgres.pool
 --- @field private queue denque
 --- @field private maxconn integer max number of connections
 --- @field private maxidle integer max number of idle connections
 --- @field private chkintvl number interval to check alive in seconds
+--- @field private minidle integer min number of idle connections to keep
+--- @field private maxlife number max lifetime of connections in seconds
 --- @field private queue_used postgres.pool.queue
 --- @field private queue_idle postgres.pool.queue
+--- @field private waiters table<string, denque> FIFO queues of postgres.pool.waiter for each conninfo
+--- @field private nwaiting integer number of waiters in the queues
+--- @field private handoffs table<postgres.pool.waiter, boolean> waiters that have not yet taken the handed off connection
+--- @field private wakefn fun(co:thread)? function to wake the waiting coroutine
+--- @field private wstats postgres.pool.wait_stats
+--- @field private stats postgres.pool.stats
+--- @field private readers table<string, string> conninfo to reader conninfo
 local Pool = {}
 
+--- @class postgres.pool.waiter
+--- @field co thread
+--- @field conninfo string
+--- @field deadline time.clock.deadline
+--- @field started_at number
+--- @field elm denque.element?
+--- @field conn postgres.pool.connection? connection handed off by release
+
+--- @class postgres.pool.wait_stats
+--- @field waiting integer number of waiters in the queue
+--- @field waits integer number of completed waits
+--- @field handoffs integer number of connections handed off by release
+--- @field timeouts integer number of waits that reached the deadline
+--- @field total_wait number total wait time in seconds
+--- @field max_wait number maximum wait time in seconds
+
 --- init
 --- @param maxconn integer?
 --- @param maxidle integer?
 --- @param chkintvl number?
+--- @param minidle integer?
+--- @param maxlife number?
 --- @return postgres.pool
-function Pool:init(maxconn, maxidle, chkintvl)
+function Pool:init(maxconn, maxidle, chkintvl, minidle, maxlife)
     -- max number of connections (default no-limit)
     assert(maxconn == nil or type(maxconn) == 'number' and maxconn == maxconn,
            'maxconn must be number or nil')
@@ -66,10 +101,33 @@ function Pool:init(maxconn, maxidle, chkintvl)
            'chkintvl must be positive number or nil')
     self.chkintvl = math.floor(chkintvl or 30)
 
+    -- min number of idle connections (default 0)
+    assert(minidle == nil or type(minidle) == 'number' and minidle == minidle and
+               minidle <= maxidle,
+           'minidle must be nil or number less than or equal to maxidle')
+    self.minidle = minidle and minidle > 0 and math.floor(minidle) or 0
+
+    -- max lifetime in seconds (default 0 means unlimited)
+    assert(maxlife == nil or type(maxlife) == 'number' and maxlife == maxlife and
+               maxlife >= 0, 'maxlife must be positive number or nil')
+    self.maxlife = maxlife and maxlife < math.huge and maxlife or 0
+
     self.maxconn = maxconn
     self.maxidle = maxidle
     self.queue_used = new_queue()
     self.queue_idle = new_queue()
+    self.waiters = {}
+    self.nwaiting = 0
+    self.handoffs = {}
+    self.wstats = {
+        waits = 0,
+        handoffs = 0,
+        timeouts = 0,
+        total_wait = 0,
+        max_wait = 0,
+    }
+    self.stats = new_stats()
+    self.readers = {}
     return self
 end
 
@@ -85,6 +143,8 @@ function Pool:shutdown()
         conn = self.queue_idle:shift()
     end
     self.queue_idle = nil
+    -- wake the waiters to return the error
+    self:wake_waiters()
     return nconn
 end
 
@@ -106,7 +166,7 @@ function Pool:close()
         end
         self.queue_used = nil
     end
-
+    self.handoffs = {}
     return nconn
 end
 
@@ -128,15 +188,168 @@ function Pool:size_idle()
     return self.queue_idle and self.queue_idle:size() or 0
 end
 
+--- size_waiting
+--- @return integer
+function Pool:size_waiting()
+    return self.nwaiting
+end
+
+--- wait_stats
+--- @return postgres.pool.wait_stats stats
+function Pool:wait_stats()
+    local stats = {
+        waiting = self.nwaiting,
+    }
+    for k, v in pairs(self.wstats) do
+        stats[k] = v
+    end
+    return stats
+end
+
+--- get_stats
+--- @return table stats
+function Pool:get_stats()
+    return self.stats:snapshot()
+end
+
+--- reset_stats
+function Pool:reset_stats()
+    self.stats:reset()
+end
+
+--- set_wake_handler sets the function to wake the waiting coroutine.
+--- the function is called with the coroutine when a connection is handed
+--- off to the waiter, or the waiter may be able to acquire a connection.
+--- it must not resume the coroutine directly, but schedule it to be resumed
+--- by the caller of the coroutine.
+--- @param wakefn fun(co:thread)?
+function Pool:set_wake_handler(wakefn)
+    assert(wakefn == nil or type(wakefn) == 'function',
+           'wakefn must be function or nil')
+    self.wakefn = wakefn
+end
+
+--- wake calls the wake function with the coroutine of the waiter
+--- @private
+--- @param waiter postgres.pool.waiter?
+function Pool:wake(waiter)
+    if waiter and self.wakefn then
+        self.wakefn(waiter.co)
+    end
+end
+
+--- wake_waiters wakes the oldest waiter of each conninfo
+--- @private
+function Pool:wake_waiters()
+    if self.wakefn then
+        for _, queue in pairs(self.waiters) do
+            local elm = queue:head()
+            self:wake(elm and elm:data())
+        end
+    end
+end
+
+--- remove_waiter removes the waiter from the queue of its conninfo, and
+--- wakes the next waiter
+--- @private
+--- @param waiter postgres.pool.waiter
+function Pool:remove_waiter(waiter)
+    local elm = waiter.elm
+    if elm then
+        local queue = self.waiters[waiter.conninfo]
+        local is_head = queue:head() == elm
+        waiter.elm = nil
+        elm:remove()
+        self.nwaiting = self.nwaiting - 1
+        elm = queue:head()
+        if not elm then
+            self.waiters[waiter.conninfo] = nil
+        elseif is_head then
+            self:wake(elm:data())
+        end
+    end
+end
+
+--- handoff hands off the connection to the oldest waiter for the same
+--- conninfo. the waiters that have reached the deadline are skipped, and
+--- they return the timeout when they are resumed.
+--- @private
+--- @param conn postgres.pool.connection
+--- @return boolean ok
+function Pool:handoff(conn)
+    local queue = self.waiters[conn:get_conninfo()]
+    local elm = queue and queue:head()
+    while elm do
+        --- @type postgres.pool.waiter
+        local waiter = elm:data()
+        elm = elm:next()
+        self:remove_waiter(waiter)
+        if waiter.deadline:remain() > 0 then
+            waiter.conn = conn
+            self.handoffs[waiter] = true
+            self.queue_used:push(conn)
+            self.wstats.handoffs = self.wstats.handoffs + 1
+            self:wake(waiter)
+            return true
+        end
+    end
+    return false
+end
+
+--- reclaim returns the connections that are handed off to the waiters but
+--- not taken by the deadline, e.g. the waiting coroutine has been abandoned.
+--- @private
+function Pool:reclaim()
+    local conns = {}
+    for waiter in pairs(self.handoffs) do
+        if waiter.deadline:remain() <= 0 then
+            self.handoffs[waiter] = nil
+            conns[#conns + 1] = waiter.conn
+            waiter.conn = nil
+        end
+    end
+
+    for i = 1, #conns do
+        local conn = conns[i]
+        self.queue_used:remove(conn)
+        self:put(conn)
+    end
+end
+
+--- connect creates a new connection and records the duration
+--- @private
+--- @param conninfo string
+--- @return postgres.pool.connection? conn
+--- @return any err
+--- @return boolean? timeout
+function Pool:connect(conninfo)
+    local t = gettime()
+    local conn, err, timeout = new_connection(conninfo)
+    self.stats:connect(conninfo, gettime() - t, conn ~= nil)
+    return conn, err, timeout
+end
+
+--- discard closes the connection and counts the eviction
+--- @private
+--- @param conn postgres.pool.connection
+--- @param reason string
+function Pool:discard(conn, reason)
+    self.stats:evict(conn:get_conninfo(), reason)
+    conn:close()
+end
+
 --- get
 --- @param conninfo string?
+--- @param timeout number? seconds to wait for a connection when the pool is full
 --- @return postgres.pool.connection? conn
 --- @return any err
 --- @return boolean? again
 --- @return boolean? timeout
-function Pool:get(conninfo)
+function Pool:get(conninfo, timeout)
     assert(conninfo == nil or type(conninfo) == 'string',
            'conninfo must be string or nil')
+    assert(timeout == nil or (type(timeout) == 'number' and timeout >= 0),
+           'timeout must be unsigned number or nil')
 
     if not self.queue_idle then
         return nil, errorf(
@@ -146,18 +359,157 @@ function Pool:get(conninfo)
     if not conninfo then
         conninfo = select(3, parse_conninfo(''))
     end
+    self:reclaim()
+
+    -- the waiters for the same conninfo are served first
+    if timeout and self.waiters[conninfo] then
+        return self:wait(conninfo, timeout)
+    end
+
+    local conn, err, again, is_timeout = self:acquire(conninfo)
+    if again and timeout then
+        return self:wait(conninfo, timeout)
+    end
+    return conn, err, again, is_timeout
+end
+
+--- get_reader gets a connection for read-only queries.
+--- the connection prefers the standby servers of the multi-host conninfo, and
+--- new connections are spread across the hosts at random.
+--- the reader connections are pooled separately from the connections of the
+--- specified conninfo.
+--- @param conninfo string?
+--- @param timeout number? seconds to wait for a connection when the pool is full
+--- @return postgres.pool.connection? conn
+--- @return any err
+--- @return boolean? again
+--- @return boolean? timeout
+function Pool:get_reader(conninfo, timeout)
+    assert(conninfo == nil or type(conninfo) == 'string',
+           'conninfo must be string or nil')
+
+    local key = conninfo or ''
+    local reader = self.readers[key]
+    if not reader then
+        local info, err, normalized = parse_conninfo(key)
+        if not info then
+            return nil, err
+        end
+
+        local params = {
+            'load_balance_hosts=random',
+        }
+        local attrs = info.params.target_session_attrs
+        if attrs == nil or attrs == 'any' then
+            params[2] = 'target_session_attrs=prefer-standby'
+        end
+        reader = select(3, parse_conninfo(normalized ..
+                                              (find(normalized, '?', 1, true) and
+                                                  '&' or '?') ..
+                                              concat(params, '&')))
+        self.readers[key] = reader
+    end
+    return self:get(reader, timeout)
+end
+
+--- wait waits in the FIFO queue of the conninfo until a connection is handed
+--- off by release or the pool has room for a new connection.
+--- the running coroutine yields nil, 'wait' and the remaining seconds, and
+--- the caller must resume the coroutine later, or when the wake function is
+--- called with the coroutine.
+--- @private
+--- @param conninfo string
+--- @param timeout number
+--- @return postgres.pool.connection? conn
+--- @return any err
+--- @return boolean? again
+--- @return boolean? timeout
+function Pool:wait(conninfo, timeout)
+    local co, ismain = running()
+    if not co or ismain then
+        -- cannot suspend the main thread
+        return nil, nil, true
+    end
+
+    local queue = self.waiters[conninfo]
+    if not queue then
+        queue = new_denque()
+        self.waiters[conninfo] = queue
+    end
+    --- @type postgres.pool.waiter
+    local waiter = {
+        co = co,
+        conninfo = conninfo,
+        deadline = new_deadline(timeout),
+        started_at = gettime(),
+    }
+    waiter.elm = queue:push(waiter)
+    self.nwaiting = self.nwaiting + 1
+
+    local conn, err, again, is_timeout
+    while true do
+        local remain = waiter.deadline:remain()
+        if waiter.conn then
+            -- connection has been handed off
+            conn = waiter.conn
+            waiter.conn = nil
+            self.handoffs[waiter] = nil
+            break
+        elseif not self.queue_idle then
+            err = errorf(
+                      'connections cannot be retrieved from closed or shutdown pool')
+            break
+        elseif waiter.elm and queue:head() == waiter.elm then
+            -- the oldest waiter tries to acquire a connection
+            conn, err, again, is_timeout = self:acquire(conninfo)
+            if not again then
+                break
+            end
+        end
+
+        if remain <= 0 then
+            self.wstats.timeouts = self.wstats.timeouts + 1
+            again, is_timeout = nil, true
+            break
+        end
+        yield(nil, 'wait', remain)
+    end
 
+    self:remove_waiter(waiter)
+    local elapsed = gettime() - waiter.started_at
+    self.stats:wait(conninfo, elapsed)
+    local wstats = self.wstats
+    wstats.waits = wstats.waits + 1
+    wstats.total_wait = wstats.total_wait + elapsed
+    if elapsed > wstats.max_wait then
+        wstats.max_wait = elapsed
+    end
+    return conn, err, again, is_timeout
+end
+
+--- acquire gets the idle connection or create a new connection
+--- @private
+--- @param conninfo string
+--- @return postgres.pool.connection? conn
+--- @return any err
+--- @return boolean? again
+--- @return boolean? timeout
+function Pool:acquire(conninfo)
     -- get connection from the idle queue
     local conn = self.queue_idle:pop(conninfo)
     while conn do
-        -- check connection is alive
-        if conn:checkalive() then
+        -- check connection is alive and not expired
+        if conn:is_expired(self.maxlife) then
+            self:discard(conn, 'lifetime')
+        elseif conn:checkalive() then
             -- push to the used queue
             self.queue_used:push(conn)
+            self.stats:hit(conninfo)
             return conn
+        else
+            -- not alive
+            self:discard(conn, 'dead')
         end
-        -- not alive
-        conn:close()
 
         -- get next connection
         conn = self.queue_idle:pop(conninfo)
@@ -171,12 +523,12 @@ function Pool:get(conninfo)
             return nil, nil, true
         end
         -- close the connection
-        conn:close()
+        self:discard(conn, 'maxconn')
     end
 
     -- create new connection
     local err, timeout
-    conn, err, timeout = new_connection(conninfo)
+    conn, err, timeout = self:connect(conninfo)
     if not conn then
         return nil, err, nil, timeout
     end
@@ -207,9 +559,17 @@ function Pool:release(conn, destroy)
     -- remove from the used queue
     assert(self.queue_used:remove(conn),
            'connection is not managed by this pool')
-    -- close connection if destroy argument is true or pool is shutdown
+    self:reclaim()
+    -- close connection if destroy argument is true, pool is shutdown or the
+    -- connection is expired
     if destroy or not self.queue_idle then
         conn:close()
+        -- the waiters may be able to create a new connection
+        self:wake_waiters()
+        return true
+    elseif conn:is_expired(self.maxlife) then
+        self:discard(conn, 'lifetime')
+        self:wake_waiters()
         return true
     end
 
@@ -217,18 +577,38 @@ function Pool:release(conn, destroy)
     local ok, err, timeout = conn:wait_ready()
     if not ok then
         -- connection closed by server
+        self:wake_waiters()
         return false, err, timeout
     end
 
+    self:put(conn)
+    return true
+end
+
+--- put hands off the released connection to the oldest waiter for the same
+--- conninfo, or pushes it to the idle queue
+--- @private
+--- @param conn postgres.pool.connection
+function Pool:put(conn)
+    if not self.queue_idle then
+        -- pool is shutdown
+        conn:close()
+        return
+    elseif self:handoff(conn) then
+        return
+    end
+
     -- push to the idle queue
     self.queue_idle:push(conn)
     while self.queue_idle:size() > self.maxidle do
         -- remove the oldest connection from the idle queue
         --- @type postgres.pool.connection
         conn = self.queue_idle:shift()
-        conn:close()
+        self:discard(conn, 'maxidle')
     end
-    return true
+    -- the waiters for the other conninfo may be able to replace the idle
+    -- connection
+    self:wake_waiters()
 end
 
 --- evict idle connections
@@ -247,7 +627,7 @@ function Pool:evict(sec)
         local conn = self.queue_idle:shift()
         if not conn:checkalive(self.chkintvl) then
             -- close the connection is not alive
-            conn:close()
+            self:discard(conn, 'dead')
             nconn = nconn + 1
         else
             -- push back to the idle queue
@@ -263,6 +643,100 @@ function Pool:evict(sec)
     return nconn
 end
 
+--- maintain health-checks the idle connections and opens new connections
+--- ahead of demand up to minidle.
+--- the idle connections that exceed the max lifetime are closed, and the
+--- pings for the idle connections are sent at once before receiving the
+--- responses.
+--- @param sec? number seconds to wait for the pings and opening connections
+--- @param conninfo? string connection info to open new connections
+--- @return integer nevict number of closed connections
+--- @return integer nopen number of opened connections
+--- @return any err
+--- @return boolean? timeout
+function Pool:maintain(sec, conninfo)
+    assert(sec == nil or (type(sec) == 'number' and sec >= 0),
+           'sec must be unsigned number or nil')
+    assert(conninfo == nil or type(conninfo) == 'string',
+           'conninfo must be string or nil')
+
+    local queue_idle = self.queue_idle
+    if not queue_idle then
+        return 0, 0, errorf('closed or shutdown pool cannot be maintained')
+    end
+
+    if not conninfo then
+        conninfo = select(3, parse_conninfo(''))
+    end
+
+    local deadline = sec and new_deadline(sec)
+    local nevict = 0
+    local nopen = 0
+
+    -- close expired connections and send pings to the idle connections
+    local pinged = {}
+    local is_timeout
+    for _ = 1, queue_idle:size() do
+        --- @type postgres.pool.connection
+        local conn = queue_idle:shift()
+        if conn:is_expired(self.maxlife) then
+            self:discard(conn, 'lifetime')
+            nevict = nevict + 1
+        elseif deadline and deadline:remain() <= 0 then
+            -- no time to wait for the response
+            is_timeout = true
+            queue_idle:push(conn)
+        else
+            local sent = conn:send_checkalive(self.chkintvl)
+            if sent then
+                pinged[#pinged + 1] = conn
+            elseif sent == false then
+                -- push back to the idle queue
+                queue_idle:push(conn)
+            else
+                -- close the connection is not alive
+                self:discard(conn, 'dead')
+                nevict = nevict + 1
+            end
+        end
+    end
+
+    -- receive the responses of the pings by the deadline, and close the
+    -- connections that did not respond in time
+    for _, conn in ipairs(pinged) do
+        local remain = deadline and deadline:remain()
+        local ok, err, timeout = false, nil, true
+        if not remain or remain > 0 then
+            ok, err, timeout = conn:recv_ping(remain)
+        end
+
+        if ok then
+            queue_idle:push(conn)
+        else
+            is_timeout = is_timeout or (err == nil and timeout)
+            self:discard(conn, 'dead')
+            nevict = nevict + 1
+        end
+    end
+
+    -- open new connections up to minidle
+    while queue_idle:count(conninfo) < self.minidle and
+        (self.maxconn <= 0 or self:size() < self.maxconn) do
+        if deadline and deadline:remain() <= 0 then
+            return nevict, nopen, nil, true
+        end
+
+        local conn, err, timeout = self:connect(conninfo)
+        if not conn then
+            return nevict, nopen, err, timeout
+        end
+        queue_idle:push(conn)
+        nopen = nopen + 1
+    end
+
+    return nevict, nopen, nil, is_timeout
+end
+
 return {
     new = require('metamodule').new(Pool),
 }
@@ -25,6 +25,7 @@ local gettime = require('time.clock').gettime
 --- @class postgres.pool.connection : postgres.connection
 --- @field private pool_id integer
 --- @field private checkalive_at number
+--- @field private created_at number
 local Connection = {}
 
 --- init
@@ -34,6 +35,7 @@ local Connection = {}
 --- @return boolean? timeout
 function Connection:init(conninfo)
     self.checkalive_at = gettime()
+    self.created_at = self.checkalive_at
     return self['postgres.connection'].init(self, conninfo)
 end
 
@@ -66,6 +68,33 @@ function Connection:checkalive(chkintvl)
     return true
 end
 
+--- is_expired
+--- @param maxlife number max lifetime in seconds (0 means unlimited)
+--- @return boolean expired
+function Connection:is_expired(maxlife)
+    return maxlife > 0 and gettime() - self.created_at >= maxlife
+end
+
+--- send_checkalive sends a ping message if the check interval has elapsed.
+--- the response must be received by the recv_ping method.
+--- @param chkintvl number
+--- @return boolean? sent true if sent, false if not needed, or nil on failure
+--- @return any err
+--- @return boolean? timeout
+function Connection:send_checkalive(chkintvl)
+    local now = gettime()
+    if now - self.checkalive_at < chkintvl then
+        return false
+    end
+    self.checkalive_at = now
+
+    local ok, err, timeout = self:send_ping()
+    if not ok then
+        return nil, err, timeout
+    end
+    return true
+end
+
 return {
     new = require('metamodule').new(Connection, 'postgres.connection'),
 }
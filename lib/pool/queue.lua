@@ -21,6 +21,7 @@
 --
 --- assign to local
 local next = next
+local pairs = pairs
 
 --- @class denque
 --- @field __len fun(self):integer
@@ -58,6 +59,17 @@ function Queue:size()
     return #self.queue
 end
 
+--- count
+--- @param addr string
+--- @return integer n number of connections for the conninfo
+function Queue:count(addr)
+    local n = 0
+    for _ in pairs(self.addr2elms[addr] or {}) do
+        n = n + 1
+    end
+    return n
+end
+
 --- push
 --- @param conn postgres.pool.connection
 function Queue:push(conn)
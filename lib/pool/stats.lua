@@ -0,0 +1,215 @@
+--
+-- Copyright (C) 2023 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local pairs = pairs
+local type = type
+
+--- upper bounds of the histogram buckets in seconds
+local BOUNDS = {
+    0.0005,
+    0.001,
+    0.005,
+    0.01,
+    0.05,
+    0.1,
+    0.5,
+    1,
+    5,
+    math.huge,
+}
+local NBOUND = #BOUNDS
+
+--- eviction reasons
+local REASONS = {
+    dead = true, -- failed to health-check
+    lifetime = true, -- exceeded the max lifetime
+    maxidle = true, -- overflowed the max number of idle connections
+    maxconn = true, -- closed to make room for another conninfo
+}
+
+--- @class postgres.pool.stats.histogram
+--- @field count integer number of observations
+--- @field sum number sum of the observed seconds
+--- @field max number max observed seconds
+--- @field counts integer[] number of observations per bucket
+
+--- new_histogram
+--- @return postgres.pool.stats.histogram
+local function new_histogram()
+    local counts = {}
+    for i = 1, NBOUND do
+        counts[i] = 0
+    end
+    return {
+        count = 0,
+        sum = 0,
+        max = 0,
+        counts = counts,
+    }
+end
+
+--- observe
+--- @param h postgres.pool.stats.histogram
+--- @param sec number
+local function observe(h, sec)
+    local i = 1
+    while sec > BOUNDS[i] do
+        i = i + 1
+    end
+    h.counts[i] = h.counts[i] + 1
+    h.count = h.count + 1
+    h.sum = h.sum + sec
+    if sec > h.max then
+        h.max = sec
+    end
+end
+
+--- copy
+--- @param src table
+--- @return table dst
+local function copy(src)
+    local dst = {}
+    for k, v in pairs(src) do
+        dst[k] = type(v) == 'table' and copy(v) or v
+    end
+    return dst
+end
+
+--- @class postgres.pool.stats.counters
+--- @field hits integer number of idle connections reused
+--- @field misses integer number of new connections
+--- @field connect_errors integer number of failed connection attempts
+--- @field connect postgres.pool.stats.histogram connect and authentication duration
+--- @field wait postgres.pool.stats.histogram wait duration in the waiter queue
+--- @field evictions table<string, integer> number of evictions by reason
+
+--- new_counters
+--- @return postgres.pool.stats.counters
+local function new_counters()
+    local evictions = {}
+    for reason in pairs(REASONS) do
+        evictions[reason] = 0
+    end
+    return {
+        hits = 0,
+        misses = 0,
+        connect_errors = 0,
+        connect = new_histogram(),
+        wait = new_histogram(),
+        evictions = evictions,
+    }
+end
+
+--- @class postgres.pool.stats
+--- @field private total postgres.pool.stats.counters
+--- @field private addr2counters table<string, postgres.pool.stats.counters>
+local Stats = {}
+
+--- init
+--- @return postgres.pool.stats
+function Stats:init()
+    self.total = new_counters()
+    self.addr2counters = {}
+    return self
+end
+
+--- counters returns the counters for the conninfo
+--- @private
+--- @param addr string
+--- @return postgres.pool.stats.counters
+function Stats:counters(addr)
+    local counters = self.addr2counters[addr]
+    if not counters then
+        counters = new_counters()
+        self.addr2counters[addr] = counters
+    end
+    return counters
+end
+
+--- hit counts the reuse of an idle connection
+--- @param addr string
+function Stats:hit(addr)
+    local total = self.total
+    local counters = self:counters(addr)
+    total.hits = total.hits + 1
+    counters.hits = counters.hits + 1
+end
+
+--- connect records the duration of a connection attempt
+--- @param addr string
+--- @param sec number
+--- @param ok boolean
+function Stats:connect(addr, sec, ok)
+    local total = self.total
+    local counters = self:counters(addr)
+    if ok then
+        total.misses = total.misses + 1
+        counters.misses = counters.misses + 1
+        observe(total.connect, sec)
+        observe(counters.connect, sec)
+    else
+        total.connect_errors = total.connect_errors + 1
+        counters.connect_errors = counters.connect_errors + 1
+    end
+end
+
+--- wait records the wait duration in the waiter queue
+--- @param addr string
+--- @param sec number
+function Stats:wait(addr, sec)
+    observe(self.total.wait, sec)
+    observe(self:counters(addr).wait, sec)
+end
+
+--- evict counts the eviction of a connection
+--- @param addr string
+--- @param reason string
+---| 'dead'
+---| 'lifetime'
+---| 'maxidle'
+---| 'maxconn'
+function Stats:evict(addr, reason)
+    assert(REASONS[reason], 'unknown eviction reason')
+    local total = self.total.evictions
+    local counters = self:counters(addr).evictions
+    total[reason] = total[reason] + 1
+    counters[reason] = counters[reason] + 1
+end
+
+--- snapshot returns a copy of the counters
+--- @return table snapshot
+function Stats:snapshot()
+    local snapshot = copy(self.total)
+    snapshot.bounds = copy(BOUNDS)
+    snapshot.conninfo = copy(self.addr2counters)
+    return snapshot
+end
+
+--- reset clears all counters
+function Stats:reset()
+    self.total = new_counters()
+    self.addr2counters = {}
+end
+
+return {
+    new = require('metamodule').new(Stats),
+}
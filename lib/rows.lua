@@ -22,6 +22,7 @@
 --- assign to local
 local type = type
 local errorf = require('error').format
+local gettime = require('time.clock').gettime
 local instanceof = require('metamodule').instanceof
 local DEFAULT_DECODER = require('postgres.decoder').new()
 
@@ -29,12 +30,21 @@ local DEFAULT_DECODER = require('postgres.decoder').new()
 --- @field private conn postgres.connection?
 --- @field private coli integer
 --- @field private row table? DataRow message
+--- @field private scanner postgres.rows.scanner?
+--- @field private qrec postgres.connection.query_record? record to account the decode time
+--- @field private qstats postgres.connection.query_stats?
 --- @field fields table RowDescription.fields
 --- @field error string?
 --- @field is_timeout boolean?
---- @field complete postgres.message.command_complete?
+--- @field complete postgres.message.command_complete|postgres.message.portal_suspended|nil
 local Rows = {}
 
+--- @class postgres.rows.scanner
+--- @field decoder postgres.decoder
+--- @field ncol integer
+--- @field names string[] column names
+--- @field decodefns (function|false)[] decode functions of the columns
+
 --- init
 --- @param conn postgres.connection
 --- @param fields table RowDescription fields
@@ -46,9 +56,22 @@ function Rows:init(conn, fields)
     self.conn = conn
     self.coli = 1
     self.fields = fields
+    self.qrec, self.qstats = conn:get_query_record()
     return self
 end
 
+--- add_decode_time accounts the decode time if the query statistics are
+--- enabled
+--- @param self postgres.rows
+--- @param t number? start time
+local function add_decode_time(self, t)
+    if t then
+        local elapsed = gettime() - t
+        self.qrec.decode_time = self.qrec.decode_time + elapsed
+        self.qstats.decode_time = self.qstats.decode_time + elapsed
+    end
+end
+
 --- close
 --- @return boolean ok
 --- @return any err
@@ -62,13 +85,18 @@ function Rows:close()
     -- remove connection and row
     self.conn = nil
     self.row = nil
+    -- close the portal without fetching the remaining rows if the rows are
+    -- fetched in chunks
+    conn:close_portal()
     -- retrieve CommandComplete message
     while true do
         -- the allowed message types are;
         --  * DataRow
         --  * CommandComplete
+        --  * PortalSuspended
         --  * ErrorResponse
-        local res, err, timeout = conn:recv()
+        -- the DataRow messages are skipped without decoding
+        local res, err, timeout = conn:recv(true)
         if not res then
             if err then
                 self.error = errorf('failed to retrieve message: %s', err)
@@ -77,7 +105,7 @@ function Rows:close()
             return false, self.error, timeout
         end
 
-        if res.type == 'CommandComplete' then
+        if res.type == 'CommandComplete' or res.type == 'PortalSuspended' then
             self.complete = res
             return true
         elseif res.type == 'ErrorResponse' then
@@ -85,7 +113,7 @@ function Rows:close()
             return false, self.error
         elseif res.type ~= 'DataRow' then
             self.error = errorf(
-                             'DataRow|CommandComplete|ErrorResponse expected, got %q',
+                             'DataRow|CommandComplete|PortalSuspended|ErrorResponse expected, got %q',
                              res.type)
             -- close connection on unexpected message type
             conn:close()
@@ -168,6 +196,24 @@ function Rows:read()
     end
 end
 
+--- decode_value decodes the column value by the decoder.
+--- the decoder that does not implement decode_by_field is called with the
+--- type oid of the field by decode_by_oid, but the binary format values are
+--- decoded by the native binary decoders because it cannot decode them.
+--- @param decoder postgres.decoder
+--- @param field table
+--- @param val string
+--- @return any val
+--- @return any err
+local function decode_value(decoder, field, val)
+    if decoder.decode_by_field then
+        return decoder:decode_by_field(field, val)
+    elseif field.format == 'binary' then
+        return DEFAULT_DECODER:decode_by_field(field, val)
+    end
+    return decoder:decode_by_oid(field.type_oid, val)
+end
+
 --- scanat scan specified column value
 --- @param col integer|string column name, or column number started with 1
 --- @param decoder? postgres.decoder
@@ -181,7 +227,10 @@ function Rows:scanat(col, decoder)
 
     local field, val = self:readat(col)
     if field and val then
-        return field, decoder:decode_by_oid(field.type_oid, val)
+        local t = self.qrec and gettime()
+        local v, err = decode_value(decoder, field, val)
+        add_decode_time(self, t)
+        return field, v, err
     end
     return field
 end
@@ -198,11 +247,105 @@ function Rows:scan(decoder)
 
     local field, val = self:read()
     if field and val then
-        return field, decoder:decode_by_oid(field.type_oid, val)
+        local t = self.qrec and gettime()
+        local v, err = decode_value(decoder, field, val)
+        add_decode_time(self, t)
+        return field, v, err
     end
     return field
 end
 
+--- get_scanner returns the scanner that holds the decode functions of the
+--- columns resolved by the decoder
+--- @private
+--- @param decoder postgres.decoder
+--- @return postgres.rows.scanner scanner
+function Rows:get_scanner(decoder)
+    local scanner = self.scanner
+    if not scanner or scanner.decoder ~= decoder then
+        local fields = self.fields
+        local names = {}
+        local decodefns = {}
+        for i = 1, #fields do
+            local field = fields[i]
+            names[i] = field.name
+            if decoder.get_decodefn then
+                decodefns[i] = decoder:get_decodefn(field) or false
+            elseif field.format == 'binary' then
+                -- decode_by_oid cannot decode the binary format
+                decodefns[i] = DEFAULT_DECODER:get_decodefn(field) or false
+            else
+                local oid = field.type_oid
+                decodefns[i] = function(v)
+                    return decoder:decode_by_oid(oid, v)
+                end
+            end
+        end
+        scanner = {
+            decoder = decoder,
+            ncol = #fields,
+            names = names,
+            decodefns = decodefns,
+        }
+        self.scanner = scanner
+    end
+    return scanner
+end
+
+--- scan_into scans all column values of the current row into the table.
+--- the decode functions of the columns are resolved once per rows object.
+--- @param tbl table
+--- @param byname? boolean use the column names as keys instead of the column numbers
+--- @param decoder? postgres.decoder
+--- @return table? tbl
+--- @return any err
+function Rows:scan_into(tbl, byname, decoder)
+    assert(type(tbl) == 'table', 'tbl must be table')
+    local row = self.row
+    if not row then
+        return nil
+    elseif decoder == nil then
+        decoder = DEFAULT_DECODER
+    end
+
+    local t = self.qrec and gettime()
+    local scanner = self:get_scanner(decoder)
+    local names = scanner.names
+    local decodefns = scanner.decodefns
+    local values = row.values
+    for i = 1, scanner.ncol do
+        local v = values[i]
+        if v ~= nil then
+            local decodefn = decodefns[i]
+            if decodefn then
+                local err
+                v, err = decodefn(v)
+                if err then
+                    add_decode_time(self, t)
+                    return nil, errorf('failed to decode column %q: %s',
+                                       names[i], err)
+                end
+            end
+        end
+        if byname then
+            tbl[names[i]] = v
+        else
+            tbl[i] = v
+        end
+    end
+    add_decode_time(self, t)
+    return tbl
+end
+
+--- scan_row scans all column values of the current row into a new table
+--- @param byname? boolean use the column names as keys instead of the column numbers
+--- @param decoder? postgres.decoder
+--- @return table? row
+--- @return any err
+function Rows:scan_row(byname, decoder)
+    return self:scan_into({}, byname, decoder)
+end
+
 return {
     new = require('metamodule').new(Rows),
 }
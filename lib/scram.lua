@@ -30,6 +30,7 @@ local hmac_sha256 = require('hmac').sha256
 local encode_base64 = require('base64mix').encode
 local decode_base64 = require('base64mix').decode
 local strxor = require('postgres.strxor')
+local pbkdf2 = require('postgres.pbkdf2')
 
 --- do_hmac_sha256 - calculate HMAC-SHA256
 --- @param key string?
@@ -48,21 +49,64 @@ local function do_sha256(data)
     return do_hmac_sha256(nil, data)
 end
 
---- pbkdf2 - Password-Based Key Derivation Function 2
+--- maximum number of the cached keys
+local KEY_CACHE_SIZE = 256
+
+--- cache of the keys derived from the password.
+--- the salt and the iteration count are stored per role in the server, so the
+--- same keys are derived on every connection of the same user.
+--- @type table<string, postgres.scram.keys>
+local KEY_CACHE = {}
+local KEY_CACHE_LEN = 0
+
+--- @class postgres.scram.keys
+--- @field salted_password string
+--- @field client_key string
+--- @field stored_key string
+--- @field server_key string
+
+--- derive_keys derives the keys from the password, or returns the cached keys.
+--- the password is hashed in the cache key so that the cache never holds the
+--- plain password.
+--- @param username string
 --- @param password string
 --- @param salt string
---- @param niter number
---- @return string
-local function pbkdf2(password, salt, niter)
-    -- calculate first block
-    local block = do_hmac_sha256(password, salt .. '\0\0\0\1')
-    local res = block
-    -- iterate remaining times
-    for _ = 2, niter do
-        block = do_hmac_sha256(password, block)
-        res = strxor(res, block)
+--- @param niter integer
+--- @return postgres.scram.keys keys
+local function derive_keys(username, password, salt, niter)
+    local key = concat({
+        username,
+        do_sha256(password),
+        salt,
+        niter,
+    }, '\0')
+    local keys = KEY_CACHE[key]
+    if keys then
+        return keys
     end
-    return res
+
+    local salted_password = pbkdf2(password, decode_base64(salt), niter)
+    local client_key = do_hmac_sha256(salted_password, 'Client Key')
+    keys = {
+        salted_password = salted_password,
+        client_key = client_key,
+        stored_key = do_sha256(client_key),
+        server_key = do_hmac_sha256(salted_password, 'Server Key'),
+    }
+    if KEY_CACHE_LEN >= KEY_CACHE_SIZE then
+        -- drop all keys instead of tracking the usage of each key
+        KEY_CACHE = {}
+        KEY_CACHE_LEN = 0
+    end
+    KEY_CACHE[key] = keys
+    KEY_CACHE_LEN = KEY_CACHE_LEN + 1
+    return keys
+end
+
+--- clear_cache removes all cached keys
+local function clear_cache()
+    KEY_CACHE = {}
+    KEY_CACHE_LEN = 0
 end
 
 --- decode_kvpair
@@ -95,7 +139,7 @@ end
 --- @field private username string
 --- @field private password string
 --- @field private nonce string
---- @field private salted_password? string
+--- @field private keys? postgres.scram.keys
 --- @field private auth_message? string
 local SCRAM = {}
 
@@ -157,7 +201,8 @@ function SCRAM:client_final_message(server_first_message)
                    server_first_message)
     end
 
-    self.salted_password = pbkdf2(self.password, decode_base64(salt), niter)
+    local keys = derive_keys(self.username, self.password, salt, niter)
+    self.keys = keys
     self.auth_message = concat({
         'n=',
         self.username,
@@ -168,10 +213,8 @@ function SCRAM:client_final_message(server_first_message)
         ',c=biws,r=',
         nonce,
     })
-    local client_key = do_hmac_sha256(self.salted_password, 'Client Key')
-    local stored_key = do_sha256(client_key)
-    local client_signature = do_hmac_sha256(stored_key, self.auth_message)
-    local client_proof = encode_base64(strxor(client_key, client_signature))
+    local client_signature = do_hmac_sha256(keys.stored_key, self.auth_message)
+    local client_proof = encode_base64(strxor(keys.client_key, client_signature))
 
     -- client_final_message without channel binding
     return 'c=biws,r=' .. nonce .. ',p=' .. client_proof
@@ -199,9 +242,8 @@ function SCRAM:verify_server_signature(server_final_message)
                    server_final_message)
     end
 
-    local server_key = do_hmac_sha256(self.salted_password, 'Server Key')
-    local exptected = encode_base64(
-                          do_hmac_sha256(server_key, self.auth_message))
+    local exptected = encode_base64(do_hmac_sha256(self.keys.server_key,
+                                                   self.auth_message))
     if server_signature == exptected then
         return true
     end
@@ -213,4 +255,5 @@ end
 
 return {
     new = require('metamodule').new(SCRAM),
+    clear_cache = clear_cache,
 }
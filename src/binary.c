@@ -0,0 +1,899 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// lua
+#include <lauxlib.h>
+// system
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * decoders of the binary format of the data types.
+ * each decoder pushes the decoded value onto the stack and returns 0, or
+ * pushes the error message onto the stack and returns -1.
+ */
+typedef int (*decodefn_t)(lua_State *L, const char *data, size_t len);
+
+// maximum number of array dimensions (see MAXDIM in src/include/c.h)
+#define ARRAY_MAXDIM 6
+
+#if LUA_VERSION_NUM >= 502
+# define binary_rawlen(L, idx) lua_rawlen((L), (idx))
+#else
+# define binary_rawlen(L, idx) lua_objlen((L), (idx))
+#endif
+
+// number of days from 1970-01-01 to 2000-01-01 (postgres epoch)
+#define POSTGRES_EPOCH_JDATE 10957
+#define USECS_PER_DAY        INT64_C(86400000000)
+#define USECS_PER_HOUR       INT64_C(3600000000)
+#define USECS_PER_MINUTE     INT64_C(60000000)
+#define USECS_PER_SEC        INT64_C(1000000)
+
+static inline int16_t get_int16(const char *p)
+{
+    uint16_t v = 0;
+    memcpy(&v, p, sizeof(uint16_t));
+    return (int16_t)ntohs(v);
+}
+
+static inline int32_t get_int32(const char *p)
+{
+    uint32_t v = 0;
+    memcpy(&v, p, sizeof(uint32_t));
+    return (int32_t)ntohl(v);
+}
+
+static inline uint32_t get_uint32(const char *p)
+{
+    uint32_t v = 0;
+    memcpy(&v, p, sizeof(uint32_t));
+    return ntohl(v);
+}
+
+static inline int64_t get_int64(const char *p)
+{
+    uint64_t hi = get_uint32(p);
+    uint64_t lo = get_uint32(p + sizeof(uint32_t));
+    return (int64_t)((hi << 32) | lo);
+}
+
+static inline int invalid_length(lua_State *L, const char *name, size_t len)
+{
+    lua_pushfstring(L, "invalid %s data length %d", name, (int)len);
+    return -1;
+}
+
+static int decode_int2(lua_State *L, const char *data, size_t len)
+{
+    if (len != sizeof(int16_t)) {
+        return invalid_length(L, "int2", len);
+    }
+    lua_pushinteger(L, get_int16(data));
+    return 0;
+}
+
+static int decode_int4(lua_State *L, const char *data, size_t len)
+{
+    if (len != sizeof(int32_t)) {
+        return invalid_length(L, "int4", len);
+    }
+    lua_pushinteger(L, get_int32(data));
+    return 0;
+}
+
+static int decode_int8(lua_State *L, const char *data, size_t len)
+{
+    if (len != sizeof(int64_t)) {
+        return invalid_length(L, "int8", len);
+    }
+    lua_pushinteger(L, (lua_Integer)get_int64(data));
+    return 0;
+}
+
+static int decode_float4(lua_State *L, const char *data, size_t len)
+{
+    union {
+        uint32_t i;
+        float f;
+    } v;
+
+    if (len != sizeof(float)) {
+        return invalid_length(L, "float4", len);
+    }
+    v.i = get_uint32(data);
+    lua_pushnumber(L, v.f);
+    return 0;
+}
+
+static int decode_float8(lua_State *L, const char *data, size_t len)
+{
+    union {
+        uint64_t i;
+        double f;
+    } v;
+
+    if (len != sizeof(double)) {
+        return invalid_length(L, "float8", len);
+    }
+    v.i = (uint64_t)get_int64(data);
+    lua_pushnumber(L, v.f);
+    return 0;
+}
+
+static int decode_bool(lua_State *L, const char *data, size_t len)
+{
+    if (len != 1) {
+        return invalid_length(L, "bool", len);
+    }
+    lua_pushboolean(L, *data != 0);
+    return 0;
+}
+
+static int decode_bytea(lua_State *L, const char *data, size_t len)
+{
+    lua_pushlstring(L, data, len);
+    return 0;
+}
+
+static int decode_uuid(lua_State *L, const char *data, size_t len)
+{
+    static const char HEX[] = "0123456789abcdef";
+    char buf[36];
+    char *p = buf;
+
+    if (len != 16) {
+        return invalid_length(L, "uuid", len);
+    }
+    // format as xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
+    for (size_t i = 0; i < 16; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            *p++ = '-';
+        }
+        *p++ = HEX[c >> 4];
+        *p++ = HEX[c & 0xf];
+    }
+    lua_pushlstring(L, buf, sizeof(buf));
+    return 0;
+}
+
+/**
+ * set the year, month and day fields of the number of days since 2000-01-01
+ * to the table on the top of the stack.
+ */
+static void set_date_fields(lua_State *L, int64_t days)
+{
+    // convert to the civil date (proleptic Gregorian calendar)
+    int64_t z   = days + POSTGRES_EPOCH_JDATE + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp  = (5 * doy + 2) / 153;
+    int64_t d   = doy - (153 * mp + 2) / 5 + 1;
+    int64_t m   = mp < 10 ? mp + 3 : mp - 9;
+    int64_t y   = yoe + era * 400 + (m <= 2);
+
+    lua_pushinteger(L, (lua_Integer)y);
+    lua_setfield(L, -2, "year");
+    lua_pushinteger(L, (lua_Integer)m);
+    lua_setfield(L, -2, "month");
+    lua_pushinteger(L, (lua_Integer)d);
+    lua_setfield(L, -2, "day");
+}
+
+static int decode_date(lua_State *L, const char *data, size_t len)
+{
+    int32_t days = 0;
+
+    if (len != sizeof(int32_t)) {
+        return invalid_length(L, "date", len);
+    }
+
+    days = get_int32(data);
+    if (days == INT32_MAX) {
+        lua_pushliteral(L, "infinity");
+    } else if (days == INT32_MIN) {
+        lua_pushliteral(L, "-infinity");
+    } else {
+        lua_createtable(L, 0, 3);
+        set_date_fields(L, days);
+    }
+    return 0;
+}
+
+static int push_timestamp(lua_State *L, const char *name, const char *data,
+                          size_t len, int with_tz)
+{
+    int64_t usec = 0;
+    int64_t days = 0;
+
+    if (len != sizeof(int64_t)) {
+        return invalid_length(L, name, len);
+    }
+
+    usec = get_int64(data);
+    if (usec == INT64_MAX) {
+        lua_pushliteral(L, "infinity");
+        return 0;
+    } else if (usec == INT64_MIN) {
+        lua_pushliteral(L, "-infinity");
+        return 0;
+    }
+
+    // split into days and microseconds of the day
+    days = usec / USECS_PER_DAY;
+    usec -= days * USECS_PER_DAY;
+    if (usec < 0) {
+        days--;
+        usec += USECS_PER_DAY;
+    }
+
+    lua_createtable(L, 0, with_tz ? 11 : 7);
+    set_date_fields(L, days);
+    lua_pushinteger(L, (lua_Integer)(usec / USECS_PER_HOUR));
+    lua_setfield(L, -2, "hour");
+    usec %= USECS_PER_HOUR;
+    lua_pushinteger(L, (lua_Integer)(usec / USECS_PER_MINUTE));
+    lua_setfield(L, -2, "min");
+    usec %= USECS_PER_MINUTE;
+    lua_pushinteger(L, (lua_Integer)(usec / USECS_PER_SEC));
+    lua_setfield(L, -2, "sec");
+    lua_pushinteger(L, (lua_Integer)(usec % USECS_PER_SEC));
+    lua_setfield(L, -2, "usec");
+    if (with_tz) {
+        // timestamptz is always sent in UTC
+        lua_pushliteral(L, "+");
+        lua_setfield(L, -2, "tz");
+        lua_pushinteger(L, 0);
+        lua_setfield(L, -2, "tzhour");
+        lua_pushinteger(L, 0);
+        lua_setfield(L, -2, "tzmin");
+        lua_pushinteger(L, 0);
+        lua_setfield(L, -2, "tzsec");
+    }
+    return 0;
+}
+
+static int decode_timestamp(lua_State *L, const char *data, size_t len)
+{
+    return push_timestamp(L, "timestamp", data, len, 0);
+}
+
+static int decode_timestamptz(lua_State *L, const char *data, size_t len)
+{
+    return push_timestamp(L, "timestamptz", data, len, 1);
+}
+
+static decodefn_t get_element_decoder(uint32_t oid)
+{
+    switch (oid) {
+    case 20:
+        return decode_int8;
+    case 21:
+        return decode_int2;
+    case 23:
+        return decode_int4;
+    case 700:
+        return decode_float4;
+    case 701:
+        return decode_float8;
+    default:
+        return NULL;
+    }
+}
+
+static int decode_array_dim(lua_State *L, int32_t *dims, int ndim,
+                            const char **head, const char *tail,
+                            decodefn_t decodefn)
+{
+    lua_createtable(L, dims[0], 0);
+    for (int32_t i = 1; i <= dims[0]; i++) {
+        if (ndim > 1) {
+            if (decode_array_dim(L, dims + 1, ndim - 1, head, tail,
+                                 decodefn) != 0) {
+                return -1;
+            }
+        } else {
+            int32_t len = 0;
+
+            if (tail - *head < (ptrdiff_t)sizeof(int32_t)) {
+                lua_pushliteral(L, "invalid array data: not enough data");
+                return -1;
+            }
+            len = get_int32(*head);
+            *head += sizeof(int32_t);
+            if (len == -1) {
+                // NULL element
+                continue;
+            } else if (len < 0 || tail - *head < (ptrdiff_t)len) {
+                lua_pushliteral(L, "invalid array data: not enough data");
+                return -1;
+            } else if (decodefn(L, *head, len) != 0) {
+                return -1;
+            }
+            *head += len;
+        }
+        lua_rawseti(L, -2, i);
+    }
+    return 0;
+}
+
+/**
+ * decode the binary format of array.
+ *
+ *  Int32       - number of dimensions
+ *  Int32       - flags (has null elements)
+ *  Int32       - element type oid
+ *  Then, for each dimension, there is the following:
+ *  Int32       - number of elements
+ *  Int32       - lower bound
+ *  Then, for each element, there is the following:
+ *  Int32       - length of the element, -1 indicates a NULL element
+ *  Byten       - element data
+ */
+static int decode_array(lua_State *L, const char *data, size_t len)
+{
+    const char *head = data;
+    const char *tail = data + len;
+    int32_t dims[ARRAY_MAXDIM];
+    int32_t ndim        = 0;
+    size_t nelem        = 1;
+    size_t maxelem      = 0;
+    decodefn_t decodefn = NULL;
+
+    if (len < sizeof(int32_t) * 3) {
+        return invalid_length(L, "array", len);
+    }
+    ndim     = get_int32(head);
+    decodefn = get_element_decoder(get_uint32(head + sizeof(int32_t) * 2));
+    head += sizeof(int32_t) * 3;
+    if (ndim < 0 || ndim > ARRAY_MAXDIM) {
+        lua_pushfstring(L, "invalid array data: number of dimensions %d is "
+                           "not supported",
+                        (int)ndim);
+        return -1;
+    } else if (!decodefn) {
+        lua_pushfstring(L, "invalid array data: element type %d is not "
+                           "supported",
+                        (int)get_uint32(data + sizeof(int32_t) * 2));
+        return -1;
+    } else if (ndim == 0) {
+        // empty array
+        lua_newtable(L);
+        return 0;
+    } else if (tail - head < (ptrdiff_t)(sizeof(int32_t) * 2 * ndim)) {
+        return invalid_length(L, "array", len);
+    }
+
+    // each element has at least its length field, so the number of elements
+    // must not exceed the number of the remaining int32 values
+    maxelem = (size_t)(tail - head) / sizeof(int32_t) - (size_t)ndim * 2;
+    for (int i = 0; i < ndim; i++) {
+        dims[i] = get_int32(head);
+        if (dims[i] < 0) {
+            lua_pushfstring(L, "invalid array data: dimension#%d size %d",
+                            i + 1, (int)dims[i]);
+            return -1;
+        }
+        nelem *= (size_t)dims[i];
+        if (nelem > maxelem) {
+            lua_pushliteral(L, "invalid array data: number of elements "
+                               "exceeds the data length");
+            return -1;
+        }
+        // lower bound is ignored
+        head += sizeof(int32_t) * 2;
+    }
+
+    if (nelem == 0) {
+        // no elements
+        lua_newtable(L);
+    } else if (decode_array_dim(L, dims, ndim, &head, tail, decodefn) != 0) {
+        return -1;
+    } else if (head != tail) {
+        lua_pop(L, 1);
+        lua_pushfstring(L, "invalid array data: unknown %d bytes of data "
+                           "remains",
+                        (int)(tail - head));
+        return -1;
+    }
+    return 0;
+}
+
+static inline int decode_lua(lua_State *L, decodefn_t decodefn)
+{
+    size_t len       = 0;
+    const char *data = luaL_checklstring(L, 1, &len);
+    int top          = lua_gettop(L);
+
+    if (decodefn(L, data, len) != 0) {
+        // remove the partially decoded values
+        if (lua_gettop(L) > top + 1) {
+            lua_replace(L, top + 1);
+            lua_settop(L, top + 1);
+        }
+        lua_pushnil(L);
+        lua_insert(L, -2);
+        return 2;
+    }
+    return 1;
+}
+
+#define decode_binary_lua(name)                                                \
+    static int name##_lua(lua_State *L)                                        \
+    {                                                                          \
+        return decode_lua(L, decode_##name);                                   \
+    }
+
+decode_binary_lua(int2)
+decode_binary_lua(int4)
+decode_binary_lua(int8)
+decode_binary_lua(float4)
+decode_binary_lua(float8)
+decode_binary_lua(bool)
+decode_binary_lua(bytea)
+decode_binary_lua(uuid)
+decode_binary_lua(date)
+decode_binary_lua(timestamp)
+decode_binary_lua(timestamptz)
+decode_binary_lua(array)
+
+#undef decode_binary_lua
+
+/**
+ * encoders of the binary format of the parameter values.
+ */
+typedef enum {
+    PARAM_NONE = 0,
+    PARAM_BOOL,
+    PARAM_INT,
+    PARAM_FLOAT,
+    PARAM_TEXT,
+} param_type_t;
+
+// type oids of the parameter values and the arrays of them
+static const uint32_t PARAM_OIDS[][2] = {
+    [PARAM_NONE]  = {0,   0   },
+    [PARAM_BOOL]  = {16,  1000},
+    [PARAM_INT]   = {20,  1016},
+    [PARAM_FLOAT] = {701, 1022},
+    [PARAM_TEXT]  = {25,  1009},
+};
+
+static inline char *put_int32(char *p, int32_t v)
+{
+    uint32_t n = htonl((uint32_t)v);
+    memcpy(p, &n, sizeof(uint32_t));
+    return p + sizeof(uint32_t);
+}
+
+static inline char *put_int64(char *p, int64_t v)
+{
+    p = put_int32(p, (int32_t)((uint64_t)v >> 32));
+    return put_int32(p, (int32_t)((uint64_t)v & 0xffffffff));
+}
+
+/**
+ * get the parameter type of the scalar value at idx.
+ */
+static param_type_t get_param_type(lua_State *L, int idx)
+{
+    switch (lua_type(L, idx)) {
+    case LUA_TBOOLEAN:
+        return PARAM_BOOL;
+    case LUA_TSTRING:
+        return PARAM_TEXT;
+    case LUA_TNUMBER: {
+#if LUA_VERSION_NUM >= 503
+        if (lua_isinteger(L, idx)) {
+            return PARAM_INT;
+        }
+        return PARAM_FLOAT;
+#else
+        // integral value that can be represented as int8
+        lua_Number v = lua_tonumber(L, idx);
+        if (v >= -9223372036854775808.0 && v < 9223372036854775808.0 &&
+            v == (lua_Number)(int64_t)v) {
+            return PARAM_INT;
+        }
+        return PARAM_FLOAT;
+#endif
+    }
+    default:
+        return PARAM_NONE;
+    }
+}
+
+static inline int64_t get_param_int(lua_State *L, int idx)
+{
+#if LUA_VERSION_NUM >= 503
+    return (int64_t)lua_tointeger(L, idx);
+#else
+    return (int64_t)lua_tonumber(L, idx);
+#endif
+}
+
+/**
+ * get the size of the binary format of the scalar value at idx.
+ */
+static size_t get_param_size(lua_State *L, int idx, param_type_t type)
+{
+    switch (type) {
+    case PARAM_BOOL:
+        return 1;
+    case PARAM_INT:
+    case PARAM_FLOAT:
+        return sizeof(int64_t);
+    default: {
+        size_t len = 0;
+        lua_tolstring(L, idx, &len);
+        return len;
+    }
+    }
+}
+
+/**
+ * write the binary format of the scalar value at idx as the specified type.
+ */
+static char *put_param(lua_State *L, int idx, param_type_t type, char *p)
+{
+    switch (type) {
+    case PARAM_BOOL:
+        *p = lua_toboolean(L, idx) ? 1 : 0;
+        return p + 1;
+
+    case PARAM_INT:
+        return put_int64(p, get_param_int(L, idx));
+
+    case PARAM_FLOAT: {
+        union {
+            int64_t i;
+            double f;
+        } v;
+        v.f = (double)lua_tonumber(L, idx);
+        return put_int64(p, v.i);
+    }
+
+    default: {
+        size_t len      = 0;
+        const char *str = lua_tolstring(L, idx, &len);
+        memcpy(p, str, len);
+        return p + len;
+    }
+    }
+}
+
+/**
+ * write the text format of the numeric value at idx that can be parsed by
+ * the server as any numeric type. the float value is written with the
+ * shortest precision that round-trips.
+ *
+ * @return length of the text
+ */
+static size_t put_param_text(lua_State *L, int idx, param_type_t type,
+                             char *buf, size_t size)
+{
+    int len = 0;
+
+    if (type == PARAM_INT) {
+        len = snprintf(buf, size, "%" PRId64, get_param_int(L, idx));
+    } else {
+        double v = (double)lua_tonumber(L, idx);
+        for (int prec = 15; prec <= 17; prec++) {
+            len = snprintf(buf, size, "%.*g", prec, v);
+            if (strtod(buf, NULL) == v) {
+                break;
+            }
+        }
+    }
+    return (size_t)len;
+}
+
+typedef struct {
+    int ndim;
+    int32_t dims[ARRAY_MAXDIM];
+    param_type_t type;
+    int hasnull;
+    size_t size;
+} array_info_t;
+
+/**
+ * check that the table at the top of the stack has no keys other than the
+ * integers from 1 to len. the NULL elements are the missing keys.
+ */
+static int is_array(lua_State *L, size_t len)
+{
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        lua_Number k = 0;
+
+        lua_pop(L, 1);
+        k = lua_tonumber(L, -1);
+        if (lua_type(L, -1) != LUA_TNUMBER || k < 1 || k > (lua_Number)len ||
+            k != (lua_Number)(size_t)k) {
+            lua_pop(L, 1);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * check that the table at the top of the stack is a rectangular array of the
+ * same type of elements, and accumulate the size of the elements.
+ */
+static int check_array_dim(lua_State *L, array_info_t *info, int dim)
+{
+    if ((size_t)info->dims[dim] != binary_rawlen(L, -1)) {
+        lua_pushliteral(L, "multi-dimensional arrays must have sub-arrays "
+                           "with matching dimensions");
+        return -1;
+    } else if (!is_array(L, (size_t)info->dims[dim])) {
+        lua_pushliteral(L, "unsupported parameter type: non-array table");
+        return -1;
+    }
+
+    for (int32_t i = 1; i <= info->dims[dim]; i++) {
+        lua_rawgeti(L, -1, i);
+        if (dim + 1 < info->ndim) {
+            if (lua_type(L, -1) != LUA_TTABLE) {
+                lua_pushliteral(L, "multi-dimensional arrays must have "
+                                   "sub-arrays with matching dimensions");
+                return -1;
+            } else if (check_array_dim(L, info, dim + 1) != 0) {
+                return -1;
+            }
+        } else if (lua_isnil(L, -1)) {
+            // NULL element
+            info->hasnull = 1;
+            info->size += sizeof(int32_t);
+        } else {
+            param_type_t type = get_param_type(L, -1);
+
+            if (type == PARAM_NONE) {
+                lua_pushfstring(L, "array element of %s type is not supported",
+                                luaL_typename(L, -1));
+                return -1;
+            } else if (info->type == PARAM_NONE) {
+                info->type = type;
+            } else if (info->type != type) {
+                // integers and floats are encoded as float8
+                if ((info->type == PARAM_INT && type == PARAM_FLOAT) ||
+                    (info->type == PARAM_FLOAT && type == PARAM_INT)) {
+                    info->type = PARAM_FLOAT;
+                } else {
+                    lua_pushliteral(L,
+                                    "array elements must be the same type");
+                    return -1;
+                }
+            }
+            // the size of int and float is the same
+            info->size += sizeof(int32_t) + get_param_size(L, -1, type);
+        }
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+static char *put_array_dim(lua_State *L, array_info_t *info, int dim, char *p)
+{
+    for (int32_t i = 1; i <= info->dims[dim]; i++) {
+        lua_rawgeti(L, -1, i);
+        if (dim + 1 < info->ndim) {
+            p = put_array_dim(L, info, dim + 1, p);
+        } else if (lua_isnil(L, -1)) {
+            p = put_int32(p, -1);
+        } else {
+            char *head = p + sizeof(int32_t);
+            char *tail = put_param(L, -1, info->type, head);
+            p          = put_int32(p, (int32_t)(tail - head)) + (tail - head);
+        }
+        lua_pop(L, 1);
+    }
+    return p;
+}
+
+/**
+ * encode the table at idx as the binary format of array.
+ * see decode_array for the format.
+ *
+ * @return 0 on success, 1 if the array is empty, or -1 with the error
+ *         message pushed onto the stack.
+ */
+static int encode_array(lua_State *L, int idx, uint32_t *oid)
+{
+    array_info_t info = {0};
+    char *data        = NULL;
+    char *p           = NULL;
+
+    // get the dimensions from the first elements
+    lua_pushvalue(L, idx);
+    while (lua_type(L, -1) == LUA_TTABLE) {
+        size_t len = binary_rawlen(L, -1);
+
+        if (info.ndim == ARRAY_MAXDIM) {
+            lua_pushfstring(L, "number of array dimensions exceeds the "
+                               "maximum allowed (%d)",
+                            ARRAY_MAXDIM);
+            return -1;
+        } else if (len > INT32_MAX) {
+            lua_pushliteral(L, "array size exceeds the maximum allowed");
+            return -1;
+        } else if (len == 0) {
+            if (info.ndim == 0) {
+                if (!is_array(L, 0)) {
+                    lua_pushliteral(L, "unsupported parameter type: "
+                                       "non-array table");
+                    return -1;
+                }
+                // the element type of empty array cannot be determined
+                return 1;
+            }
+            lua_pushliteral(L, "multi-dimensional arrays must have "
+                               "sub-arrays with matching dimensions");
+            return -1;
+        }
+        info.dims[info.ndim++] = (int32_t)len;
+        lua_rawgeti(L, -1, 1);
+    }
+    lua_settop(L, idx);
+
+    lua_pushvalue(L, idx);
+    if (check_array_dim(L, &info, 0) != 0) {
+        return -1;
+    } else if (info.type == PARAM_NONE) {
+        // all elements are NULL
+        info.type = PARAM_TEXT;
+    }
+
+    info.size += sizeof(int32_t) * (3 + 2 * info.ndim);
+    if (info.size > INT32_MAX) {
+        lua_pushliteral(L, "array size exceeds the maximum allowed");
+        return -1;
+    }
+    data = lua_newuserdata(L, info.size);
+    lua_insert(L, -2);
+
+    // header
+    *oid = PARAM_OIDS[info.type][1];
+    p    = put_int32(data, info.ndim);
+    p    = put_int32(p, info.hasnull);
+    p    = put_int32(p, (int32_t)PARAM_OIDS[info.type][0]);
+    for (int i = 0; i < info.ndim; i++) {
+        p = put_int32(p, info.dims[i]);
+        // lower bound
+        p = put_int32(p, 1);
+    }
+    // elements
+    put_array_dim(L, &info, 0, p);
+
+    lua_pushlstring(L, data, info.size);
+    return 0;
+}
+
+/**
+ * encode the parameter value in the binary format.
+ *
+ *  boolean: bool
+ *  integer: text format with unspecified type
+ *  float: text format with unspecified type
+ *  string: text format with unspecified type
+ *  table: array of bool, int8, float8 or text
+ *
+ * the scalar numbers are sent in text format without the type so that the
+ * server infers the type from the context, e.g. the argument of the function
+ * that takes int4 or the column of numeric type.
+ *
+ * @param L Lua state
+ * @return encoded value, type oid and format code (0:text, 1:binary), or nil
+ *         and error message.
+ */
+static int encode_lua(lua_State *L)
+{
+    param_type_t type = PARAM_NONE;
+    uint32_t oid      = 0;
+    char buf[32];
+
+    luaL_checkany(L, 1);
+    lua_settop(L, 1);
+    if (lua_type(L, 1) == LUA_TTABLE) {
+        switch (encode_array(L, 1, &oid)) {
+        case 0:
+            lua_pushinteger(L, oid);
+            lua_pushinteger(L, 1);
+            return 3;
+        case 1:
+            // empty array in text format
+            lua_pushliteral(L, "{}");
+            lua_pushinteger(L, 0);
+            lua_pushinteger(L, 0);
+            return 3;
+        default:
+            lua_pushnil(L);
+            lua_insert(L, -2);
+            return 2;
+        }
+    }
+
+    type = get_param_type(L, 1);
+    switch (type) {
+    case PARAM_NONE:
+        lua_pushnil(L);
+        lua_pushfstring(L, "%s type is not supported", luaL_typename(L, 1));
+        return 2;
+
+    case PARAM_TEXT:
+        // text is sent as is in text format and its type is inferred by
+        // the server
+        lua_pushvalue(L, 1);
+        lua_pushinteger(L, 0);
+        lua_pushinteger(L, 0);
+        return 3;
+
+    case PARAM_INT:
+    case PARAM_FLOAT:
+        lua_pushlstring(L, buf, put_param_text(L, 1, type, buf, sizeof(buf)));
+        lua_pushinteger(L, 0);
+        lua_pushinteger(L, 0);
+        return 3;
+
+    default:
+        lua_pushlstring(L, buf, put_param(L, 1, type, buf) - buf);
+        lua_pushinteger(L, PARAM_OIDS[type][0]);
+        lua_pushinteger(L, 1);
+        return 3;
+    }
+}
+
+LUALIB_API int luaopen_postgres_binary(lua_State *L)
+{
+    struct luaL_Reg funcs[] = {
+        {"int2",        int2_lua       },
+        {"int4",        int4_lua       },
+        {"int8",        int8_lua       },
+        {"float4",      float4_lua     },
+        {"float8",      float8_lua     },
+        {"bool",        bool_lua       },
+        {"bytea",       bytea_lua      },
+        {"uuid",        uuid_lua       },
+        {"date",        date_lua       },
+        {"timestamp",   timestamp_lua  },
+        {"timestamptz", timestamptz_lua},
+        {"array",       array_lua      },
+        {"encode",      encode_lua     },
+        {NULL,          NULL           }
+    };
+    struct luaL_Reg *ptr = funcs;
+
+    lua_newtable(L);
+    while (ptr->name) {
+        lua_pushcfunction(L, ptr->func);
+        lua_setfield(L, -2, ptr->name);
+        ptr++;
+    }
+    return 1;
+}
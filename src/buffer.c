@@ -0,0 +1,294 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// lua
+#include <lauxlib.h>
+// system
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+
+#define MODULE_MT BUFFER_MT
+
+// minimum capacity of the buffer
+#define BUFFER_MINCAP 4096
+
+static int reserve(buffer_t *b, size_t len)
+{
+    size_t unread = b->tail - b->head;
+    size_t cap    = b->cap;
+    char *data    = NULL;
+
+    if (b->cap - b->tail >= len) {
+        // enough free space
+        return 0;
+    } else if (b->head > 0) {
+        // reclaim the consumed area
+        if (unread) {
+            memmove(b->data, b->data + b->head, unread);
+        }
+        b->head = 0;
+        b->tail = unread;
+        if (b->cap - b->tail >= len) {
+            return 0;
+        }
+    }
+
+    // grow the buffer
+    if (cap < BUFFER_MINCAP) {
+        cap = BUFFER_MINCAP;
+    }
+    while (cap - unread < len) {
+        if (cap > SIZE_MAX / 2) {
+            errno = ENOMEM;
+            return -1;
+        }
+        cap *= 2;
+    }
+    data = realloc(b->data, cap);
+    if (!data) {
+        return -1;
+    }
+    b->data = data;
+    b->cap  = cap;
+    return 0;
+}
+
+static inline void consume(buffer_t *b, size_t len)
+{
+    b->head += len;
+    if (b->head >= b->tail) {
+        // rewind the cursors if all data has been consumed
+        b->head = 0;
+        b->tail = 0;
+    }
+}
+
+/**
+ * Get the length of the message at the read cursor.
+ *
+ * The backend message is composed of the following fields;
+ *
+ *  Byte1   - message type
+ *  Int32   - length of message contents in bytes, including self.
+ *
+ * @param L Lua state
+ * @return length of the message including the message type,
+ *         or nil, nil, true if the message is not yet complete,
+ *         or nil, error message if the message length is invalid.
+ */
+static int framelen_lua(lua_State *L)
+{
+    buffer_t *b   = luaL_checkudata(L, 1, MODULE_MT);
+    size_t unread = b->tail - b->head;
+    int32_t len   = 0;
+
+    if (unread < 1 + sizeof(int32_t)) {
+        // not enough
+        lua_pushnil(L);
+        lua_pushnil(L);
+        lua_pushboolean(L, 1);
+        return 3;
+    }
+
+    memcpy(&len, b->data + b->head + 1, sizeof(int32_t));
+    len = ntohl(len);
+    if (len < (int32_t)sizeof(int32_t)) {
+        lua_pushnil(L);
+        lua_pushstring(L, "invalid message length: message length "
+                          "must be greater than or equal to its own length");
+        return 2;
+    } else if (unread < (size_t)len + 1) {
+        // not enough
+        lua_pushnil(L);
+        lua_pushnil(L);
+        lua_pushboolean(L, 1);
+        return 3;
+    }
+
+    lua_pushinteger(L, (lua_Integer)len + 1);
+    return 1;
+}
+
+/**
+ * Read the specified number of bytes from the read cursor and advance it.
+ * If the number of bytes is not specified, all unread data is read.
+ *
+ * @param L Lua state
+ * @return string
+ */
+static int read_lua(lua_State *L)
+{
+    buffer_t *b   = luaL_checkudata(L, 1, MODULE_MT);
+    size_t unread = b->tail - b->head;
+    lua_Integer n = luaL_optinteger(L, 2, (lua_Integer)unread);
+
+    luaL_argcheck(L, n >= 0, 2, "length must be unsigned integer");
+    if ((size_t)n > unread) {
+        n = (lua_Integer)unread;
+    }
+    lua_pushlstring(L, b->data + b->head, (size_t)n);
+    consume(b, (size_t)n);
+    return 1;
+}
+
+/**
+ * Advance the read cursor without copying the data.
+ *
+ * @param L Lua state
+ * @return number of consumed bytes
+ */
+static int consume_lua(lua_State *L)
+{
+    buffer_t *b   = luaL_checkudata(L, 1, MODULE_MT);
+    size_t unread = b->tail - b->head;
+    lua_Integer n = luaL_checkinteger(L, 2);
+
+    luaL_argcheck(L, n >= 0, 2, "length must be unsigned integer");
+    if ((size_t)n > unread) {
+        n = (lua_Integer)unread;
+    }
+    consume(b, (size_t)n);
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+/**
+ * Append data to the tail of the buffer.
+ *
+ * @param L Lua state
+ * @return number of unread bytes
+ */
+static int write_lua(lua_State *L)
+{
+    buffer_t *b     = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len      = 0;
+    const char *str = luaL_checklstring(L, 2, &len);
+
+    if (len) {
+        if (reserve(b, len) != 0) {
+            return luaL_error(L, "failed to allocate memory: %s",
+                              strerror(errno));
+        }
+        memcpy(b->data + b->tail, str, len);
+        b->tail += len;
+    }
+    lua_pushinteger(L, (lua_Integer)(b->tail - b->head));
+    return 1;
+}
+
+/**
+ * Discard all unread data.
+ *
+ * @param L Lua state
+ */
+static int clear_lua(lua_State *L)
+{
+    buffer_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    b->head = 0;
+    b->tail = 0;
+    return 0;
+}
+
+static int len_lua(lua_State *L)
+{
+    buffer_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, (lua_Integer)(b->tail - b->head));
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MODULE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    buffer_t *b = lua_touserdata(L, 1);
+
+    if (b->data) {
+        free(b->data);
+        b->data = NULL;
+    }
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    buffer_t *b = lua_newuserdata(L, sizeof(buffer_t));
+
+    *b = (buffer_t){0};
+    luaL_getmetatable(L, MODULE_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_buffer(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua      },
+        {"__tostring", tostring_lua},
+        {"__len",      len_lua     },
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg method[] = {
+        {"len",      len_lua     },
+        {"write",    write_lua   },
+        {"framelen", framelen_lua},
+        {"read",     read_lua    },
+        {"consume",  consume_lua },
+        {"clear",    clear_lua   },
+        {NULL,       NULL        }
+    };
+
+    // create metatable
+    if (luaL_newmetatable(L, MODULE_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        // metamethods
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        // methods
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_pushcfunction(L, new_lua);
+    lua_setfield(L, -2, "new");
+    return 1;
+}
@@ -0,0 +1,49 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef postgres_buffer_h
+#define postgres_buffer_h
+
+#include <stddef.h>
+
+#define BUFFER_MT "postgres.buffer"
+
+/**
+ * Receive buffer with a read cursor.
+ *
+ *  data           head                tail             cap
+ *   |  consumed    |     unread data    |    free space   |
+ *
+ * Written data is appended at the tail, and the read cursor (head) is moved
+ * forward as data is consumed. The consumed area is reclaimed by moving the
+ * unread data to the front of the buffer only when the free space is not
+ * enough to append new data, so each byte is copied at most once unless the
+ * message is not yet complete.
+ */
+typedef struct {
+    char *data;
+    size_t cap;
+    size_t head;
+    size_t tail;
+} buffer_t;
+
+#endif
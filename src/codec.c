@@ -0,0 +1,823 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// lua
+#include <lauxlib.h>
+// system
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "buffer.h"
+
+static inline int16_t get_int16(const char *p)
+{
+    uint16_t v = 0;
+    memcpy(&v, p, sizeof(uint16_t));
+    return (int16_t)ntohs(v);
+}
+
+static inline int32_t get_int32(const char *p)
+{
+    uint32_t v = 0;
+    memcpy(&v, p, sizeof(uint32_t));
+    return (int32_t)ntohl(v);
+}
+
+static inline uint32_t get_uint32(const char *p)
+{
+    uint32_t v = 0;
+    memcpy(&v, p, sizeof(uint32_t));
+    return ntohl(v);
+}
+
+static inline int again(lua_State *L)
+{
+    lua_pushnil(L);
+    lua_pushnil(L);
+    lua_pushboolean(L, 1);
+    return 3;
+}
+
+static inline int decode_error(lua_State *L, const char *msg)
+{
+    lua_pushnil(L);
+    lua_pushstring(L, msg);
+    return 2;
+}
+
+/**
+ * check the message type and extract the message length.
+ *
+ * @param type message type
+ * @param data message data
+ * @param len length of data
+ * @param msglen length of the message contents
+ * @return 0 on success, 1 if the message is not yet complete, -1 if the
+ *         message type does not match.
+ */
+static inline int check_header(const char type, const char *data, size_t len,
+                               int32_t *msglen)
+{
+    if (len < 1) {
+        return 1;
+    } else if (*data != type) {
+        return -1;
+    } else if (len < 1 + sizeof(int32_t)) {
+        return 1;
+    }
+    *msglen = get_int32(data + 1);
+    return 0;
+}
+
+/**
+ * get the data to decode from the string or postgres.buffer at idx, and the
+ * optional 1-based offset at idx + 1.
+ *
+ * @param L Lua state
+ * @param idx index of the string or postgres.buffer
+ * @param data pointer to the data at the offset
+ * @return length of the data after the offset
+ */
+static size_t check_data(lua_State *L, int idx, const char **data)
+{
+    size_t len         = 0;
+    const char *str    = NULL;
+    lua_Integer offset = luaL_optinteger(L, idx + 1, 1);
+
+    if (lua_type(L, idx) == LUA_TUSERDATA) {
+        buffer_t *b = luaL_checkudata(L, idx, BUFFER_MT);
+        str         = b->data + b->head;
+        len         = b->tail - b->head;
+    } else {
+        str = luaL_checklstring(L, idx, &len);
+    }
+
+    luaL_argcheck(L, offset >= 1, idx + 1, "offset must be greater than 0");
+    if ((size_t)offset > len) {
+        *data = str + len;
+        return 0;
+    }
+    *data = str + offset - 1;
+    return len - (size_t)(offset - 1);
+}
+
+/**
+ * decode the contents of the DataRow message and set the values field to the
+ * table at idx. the message must be complete.
+ *
+ * @param L Lua state
+ * @param idx index of the msg table
+ * @param data message data
+ * @param msglen length of the message contents
+ * @return 0 on success, or -1 with the error message pushed onto the stack.
+ */
+static int decode_data_row(lua_State *L, int idx, const char *data,
+                           int32_t msglen)
+{
+    const char *head = data + 1 + sizeof(int32_t);
+    const char *tail = data + 1 + msglen;
+    int16_t ncol     = 0;
+
+    if (msglen < 6) {
+        lua_pushliteral(L, "length is not greater than 5");
+        return -1;
+    }
+
+    ncol = get_int16(head);
+    head += sizeof(int16_t);
+    if (ncol < 0) {
+        lua_pushliteral(L, "number of column values is not greater than or "
+                           "equal to 0");
+        return -1;
+    }
+
+    lua_createtable(L, ncol, 0);
+    for (int i = 1; i <= ncol; i++) {
+        int32_t vlen = 0;
+
+        if (tail - head < (ptrdiff_t)sizeof(int32_t)) {
+            lua_pop(L, 1);
+            lua_pushliteral(L, "message length is not enough to decode "
+                               "column values");
+            return -1;
+        }
+        vlen = get_int32(head);
+        head += sizeof(int32_t);
+        if (vlen < -1) {
+            lua_pop(L, 1);
+            lua_pushfstring(L, "column value#%d length %d is not supported", i,
+                            (int)vlen);
+            return -1;
+        } else if (vlen == -1) {
+            // NULL column value
+            continue;
+        } else if (tail - head < (ptrdiff_t)vlen) {
+            lua_pop(L, 1);
+            lua_pushliteral(L, "message length is not enough to decode "
+                               "column values");
+            return -1;
+        }
+        lua_pushlstring(L, head, vlen);
+        lua_rawseti(L, -2, i);
+        head += vlen;
+    }
+
+    // check the remaining message length
+    if (head != tail) {
+        lua_pop(L, 1);
+        lua_pushfstring(L,
+                        "message length is too long (unknown %d bytes of data "
+                        "remains)",
+                        (int)(tail - head));
+        return -1;
+    }
+
+    lua_setfield(L, idx, "values");
+    lua_pushliteral(L, "DataRow");
+    lua_setfield(L, idx, "type");
+    return 0;
+}
+
+#define DATA_ROW_MT "postgres.data_row"
+
+/**
+ * offset and length of a column value in the data of the lazy DataRow.
+ */
+typedef struct {
+    uint32_t off;
+    // length of the value, or -1 for the NULL column value
+    int32_t len;
+} data_col_t;
+
+/**
+ * lazy DataRow holds a copy of the column values with the index of them.
+ * the column values are pushed as Lua strings only when they are accessed.
+ * the index and the data are allocated in the same block as this struct.
+ */
+typedef struct {
+    int ncol;
+    data_col_t *cols;
+    char *data;
+} data_row_t;
+
+/**
+ * decode the contents of the DataRow message and set the values field to the
+ * postgres.data_row userdata that indexes the column values without creating
+ * the Lua strings. the message must be complete.
+ *
+ * @param L Lua state
+ * @param idx index of the msg table
+ * @param data message data
+ * @param msglen length of the message contents
+ * @return 0 on success, or -1 with the error message pushed onto the stack.
+ */
+static int decode_data_row_lazy(lua_State *L, int idx, const char *data,
+                                int32_t msglen)
+{
+    const char *head = data + 1 + sizeof(int32_t);
+    size_t datalen   = 0;
+    data_row_t *row  = NULL;
+    uint32_t pos     = 0;
+    int16_t ncol     = 0;
+
+    if (msglen < 6) {
+        lua_pushliteral(L, "length is not greater than 5");
+        return -1;
+    }
+
+    ncol = get_int16(head);
+    head += sizeof(int16_t);
+    if (ncol < 0) {
+        lua_pushliteral(L, "number of column values is not greater than or "
+                           "equal to 0");
+        return -1;
+    }
+
+    // copy the column values and build the index in a single pass
+    datalen = (size_t)msglen - sizeof(int32_t) - sizeof(int16_t);
+    row = lua_newuserdata(L, sizeof(data_row_t) + sizeof(data_col_t) * ncol +
+                                 datalen);
+    row->ncol = ncol;
+    row->cols = (data_col_t *)(row + 1);
+    row->data = (char *)(row->cols + ncol);
+    memcpy(row->data, head, datalen);
+    for (int i = 0; i < ncol; i++) {
+        int32_t vlen = 0;
+
+        if (datalen - pos < sizeof(int32_t)) {
+            lua_pop(L, 1);
+            lua_pushliteral(L, "message length is not enough to decode "
+                               "column values");
+            return -1;
+        }
+        vlen = get_int32(row->data + pos);
+        pos += sizeof(int32_t);
+        if (vlen < -1) {
+            lua_pop(L, 1);
+            lua_pushfstring(L, "column value#%d length %d is not supported",
+                            i + 1, (int)vlen);
+            return -1;
+        } else if (vlen > 0 && datalen - pos < (size_t)vlen) {
+            lua_pop(L, 1);
+            lua_pushliteral(L, "message length is not enough to decode "
+                               "column values");
+            return -1;
+        }
+        row->cols[i] = (data_col_t){.off = pos, .len = vlen};
+        if (vlen > 0) {
+            pos += (uint32_t)vlen;
+        }
+    }
+
+    // check the remaining message length
+    if (pos != datalen) {
+        lua_pop(L, 1);
+        lua_pushfstring(L,
+                        "message length is too long (unknown %d bytes of data "
+                        "remains)",
+                        (int)(datalen - pos));
+        return -1;
+    }
+
+    luaL_getmetatable(L, DATA_ROW_MT);
+    lua_setmetatable(L, -2);
+    lua_setfield(L, idx, "values");
+    lua_pushliteral(L, "DataRow");
+    lua_setfield(L, idx, "type");
+    return 0;
+}
+
+/**
+ * get the column value of the lazy DataRow.
+ *
+ * @param L Lua state
+ * @return the column value, or nil if the column value is NULL or the column
+ *         number is out of range.
+ */
+static int data_row_index_lua(lua_State *L)
+{
+    data_row_t *row = luaL_checkudata(L, 1, DATA_ROW_MT);
+    lua_Integer col = 0;
+
+    // lua_tointegerx is not available in Lua 5.1
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        col = lua_tointeger(L, 2);
+        if ((lua_Number)col != lua_tonumber(L, 2)) {
+            // non-integral number
+            col = 0;
+        }
+    }
+
+    if (col >= 1 && col <= row->ncol) {
+        data_col_t *c = row->cols + col - 1;
+        if (c->len >= 0) {
+            lua_pushlstring(L, row->data + c->off, (size_t)c->len);
+            return 1;
+        }
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+static int data_row_len_lua(lua_State *L)
+{
+    data_row_t *row = luaL_checkudata(L, 1, DATA_ROW_MT);
+
+    lua_pushinteger(L, row->ncol);
+    return 1;
+}
+
+static int data_row_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, DATA_ROW_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+/**
+ * decode the contents of the RowDescription message and set the fields field
+ * to the table at idx. the message must be complete.
+ *
+ * @param L Lua state
+ * @param idx index of the msg table
+ * @param data message data
+ * @param msglen length of the message contents
+ * @return 0 on success, or -1 with the error message pushed onto the stack.
+ */
+static int decode_row_description(lua_State *L, int idx, const char *data,
+                                  int32_t msglen)
+{
+    // size of the fixed length fields that follow the field name
+    static const ptrdiff_t FIELD_ATTRLEN = sizeof(int32_t) + sizeof(int16_t) +
+                                           sizeof(int32_t) + sizeof(int16_t) +
+                                           sizeof(int32_t) + sizeof(int16_t);
+    const char *head = data + 1 + sizeof(int32_t);
+    const char *tail = data + 1 + msglen;
+    int16_t nfield   = 0;
+
+    if (msglen < (int32_t)(sizeof(int32_t) + sizeof(int16_t))) {
+        lua_pushliteral(L, "length is not greater than 5");
+        return -1;
+    }
+
+    nfield = get_int16(head);
+    head += sizeof(int16_t);
+
+    lua_createtable(L, nfield > 0 ? nfield : 0, nfield > 0 ? nfield : 0);
+    for (int i = 1; i <= nfield; i++) {
+        const char *name = head;
+        const char *eos  = memchr(head, '\0', tail - head);
+
+        if (!eos) {
+            lua_pop(L, 1);
+            lua_pushliteral(L, "field name is not null-terminated");
+            return -1;
+        }
+        head = eos + 1;
+        if (tail - head < FIELD_ATTRLEN) {
+            lua_pop(L, 1);
+            lua_pushliteral(L, "message length is not enough to decode field "
+                               "attributes");
+            return -1;
+        }
+
+        lua_createtable(L, 0, 8);
+        lua_pushinteger(L, i);
+        lua_setfield(L, -2, "col");
+        lua_pushlstring(L, name, eos - name);
+        lua_setfield(L, -2, "name");
+        // table object ID
+        lua_pushinteger(L, get_uint32(head));
+        lua_setfield(L, -2, "table_oid");
+        head += sizeof(int32_t);
+        // attribute number of the column
+        lua_pushinteger(L, get_int16(head));
+        lua_setfield(L, -2, "table_col");
+        head += sizeof(int16_t);
+        // object ID of the field's data type
+        lua_pushinteger(L, get_uint32(head));
+        lua_setfield(L, -2, "type_oid");
+        head += sizeof(int32_t);
+        // data type size
+        lua_pushinteger(L, get_int16(head));
+        lua_setfield(L, -2, "size");
+        head += sizeof(int16_t);
+        // type modifier
+        lua_pushinteger(L, get_int32(head));
+        lua_setfield(L, -2, "modifier");
+        head += sizeof(int32_t);
+        // format code
+        if (get_int16(head) == 0) {
+            lua_pushliteral(L, "text");
+        } else {
+            lua_pushliteral(L, "binary");
+        }
+        lua_setfield(L, -2, "format");
+        head += sizeof(int16_t);
+
+        // fields[name] = field
+        lua_pushlstring(L, name, eos - name);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -4);
+        // fields[i] = field
+        lua_rawseti(L, -2, i);
+    }
+
+    lua_setfield(L, idx, "fields");
+    lua_pushliteral(L, "RowDescription");
+    lua_setfield(L, idx, "type");
+    return 0;
+}
+
+/**
+ * decode the contents of the CopyData message and set the data field to the
+ * table at idx. the message must be complete.
+ *
+ * @param L Lua state
+ * @param idx index of the msg table
+ * @param data message data
+ * @param msglen length of the message contents
+ * @return 0 on success.
+ */
+static int decode_copy_data(lua_State *L, int idx, const char *data,
+                            int32_t msglen)
+{
+    lua_pushlstring(L, data + 1 + sizeof(int32_t),
+                    (size_t)msglen - sizeof(int32_t));
+    lua_setfield(L, idx, "data");
+    lua_pushliteral(L, "CopyData");
+    lua_setfield(L, idx, "type");
+    return 0;
+}
+
+typedef int (*decoder_t)(lua_State *L, int idx, const char *data,
+                         int32_t msglen);
+
+/**
+ * decode a message of the specified type with the decoder and set the
+ * following fields to the msg table.
+ *
+ *  consumed: number of bytes of the message
+ *  type: message type name
+ *  ...: fields of the message
+ *
+ * @param L Lua state
+ * @param type message type
+ * @param decoder decoder of the message contents
+ * @param minlen minimum length of the message contents including self
+ * @return true on success, or nil, error message, or nil, nil, true if the
+ *         message is not yet complete.
+ */
+static int decode_message(lua_State *L, const char type, decoder_t decoder,
+                          int32_t minlen)
+{
+    const char *data = NULL;
+    size_t len       = 0;
+    int32_t msglen   = 0;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    len = check_data(L, 2, &data);
+    // keep the data argument on the stack to anchor the data while decoding
+    lua_settop(L, 2);
+
+    switch (check_header(type, data, len, &msglen)) {
+    case 1:
+        return again(L);
+    case -1:
+        lua_pushnil(L);
+        lua_pushfstring(L, "message type is not '%c'", type);
+        return 2;
+    }
+
+    if (msglen < (int32_t)sizeof(int32_t)) {
+        return decode_error(L, "invalid message length: message length "
+                               "must be greater than or equal to its own "
+                               "length");
+    } else if (len < (size_t)msglen + 1) {
+        // the length check of the message contents is done by the decoder
+        // before waiting for the rest of the message
+        if (msglen < minlen) {
+            lua_pushnil(L);
+            lua_pushfstring(L, "length is not greater than %d",
+                            (int)minlen - 1);
+            return 2;
+        }
+        return again(L);
+    } else if (decoder(L, 1, data, msglen) != 0) {
+        lua_pushnil(L);
+        lua_insert(L, -2);
+        return 2;
+    }
+
+    lua_pushinteger(L, (lua_Integer)msglen + 1);
+    lua_setfield(L, 1, "consumed");
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * decode DataRow message and set the following fields to the msg table.
+ *
+ *  consumed: number of bytes of the message
+ *  type: 'DataRow'
+ *  values: array of column values (NULL column value is set as nil)
+ *
+ * DataRow (B)
+ *   Byte1('D')
+ *   Int32      - Length of message contents in bytes, including self.
+ *   Int16      - The number of column values that follow (possibly zero).
+ *   Next, the following pair of fields appear for each column:
+ *   Int32      - The length of the column value, in bytes (this count does
+ *                not include itself). Can be zero. As a special case, -1
+ *                indicates a NULL column value.
+ *   Byten      - The value of the column.
+ *
+ * @param L Lua state
+ * @return true on success, or nil, error message, or nil, nil, true if the
+ *         message is not yet complete.
+ */
+static int decode_data_row_lua(lua_State *L)
+{
+    return decode_message(L, 'D', decode_data_row, 6);
+}
+
+/**
+ * decode RowDescription message and set the following fields to the msg
+ * table.
+ *
+ *  consumed: number of bytes of the message
+ *  type: 'RowDescription'
+ *  fields: array of field descriptions that can also be referenced by name
+ *
+ * RowDescription (B)
+ *   Byte1('T')
+ *   Int32      - Length of message contents in bytes, including self.
+ *   Int16      - Specifies the number of fields in a row (can be zero).
+ *   Then, for each field, there is the following:
+ *   String     - The field name.
+ *   Int32      - The object ID of the table; otherwise zero.
+ *   Int16      - The attribute number of the column; otherwise zero.
+ *   Int32      - The object ID of the field's data type.
+ *   Int16      - The data type size (see pg_type.typlen).
+ *   Int32      - The type modifier (see pg_attribute.atttypmod).
+ *   Int16      - The format code being used for the field.
+ *
+ * @param L Lua state
+ * @return true on success, or nil, error message, or nil, nil, true if the
+ *         message is not yet complete.
+ */
+static int decode_row_description_lua(lua_State *L)
+{
+    return decode_message(L, 'T', decode_row_description, 6);
+}
+
+/**
+ * decode CopyData message and set the following fields to the msg table.
+ *
+ *  consumed: number of bytes of the message
+ *  type: 'CopyData'
+ *  data: data that forms part of a COPY data stream
+ *
+ * CopyData (F & B)
+ *   Byte1('d')
+ *   Int32      - Length of message contents in bytes, including self.
+ *   Byten      - Data that forms part of a COPY data stream.
+ *
+ * @param L Lua state
+ * @return true on success, or nil, error message, or nil, nil, true if the
+ *         message is not yet complete.
+ */
+static int decode_copy_data_lua(lua_State *L)
+{
+    return decode_message(L, 'd', decode_copy_data, 4);
+}
+
+/**
+ * get the decoder of the message contents that can be decoded without
+ * calling the Lua function.
+ */
+static inline decoder_t native_decoder(const char type, const char **name,
+                                       int lazy)
+{
+    switch (type) {
+    case 'D':
+        *name = "DataRow";
+        return lazy ? decode_data_row_lazy : decode_data_row;
+    case 'T':
+        *name = "RowDescription";
+        return decode_row_description;
+    case 'd':
+        *name = "CopyData";
+        return decode_copy_data;
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * decode all complete messages in the data from the offset in one call.
+ *
+ * the decoders table maps the message type to the following value;
+ *
+ *  function: decoder function that takes a message string and returns a
+ *            message object, or nil and error.
+ *  table: metatable of the message object that is decoded natively. it can
+ *         be used only for the DataRow, RowDescription and CopyData
+ *         messages.
+ *
+ * if the lazy argument is true, the values field of the DataRow message is
+ * set to the postgres.data_row userdata instead of the array of strings.
+ *
+ * @param L Lua state
+ * @return array of decoded messages and the offset of the first undecoded
+ *         byte, or nil and error.
+ */
+static int decode_many_lua(lua_State *L)
+{
+    const char *data = NULL;
+    size_t len       = 0;
+    size_t limit     = SIZE_MAX;
+    size_t pos       = 0;
+    size_t n         = 0;
+    int lazy         = 0;
+    lua_Integer offset;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    len    = check_data(L, 2, &data);
+    offset = luaL_optinteger(L, 3, 1);
+    if (!lua_isnoneornil(L, 4)) {
+        lua_Integer v = luaL_checkinteger(L, 4);
+        luaL_argcheck(L, v > 0, 4, "limit must be greater than 0");
+        limit = (size_t)v;
+    }
+    lazy = lua_toboolean(L, 5);
+    // keep the data argument on the stack to anchor the data while decoding
+    lua_settop(L, 2);
+    // array of the decoded messages
+    lua_newtable(L);
+
+    while (n < limit && len - pos >= 1 + sizeof(int32_t)) {
+        const char *msg = data + pos;
+        int32_t msglen  = get_int32(msg + 1);
+
+        if (msglen < (int32_t)sizeof(int32_t)) {
+            return decode_error(L, "invalid message length: message length "
+                                   "must be greater than or equal to its own "
+                                   "length");
+        } else if (len - pos < (size_t)msglen + 1) {
+            // not yet complete
+            break;
+        }
+
+        lua_pushlstring(L, msg, 1);
+        lua_rawget(L, 1);
+        switch (lua_type(L, -1)) {
+        case LUA_TTABLE: {
+            const char *name  = NULL;
+            decoder_t decoder = native_decoder(*msg, &name, lazy);
+
+            if (!decoder) {
+                lua_pushnil(L);
+                lua_pushfstring(L,
+                                "message type '%c' cannot be decoded natively",
+                                *msg);
+                return 2;
+            }
+            lua_createtable(L, 0, 4);
+            lua_insert(L, -2);
+            lua_setmetatable(L, -2);
+            if (decoder(L, lua_gettop(L), msg, msglen) != 0) {
+                lua_pushnil(L);
+                lua_pushfstring(L, "invalid %s message: %s", name,
+                                lua_tostring(L, -2));
+                return 2;
+            }
+        } break;
+
+        case LUA_TFUNCTION:
+            lua_pushlstring(L, msg, (size_t)msglen + 1);
+            lua_call(L, 1, 2);
+            if (lua_isnil(L, -2)) {
+                lua_pushnil(L);
+                if (lua_isnil(L, -2)) {
+                    // decoder requires more data than the message length
+                    lua_pushliteral(L, "invalid message: message length is "
+                                       "not enough");
+                } else {
+                    lua_pushvalue(L, -2);
+                }
+                return 2;
+            }
+            lua_pop(L, 1);
+            break;
+
+        default:
+            lua_pushnil(L);
+            lua_pushfstring(L, "unknown message type '%c'", *msg);
+            return 2;
+        }
+
+        lua_rawseti(L, 3, ++n);
+        pos += (size_t)msglen + 1;
+    }
+
+    lua_pushinteger(L, offset + (lua_Integer)pos);
+    return 2;
+}
+
+/**
+ * skip the consecutive complete messages of the specified type from the
+ * offset without decoding them. only the type byte and the length of each
+ * message are read.
+ *
+ * @param L Lua state
+ * @return number of skipped messages and the offset of the first unskipped
+ *         byte. it stops at the message of the other type, the incomplete
+ *         message or the message with the invalid length that will be
+ *         reported by the decoder.
+ */
+static int skip_many_lua(lua_State *L)
+{
+    size_t tlen      = 0;
+    const char *type = luaL_checklstring(L, 1, &tlen);
+    const char *data = NULL;
+    size_t len       = 0;
+    size_t pos       = 0;
+    lua_Integer n    = 0;
+    lua_Integer offset;
+
+    luaL_argcheck(L, tlen == 1, 1, "type must be a single character");
+    len    = check_data(L, 2, &data);
+    offset = luaL_optinteger(L, 3, 1);
+    while (len - pos >= 1 + sizeof(int32_t) && data[pos] == *type) {
+        int32_t msglen = get_int32(data + pos + 1);
+
+        if (msglen < (int32_t)sizeof(int32_t) ||
+            len - pos < (size_t)msglen + 1) {
+            break;
+        }
+        pos += (size_t)msglen + 1;
+        n++;
+    }
+
+    lua_pushinteger(L, n);
+    lua_pushinteger(L, offset + (lua_Integer)pos);
+    return 2;
+}
+
+LUALIB_API int luaopen_postgres_codec(lua_State *L)
+{
+    struct luaL_Reg funcs[] = {
+        {"decode_data_row",        decode_data_row_lua       },
+        {"decode_row_description", decode_row_description_lua},
+        {"decode_copy_data",       decode_copy_data_lua      },
+        {"decode_many",            decode_many_lua           },
+        {"skip_many",              skip_many_lua             },
+        {NULL,                     NULL                      }
+    };
+    struct luaL_Reg data_row_mmethod[] = {
+        {"__index",    data_row_index_lua   },
+        {"__len",      data_row_len_lua     },
+        {"__tostring", data_row_tostring_lua},
+        {NULL,         NULL                 }
+    };
+    struct luaL_Reg *ptr = data_row_mmethod;
+
+    // create metatable of the lazy DataRow
+    if (luaL_newmetatable(L, DATA_ROW_MT)) {
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+    }
+    lua_pop(L, 1);
+
+    ptr = funcs;
+    lua_newtable(L);
+    while (ptr->name) {
+        lua_pushcfunction(L, ptr->func);
+        lua_setfield(L, -2, ptr->name);
+        ptr++;
+    }
+    return 1;
+}
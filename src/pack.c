@@ -0,0 +1,322 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// system
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODULE_MT "postgres.pack"
+
+// minimum capacity of the buffer
+#define PACK_MINCAP 1024
+// the buffer larger than this size is released by the clear method
+#define PACK_MAXKEEP (64 * 1024)
+
+/**
+ * Write buffer to build the frontend messages.
+ *
+ *  data        msghead            len          cap
+ *   |  messages  | message in progress |  free space  |
+ *
+ * The typed values are appended in the network byte order. The length field
+ * of the message started by the begin method is written as a placeholder and
+ * back-patched by the finish method, so the messages are built without
+ * creating the intermediate strings.
+ */
+typedef struct {
+    char *data;
+    size_t cap;
+    size_t len;
+    // offset of the length field of the message in progress, or -1
+    ptrdiff_t msghead;
+} pack_t;
+
+static void reserve(lua_State *L, pack_t *p, size_t len)
+{
+    size_t cap = p->cap;
+    char *data = NULL;
+
+    if (cap - p->len >= len) {
+        return;
+    } else if (cap < PACK_MINCAP) {
+        cap = PACK_MINCAP;
+    }
+    while (cap - p->len < len) {
+        if (cap > SIZE_MAX / 2) {
+            luaL_error(L, "failed to allocate memory: %s", strerror(ENOMEM));
+            return;
+        }
+        cap *= 2;
+    }
+    data = realloc(p->data, cap);
+    if (!data) {
+        luaL_error(L, "failed to allocate memory: %s", strerror(errno));
+        return;
+    }
+    p->data = data;
+    p->cap  = cap;
+}
+
+static inline void append(lua_State *L, pack_t *p, const void *data,
+                          size_t len)
+{
+    reserve(L, p, len);
+    memcpy(p->data + p->len, data, len);
+    p->len += len;
+}
+
+/**
+ * Start a message of the specified type. the length field is written as a
+ * placeholder and back-patched by the finish method.
+ *
+ * @param L Lua state
+ * @return the pack object
+ */
+static int begin_lua(lua_State *L)
+{
+    pack_t *p        = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len       = 0;
+    const char *type = luaL_checklstring(L, 2, &len);
+    char head[1 + sizeof(int32_t)];
+
+    luaL_argcheck(L, len == 1, 2, "type must be a single character");
+    if (p->msghead >= 0) {
+        return luaL_error(L, "message '%c' is not finished",
+                          p->data[p->msghead - 1]);
+    }
+    head[0] = *type;
+    memset(head + 1, 0, sizeof(int32_t));
+    append(L, p, head, sizeof(head));
+    p->msghead = (ptrdiff_t)(p->len - sizeof(int32_t));
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * Back-patch the length field of the message started by the begin method.
+ *
+ * @param L Lua state
+ * @return the pack object
+ */
+static int finish_lua(lua_State *L)
+{
+    pack_t *p  = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len = 0;
+    uint32_t n = 0;
+
+    if (p->msghead < 0) {
+        return luaL_error(L, "no message to finish");
+    }
+    len = p->len - (size_t)p->msghead;
+    if (len > INT32_MAX) {
+        return luaL_error(L, "message length is too long");
+    }
+    n = htonl((uint32_t)len);
+    memcpy(p->data + p->msghead, &n, sizeof(uint32_t));
+    p->msghead = -1;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int int16_lua(lua_State *L)
+{
+    pack_t *p  = luaL_checkudata(L, 1, MODULE_MT);
+    uint16_t n = htons((uint16_t)lauxh_checkint16(L, 2));
+
+    append(L, p, &n, sizeof(uint16_t));
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int int32_lua(lua_State *L)
+{
+    pack_t *p  = luaL_checkudata(L, 1, MODULE_MT);
+    uint32_t n = htonl((uint32_t)lauxh_checkint32(L, 2));
+
+    append(L, p, &n, sizeof(uint32_t));
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * Append the null-terminated string.
+ *
+ * @param L Lua state
+ * @return the pack object
+ */
+static int cstring_lua(lua_State *L)
+{
+    pack_t *p       = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len      = 0;
+    const char *str = luaL_checklstring(L, 2, &len);
+
+    luaL_argcheck(L, memchr(str, '\0', len) == NULL, 2,
+                  "string must not contain the null character");
+    reserve(L, p, len + 1);
+    memcpy(p->data + p->len, str, len);
+    p->data[p->len + len] = '\0';
+    p->len += len + 1;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bytes_lua(lua_State *L)
+{
+    pack_t *p       = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len      = 0;
+    const char *str = luaL_checklstring(L, 2, &len);
+
+    if (len) {
+        append(L, p, str, len);
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * Get the packed data as a string.
+ *
+ * @param L Lua state
+ * @return string
+ */
+static int data_lua(lua_State *L)
+{
+    pack_t *p = luaL_checkudata(L, 1, MODULE_MT);
+
+    if (p->msghead >= 0) {
+        return luaL_error(L, "message '%c' is not finished",
+                          p->data[p->msghead - 1]);
+    }
+    lua_pushlstring(L, p->data, p->len);
+    return 1;
+}
+
+/**
+ * Discard the packed data. the large buffer is released to avoid holding
+ * the memory used for the large message.
+ *
+ * @param L Lua state
+ * @return the pack object
+ */
+static int clear_lua(lua_State *L)
+{
+    pack_t *p = luaL_checkudata(L, 1, MODULE_MT);
+
+    if (p->cap > PACK_MAXKEEP) {
+        free(p->data);
+        p->data = NULL;
+        p->cap  = 0;
+    }
+    p->len     = 0;
+    p->msghead = -1;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int len_lua(lua_State *L)
+{
+    pack_t *p = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, (lua_Integer)p->len);
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MODULE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    pack_t *p = lua_touserdata(L, 1);
+
+    if (p->data) {
+        free(p->data);
+        p->data = NULL;
+    }
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    pack_t *p = lua_newuserdata(L, sizeof(pack_t));
+
+    *p = (pack_t){.msghead = -1};
+    luaL_getmetatable(L, MODULE_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_pack(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua      },
+        {"__tostring", tostring_lua},
+        {"__len",      len_lua     },
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg method[] = {
+        {"len",     len_lua    },
+        {"begin",   begin_lua  },
+        {"finish",  finish_lua },
+        {"int16",   int16_lua  },
+        {"int32",   int32_lua  },
+        {"cstring", cstring_lua},
+        {"bytes",   bytes_lua  },
+        {"data",    data_lua   },
+        {"clear",   clear_lua  },
+        {NULL,      NULL       }
+    };
+
+    // create metatable
+    if (luaL_newmetatable(L, MODULE_MT)) {
+        struct luaL_Reg *ptr = mmethod;
+        // metamethods
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        // methods
+        lua_newtable(L);
+        ptr = method;
+        while (ptr->name) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+            ptr++;
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_pushcfunction(L, new_lua);
+    lua_setfield(L, -2, "new");
+    return 1;
+}
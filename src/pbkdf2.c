@@ -0,0 +1,287 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// system
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * PBKDF2-HMAC-SHA-256 key derivation that is used by the SCRAM-SHA-256
+ * authentication (RFC 5802, RFC 7677).
+ *
+ * the inner and outer HMAC states of the password are computed only once,
+ * so each iteration costs two SHA-256 compressions without any allocation.
+ */
+
+#define SHA256_BLOCK_SIZE  64
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t nbyte;
+    size_t len;
+    unsigned char block[SHA256_BLOCK_SIZE];
+} sha256_t;
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x)       (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define EP1(x)       (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SIG0(x)      (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SIG1(x)      (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+static inline uint32_t get_be32(const unsigned char *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+           (uint32_t)p[3];
+}
+
+static inline void put_be32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void sha256_transform(uint32_t *state, const unsigned char *data)
+{
+    uint32_t w[64];
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t f = state[5];
+    uint32_t g = state[6];
+    uint32_t h = state[7];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = get_be32(data + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+        w[i] = SIG1(w[i - 2]) + w[i - 7] + SIG0(w[i - 15]) + w[i - 16];
+    }
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + EP1(e) + CH(e, f, g) + K[i] + w[i];
+        uint32_t t2 = EP0(a) + MAJ(a, b, c);
+        h           = g;
+        g           = f;
+        f           = e;
+        e           = d + t1;
+        d           = c;
+        c           = b;
+        b           = a;
+        a           = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void sha256_init(sha256_t *ctx)
+{
+    static const uint32_t IV[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(ctx->state, IV, sizeof(IV));
+    ctx->nbyte = 0;
+    ctx->len   = 0;
+}
+
+static void sha256_update(sha256_t *ctx, const unsigned char *data, size_t len)
+{
+    ctx->nbyte += len;
+    if (ctx->len) {
+        size_t n = SHA256_BLOCK_SIZE - ctx->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->block + ctx->len, data, n);
+        ctx->len += n;
+        data += n;
+        len -= n;
+        if (ctx->len < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        sha256_transform(ctx->state, ctx->block);
+        ctx->len = 0;
+    }
+    while (len >= SHA256_BLOCK_SIZE) {
+        sha256_transform(ctx->state, data);
+        data += SHA256_BLOCK_SIZE;
+        len -= SHA256_BLOCK_SIZE;
+    }
+    if (len) {
+        memcpy(ctx->block, data, len);
+        ctx->len = len;
+    }
+}
+
+static void sha256_final(sha256_t *ctx, unsigned char *digest)
+{
+    uint64_t nbit = ctx->nbyte * 8;
+
+    ctx->block[ctx->len++] = 0x80;
+    if (ctx->len > SHA256_BLOCK_SIZE - 8) {
+        memset(ctx->block + ctx->len, 0, SHA256_BLOCK_SIZE - ctx->len);
+        sha256_transform(ctx->state, ctx->block);
+        ctx->len = 0;
+    }
+    memset(ctx->block + ctx->len, 0, SHA256_BLOCK_SIZE - 8 - ctx->len);
+    put_be32(ctx->block + 56, (uint32_t)(nbit >> 32));
+    put_be32(ctx->block + 60, (uint32_t)nbit);
+    sha256_transform(ctx->state, ctx->block);
+    for (int i = 0; i < 8; i++) {
+        put_be32(digest + i * 4, ctx->state[i]);
+    }
+}
+
+/**
+ * compute the HMAC digest of the 32 bytes message with the precomputed inner
+ * and outer states. the message is padded in place, so the compression
+ * function is applied directly without the buffering of sha256_update.
+ */
+static void hmac_digest32(const uint32_t *istate, const uint32_t *ostate,
+                          const unsigned char *msg, unsigned char *digest)
+{
+    unsigned char block[SHA256_BLOCK_SIZE] = {0};
+    uint32_t state[8];
+
+    // inner hash of 64 bytes key block + 32 bytes message
+    memcpy(block, msg, SHA256_DIGEST_SIZE);
+    block[SHA256_DIGEST_SIZE] = 0x80;
+    put_be32(block + 60, (SHA256_BLOCK_SIZE + SHA256_DIGEST_SIZE) * 8);
+    memcpy(state, istate, sizeof(state));
+    sha256_transform(state, block);
+    for (int i = 0; i < 8; i++) {
+        put_be32(block + i * 4, state[i]);
+    }
+
+    // outer hash of 64 bytes key block + 32 bytes inner digest
+    memcpy(state, ostate, sizeof(state));
+    sha256_transform(state, block);
+    for (int i = 0; i < 8; i++) {
+        put_be32(digest + i * 4, state[i]);
+    }
+}
+
+static int pbkdf2_lua(lua_State *L)
+{
+    size_t pswdlen            = 0;
+    const unsigned char *pswd =
+        (const unsigned char *)lauxh_checklstring(L, 1, &pswdlen);
+    size_t saltlen            = 0;
+    const unsigned char *salt =
+        (const unsigned char *)lauxh_checklstring(L, 2, &saltlen);
+    lua_Integer niter = lauxh_checkinteger(L, 3);
+    unsigned char key[SHA256_BLOCK_SIZE]  = {0};
+    unsigned char pad[SHA256_BLOCK_SIZE]  = {0};
+    unsigned char u[SHA256_DIGEST_SIZE]   = {0};
+    unsigned char res[SHA256_DIGEST_SIZE] = {0};
+    uint32_t istate[8];
+    uint32_t ostate[8];
+    sha256_t ctx;
+
+    luaL_argcheck(L, niter > 0, 3, "iteration count must be greater than 0");
+
+    // keys longer than the block size are hashed first
+    if (pswdlen > SHA256_BLOCK_SIZE) {
+        sha256_init(&ctx);
+        sha256_update(&ctx, pswd, pswdlen);
+        sha256_final(&ctx, key);
+    } else {
+        memcpy(key, pswd, pswdlen);
+    }
+
+    // precompute the inner and outer states
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = key[i] ^ 0x36;
+    }
+    sha256_init(&ctx);
+    sha256_transform(ctx.state, pad);
+    memcpy(istate, ctx.state, sizeof(istate));
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = key[i] ^ 0x5c;
+    }
+    sha256_init(&ctx);
+    sha256_transform(ctx.state, pad);
+    memcpy(ostate, ctx.state, sizeof(ostate));
+
+    // U1 = HMAC(password, salt || INT(1))
+    memcpy(ctx.state, istate, sizeof(istate));
+    ctx.nbyte = SHA256_BLOCK_SIZE;
+    ctx.len   = 0;
+    sha256_update(&ctx, salt, saltlen);
+    sha256_update(&ctx, (const unsigned char *)"\0\0\0\1", 4);
+    sha256_final(&ctx, u);
+    memcpy(ctx.state, ostate, sizeof(ostate));
+    ctx.nbyte = SHA256_BLOCK_SIZE;
+    ctx.len   = 0;
+    sha256_update(&ctx, u, SHA256_DIGEST_SIZE);
+    sha256_final(&ctx, u);
+    memcpy(res, u, SHA256_DIGEST_SIZE);
+
+    // Ui = HMAC(password, Ui-1)
+    for (lua_Integer n = 2; n <= niter; n++) {
+        hmac_digest32(istate, ostate, u, u);
+        for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+            res[i] ^= u[i];
+        }
+    }
+
+    lua_pushlstring(L, (const char *)res, SHA256_DIGEST_SIZE);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_pbkdf2(lua_State *L)
+{
+    lua_pushcfunction(L, pbkdf2_lua);
+    return 1;
+}
@@ -0,0 +1,97 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#if defined(__linux__)
+# define _GNU_SOURCE
+#endif
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// system
+#include <errno.h>
+#include <pwd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * Get the user name of the peer process of the unix domain socket.
+ * it is used to verify the requirepeer parameter.
+ *
+ * @param L Lua state
+ * @return user name, or nil and error message.
+ */
+static int peeruser_lua(lua_State *L)
+{
+    int fd             = (int)lauxh_checkinteger(L, 1);
+    struct passwd pwd  = {0};
+    struct passwd *res = NULL;
+    char buf[4096]     = {0};
+    uid_t uid          = 0;
+    int rc             = 0;
+
+#if defined(SO_PEERCRED)
+    struct ucred cred = {0};
+    socklen_t len     = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "failed to get peer credentials: %s",
+                        strerror(errno));
+        return 2;
+    }
+    uid = cred.uid;
+#else
+    gid_t gid = 0;
+
+    if (getpeereid(fd, &uid, &gid) != 0) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "failed to get peer credentials: %s",
+                        strerror(errno));
+        return 2;
+    }
+#endif
+
+    rc = getpwuid_r(uid, &pwd, buf, sizeof(buf), &res);
+    if (rc != 0 || res == NULL) {
+        lua_pushnil(L);
+        if (rc != 0) {
+            lua_pushfstring(L, "failed to look up local user id %d: %s",
+                            (int)uid, strerror(rc));
+        } else {
+            lua_pushfstring(L, "local user with ID %d does not exist",
+                            (int)uid);
+        }
+        return 2;
+    }
+    lua_pushstring(L, pwd.pw_name);
+    return 1;
+}
+
+LUALIB_API int luaopen_postgres_peeruser(lua_State *L)
+{
+    lua_pushcfunction(L, peeruser_lua);
+    return 1;
+}
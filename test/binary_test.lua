@@ -0,0 +1,350 @@
+require('luacov')
+local concat = table.concat
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local binary = require('postgres.binary')
+
+--- int64 encodes the integer as Int64 in network byte order
+--- @param v integer
+--- @return string
+local function int64(v)
+    local hi = math.floor(v / 0x100000000)
+    local lo = v - hi * 0x100000000
+    if lo >= 0x80000000 then
+        lo = lo - 0x100000000
+    end
+    return htonl(hi) .. htonl(lo)
+end
+
+function testcase.int()
+    -- test that decode int2, int4 and int8
+    assert.equal(binary.int2(htons(-2)), -2)
+    assert.equal(binary.int4(htonl(123456)), 123456)
+    assert.equal(binary.int8(int64(1234567890123)), 1234567890123)
+    assert.equal(binary.int8(int64(-2)), -2)
+
+    -- test that return error if data length is invalid
+    local v, err = binary.int4(htons(1))
+    assert.is_nil(v)
+    assert.match(err, 'invalid int4 data length 2')
+end
+
+function testcase.float()
+    -- test that decode float4 and float8
+    assert.equal(binary.float4('\63\192\0\0'), 1.5)
+    assert.equal(binary.float8('\191\248\0\0\0\0\0\0'), -1.5)
+
+    -- test that return error if data length is invalid
+    local v, err = binary.float8('\63\192\0\0')
+    assert.is_nil(v)
+    assert.match(err, 'invalid float8 data length 4')
+end
+
+function testcase.bool()
+    -- test that decode bool
+    assert.is_true(binary.bool('\1'))
+    assert.is_false(binary.bool('\0'))
+end
+
+function testcase.bytea()
+    -- test that decode bytea as is
+    assert.equal(binary.bytea('\0\1\2'), '\0\1\2')
+end
+
+function testcase.uuid()
+    -- test that decode uuid
+    local s = '\160\238\188\153\156\11\78\248\187\109\107\185\189\56\10\17'
+    assert.equal(binary.uuid(s), 'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11')
+end
+
+function testcase.date()
+    -- test that decode date
+    assert.equal(binary.date(htonl(0)), {
+        year = 2000,
+        month = 1,
+        day = 1,
+    })
+    assert.equal(binary.date(htonl(-1)), {
+        year = 1999,
+        month = 12,
+        day = 31,
+    })
+    assert.equal(binary.date(htonl(0x7fffffff)), 'infinity')
+end
+
+function testcase.timestamp()
+    -- test that decode timestamp
+    -- 1999-12-01 13:59:59.123456
+    local usec = ((-31 * 86400) + (13 * 3600) + (59 * 60) + 59) * 1000000 +
+                     123456
+    assert.equal(binary.timestamp(int64(usec)), {
+        year = 1999,
+        month = 12,
+        day = 1,
+        hour = 13,
+        min = 59,
+        sec = 59,
+        usec = 123456,
+    })
+
+    -- test that decode timestamptz in UTC
+    assert.equal(binary.timestamptz(int64(usec)), {
+        year = 1999,
+        month = 12,
+        day = 1,
+        hour = 13,
+        min = 59,
+        sec = 59,
+        usec = 123456,
+        tz = '+',
+        tzhour = 0,
+        tzmin = 0,
+        tzsec = 0,
+    })
+end
+
+function testcase.array()
+    -- test that decode 1-D int4 array with NULL element
+    local s = concat({
+        htonl(1), -- number of dimensions
+        htonl(1), -- has null elements
+        htonl(23), -- element type oid
+        htonl(3), -- number of elements
+        htonl(1), -- lower bound
+        htonl(4),
+        htonl(1),
+        htonl(-1),
+        htonl(4),
+        htonl(3),
+    })
+    assert.equal(binary.array(s), {
+        [1] = 1,
+        [3] = 3,
+    })
+
+    -- test that decode 2-D int2 array
+    s = concat({
+        htonl(2), -- number of dimensions
+        htonl(0), -- has null elements
+        htonl(21), -- element type oid
+        htonl(2), -- number of elements
+        htonl(1), -- lower bound
+        htonl(2), -- number of elements
+        htonl(1), -- lower bound
+        htonl(2),
+        htons(1),
+        htonl(2),
+        htons(2),
+        htonl(2),
+        htons(3),
+        htonl(2),
+        htons(4),
+    })
+    assert.equal(binary.array(s), {
+        {
+            1,
+            2,
+        },
+        {
+            3,
+            4,
+        },
+    })
+
+    -- test that decode empty array
+    s = htonl(0) .. htonl(0) .. htonl(701)
+    assert.equal(binary.array(s), {})
+
+    -- test that return error if element type is not supported
+    local v, err = binary.array(htonl(0) .. htonl(0) .. htonl(25))
+    assert.is_nil(v)
+    assert.match(err, 'element type 25 is not supported')
+
+    -- test that return error if data is not enough
+    s = concat({
+        htonl(1), -- number of dimensions
+        htonl(0), -- has null elements
+        htonl(23), -- element type oid
+        htonl(2), -- number of elements
+        htonl(1), -- lower bound
+        htonl(4),
+        htonl(1),
+    })
+    v, err = binary.array(s)
+    assert.is_nil(v)
+    assert.match(err, 'not enough data')
+
+    -- test that return error if number of elements exceeds the data length
+    s = concat({
+        htonl(2), -- number of dimensions
+        htonl(0), -- has null elements
+        htonl(23), -- element type oid
+        htonl(0x7fffffff), -- number of elements
+        htonl(1), -- lower bound
+        htonl(0x7fffffff), -- number of elements
+        htonl(1), -- lower bound
+        htonl(4),
+        htonl(1),
+    })
+    v, err = binary.array(s)
+    assert.is_nil(v)
+    assert.match(err, 'number of elements exceeds the data length')
+end
+
+function testcase.encode()
+    -- test that encode boolean value
+    local s, oid, fmt = binary.encode(true)
+    assert.equal(s, '\1')
+    assert.equal(oid, 16)
+    assert.equal(fmt, 1)
+
+    -- test that string and numbers are encoded in text format with
+    -- unspecified type
+    for _, v in ipairs({
+        {
+            val = 'hello',
+            exp = 'hello',
+        },
+        {
+            val = 12,
+            exp = '12',
+        },
+        {
+            val = -9223372036854775807,
+            exp = '-9223372036854775807',
+        },
+        {
+            val = 1.5,
+            exp = '1.5',
+        },
+        {
+            val = 0.1,
+            exp = '0.1',
+        },
+        {
+            val = 1 / 3,
+            exp = '0.3333333333333333',
+        },
+    }) do
+        s, oid, fmt = binary.encode(v.val)
+        assert.equal(s, v.exp)
+        assert.equal(oid, 0)
+        assert.equal(fmt, 0)
+    end
+
+    -- test that encode array of integers as int8[]
+    s, oid, fmt = binary.encode({
+        1,
+        2,
+        3,
+    })
+    assert.equal(oid, 1016)
+    assert.equal(fmt, 1)
+    assert.equal(binary.array(s), {
+        1,
+        2,
+        3,
+    })
+
+    -- test that encode 2-D array of numbers as float8[]
+    s, oid = binary.encode({
+        {
+            1,
+            2.5,
+        },
+        {
+            3,
+            4,
+        },
+    })
+    assert.equal(oid, 1022)
+    assert.equal(binary.array(s), {
+        {
+            1,
+            2.5,
+        },
+        {
+            3,
+            4,
+        },
+    })
+
+    -- test that encode array of strings as text[]
+    s, oid = binary.encode({
+        'foo',
+        'bar',
+    })
+    assert.equal(oid, 1009)
+    assert.equal(s, concat({
+        htonl(1), -- number of dimensions
+        htonl(0), -- has null elements
+        htonl(25), -- element type oid
+        htonl(2), -- number of elements
+        htonl(1), -- lower bound
+        htonl(3),
+        'foo',
+        htonl(3),
+        'bar',
+    }))
+
+    -- test that empty array is encoded in text format
+    s, oid, fmt = binary.encode({})
+    assert.equal(s, '{}')
+    assert.equal(oid, 0)
+    assert.equal(fmt, 0)
+
+    -- test that return error if table is not an array
+    local err
+    s, err = binary.encode({
+        foo = 'bar',
+    })
+    assert.is_nil(s)
+    assert.match(err, 'unsupported parameter type: non-array table')
+    s, err = binary.encode({
+        1,
+        2,
+        foo = 'bar',
+    })
+    assert.is_nil(s)
+    assert.match(err, 'unsupported parameter type: non-array table')
+
+    -- test that encode NULL elements of array
+    s = assert(binary.encode({
+        1,
+        nil,
+        3,
+    }))
+    assert.equal(binary.array(s), {
+        1,
+        nil,
+        3,
+    })
+
+    -- test that return error if array elements are not the same type
+    s, err = binary.encode({
+        1,
+        'foo',
+    })
+    assert.is_nil(s)
+    assert.match(err, 'array elements must be the same type')
+
+    -- test that return error if sub-arrays have different dimensions
+    s, err = binary.encode({
+        {
+            1,
+            2,
+        },
+        {
+            3,
+        },
+    })
+    assert.is_nil(s)
+    assert.match(err, 'sub-arrays with matching dimensions')
+
+    -- test that return error if value type is not supported
+    s, err = binary.encode(print)
+    assert.is_nil(s)
+    assert.match(err, 'function type is not supported')
+end
@@ -0,0 +1,131 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local new_buffer = require('postgres.buffer').new
+
+function testcase.new()
+    -- test that create new buffer
+    local buf = new_buffer()
+    assert.match(buf, '^postgres%.buffer: ', false)
+    assert.equal(#buf, 0)
+    assert.equal(buf:len(), 0)
+end
+
+function testcase.write_read()
+    local buf = new_buffer()
+
+    -- test that append data to the tail of buffer
+    assert.equal(buf:write('hello'), 5)
+    assert.equal(buf:write(' world'), 11)
+    assert.equal(#buf, 11)
+
+    -- test that read specified number of bytes from the head of buffer
+    assert.equal(buf:read(6), 'hello ')
+    assert.equal(#buf, 5)
+
+    -- test that read all remaining data if length is not specified
+    assert.equal(buf:read(), 'world')
+    assert.equal(#buf, 0)
+
+    -- test that return empty string if no data
+    assert.equal(buf:read(), '')
+    assert.equal(buf:read(10), '')
+
+    -- test that read only remaining data even if length is greater than it
+    buf:write('foo')
+    assert.equal(buf:read(10), 'foo')
+
+    -- test that throws an error if length is negative
+    local err = assert.throws(buf.read, buf, -1)
+    assert.match(err, 'length must be unsigned integer')
+end
+
+function testcase.write_large_data()
+    local buf = new_buffer()
+    local data = {}
+
+    -- test that data is not corrupted while the buffer is compacted and grown
+    for i = 1, 1000 do
+        local s = string.rep(string.char(i % 256), i)
+        data[#data + 1] = s
+        buf:write(s)
+        if i % 3 == 0 then
+            local v = table.concat(data)
+            assert.equal(buf:read(#v - i), string.sub(v, 1, #v - i))
+            data = {
+                string.sub(v, #v - i + 1),
+            }
+        end
+    end
+    assert.equal(buf:read(), table.concat(data))
+end
+
+function testcase.consume()
+    local buf = new_buffer()
+    buf:write('foobarbaz')
+
+    -- test that advance the read cursor
+    assert.equal(buf:consume(3), 3)
+    assert.equal(buf:read(3), 'bar')
+
+    -- test that consume only remaining data
+    assert.equal(buf:consume(10), 3)
+    assert.equal(#buf, 0)
+
+    -- test that throws an error if length is negative
+    local err = assert.throws(buf.consume, buf, -1)
+    assert.match(err, 'length must be unsigned integer')
+end
+
+function testcase.clear()
+    local buf = new_buffer()
+    buf:write('foobarbaz')
+
+    -- test that discard all unread data
+    buf:clear()
+    assert.equal(#buf, 0)
+    assert.equal(buf:read(), '')
+end
+
+function testcase.framelen()
+    local buf = new_buffer()
+
+    -- test that return again=true if buffer is empty
+    local len, err, again = buf:framelen()
+    assert.is_nil(len)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return again=true if message length is not enough
+    local msg = 'C' .. htonl(4 + 9) .. 'SELECT 1\0'
+    buf:write(string.sub(msg, 1, 3))
+    len, err, again = buf:framelen()
+    assert.is_nil(len)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return again=true if message is not complete
+    buf:write(string.sub(msg, 4, 10))
+    len, err, again = buf:framelen()
+    assert.is_nil(len)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return the length of message including the message type
+    buf:write(string.sub(msg, 11) .. 'Z' .. htonl(5) .. 'I')
+    len, err, again = buf:framelen()
+    assert.equal(len, #msg)
+    assert.is_nil(err)
+    assert.is_nil(again)
+    assert.equal(buf:read(len), msg)
+    assert.equal(buf:framelen(), 6)
+    assert.equal(buf:read(6), 'Z' .. htonl(5) .. 'I')
+
+    -- test that return error if message length is invalid
+    buf:write('Z' .. htonl(3))
+    len, err, again = buf:framelen()
+    assert.is_nil(len)
+    assert.match(err, 'must be greater than or equal to its own length')
+    assert.is_nil(again)
+end
@@ -0,0 +1,130 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local new_stmtcache = require('postgres.connection.stmtcache').new
+
+function testcase.new()
+    -- test that create new cache that is disabled by default
+    local c = new_stmtcache()
+    assert.equal(c:get_capacity(), 0)
+    assert.is_nil(c:get('SELECT 1'))
+    assert.equal(c:stats(), {
+        capacity = 0,
+        size = 0,
+        hits = 0,
+        misses = 0,
+        evictions = 0,
+    })
+
+    -- test that throws an error if capacity is invalid
+    for _, v in ipairs({
+        -1,
+        1.5,
+        'foo',
+    }) do
+        local err = assert.throws(new_stmtcache, v)
+        assert.match(err, 'capacity must be unsigned integer')
+    end
+end
+
+function testcase.get()
+    local c = new_stmtcache(2)
+
+    -- test that add new statement on cache miss
+    local stmt = assert(c:get('SELECT 1'))
+    assert.match(stmt.name, '^postgres_stmt_%d+$', false)
+    assert.equal(stmt.key, 'SELECT 1')
+    assert.is_false(stmt.prepared)
+    assert.equal(c:size(), 1)
+
+    -- test that replace the statement that is not yet prepared
+    local stmt2 = assert(c:get('SELECT 1'))
+    assert.not_equal(stmt2.name, stmt.name)
+    assert.equal(c:size(), 1)
+    assert.equal(c:pop_closes(), {
+        stmt.name,
+    })
+
+    -- test that return the prepared statement on cache hit
+    stmt2.prepared = true
+    assert.equal(c:get('SELECT 1'), stmt2)
+    assert.equal(c:stats(), {
+        capacity = 2,
+        size = 1,
+        hits = 1,
+        misses = 2,
+        evictions = 0,
+    })
+    assert.equal(c:pop_closes(), {})
+end
+
+function testcase.evict_lru()
+    local c = new_stmtcache(2)
+    local s1 = c:get('SELECT 1')
+    s1.prepared = true
+    local s2 = c:get('SELECT 2')
+    s2.prepared = true
+
+    -- test that the least recently used statement is evicted
+    assert.equal(c:get('SELECT 1'), s1)
+    local s3 = c:get('SELECT 3')
+    assert.equal(c:size(), 2)
+    assert.equal(c:pop_closes(), {
+        s2.name,
+    })
+    assert.equal(c:get('SELECT 1'), s1)
+    s3.prepared = true
+    assert.equal(c:get('SELECT 3'), s3)
+    assert.equal(c:stats().evictions, 1)
+
+    -- test that shrinking the capacity evicts the statements
+    c:set_capacity(0)
+    assert.equal(c:size(), 0)
+    assert.equal(c:pop_closes(), {
+        s1.name,
+        s3.name,
+    })
+    assert.equal(c:stats().evictions, 3)
+end
+
+function testcase.remove()
+    local c = new_stmtcache(2)
+    local s1 = c:get('SELECT 1')
+
+    -- test that the statement that is not prepared is not closed
+    c:remove(s1)
+    assert.equal(c:size(), 0)
+    assert.equal(c:pop_closes(), {})
+
+    -- test that the prepared statement is closed
+    s1 = c:get('SELECT 1')
+    s1.prepared = true
+    c:remove(s1)
+    assert.equal(c:pop_closes(), {
+        s1.name,
+    })
+
+    -- test that remove the statement that is not cached
+    c:remove(s1)
+    assert.equal(c:pop_closes(), {})
+end
+
+function testcase.clear()
+    local c = new_stmtcache(2)
+    local s1 = c:get('SELECT 1')
+    local s2 = c:get('SELECT 2')
+
+    -- test that clear all statements and close them
+    c:clear()
+    assert.equal(c:size(), 0)
+    assert.equal(c:pop_closes(), {
+        s1.name,
+        s2.name,
+    })
+
+    -- test that clear all statements without closing them
+    c:get('SELECT 1')
+    c:clear(true)
+    assert.equal(c:size(), 0)
+    assert.equal(c:pop_closes(), {})
+end
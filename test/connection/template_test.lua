@@ -0,0 +1,49 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local template = require('postgres.connection.template')
+
+function testcase.new()
+    -- test that parse the placeholders in order of first appearance
+    local tmpl = template.new('SELECT ${foo}, ${bar}, ${foo} FROM t')
+    assert.match(tmpl, '^postgres%.connection%.template: ', false)
+    assert.equal(tmpl.query, 'SELECT ${foo}, ${bar}, ${foo} FROM t')
+    assert.equal(tmpl.names, {
+        'foo',
+        'bar',
+    })
+
+    -- test that no names if the query has no placeholders
+    tmpl = template.new('SELECT 1')
+    assert.equal(tmpl.names, {})
+
+    -- test that throws an error if query is not string
+    local err = assert.throws(template.new, 1)
+    assert.match(err, 'query must be string')
+end
+
+function testcase.sql()
+    local tmpl = template.new('SELECT ${foo}, ${bar}, ${foo}')
+
+    -- test that replace the placeholders with the positional parameters
+    assert.equal(tmpl:sql(0), 'SELECT $1, $2, $1')
+
+    -- test that number the parameters after the positional parameters
+    assert.equal(tmpl:sql(2), 'SELECT $3, $4, $3')
+
+    -- test that return the query as is if no placeholders
+    assert.equal(template.new('SELECT $1'):sql(1), 'SELECT $1')
+end
+
+function testcase.get()
+    template.clear_cache()
+
+    -- test that return the cached template of the query
+    local tmpl = template.get('SELECT ${foo}')
+    assert.is_true(template.get('SELECT ${foo}') == tmpl)
+    assert.is_false(template.get('SELECT ${bar}') == tmpl)
+
+    -- test that clear the cached templates
+    template.clear_cache()
+    assert.is_false(template.get('SELECT ${foo}') == tmpl)
+end
@@ -2,6 +2,7 @@ require('luacov')
 local testcase = require('testcase')
 local assert = require('assert')
 local new_connection = require('postgres.connection').new
+local parse_conninfo = require('postgres.conninfo')
 
 function testcase.new()
     -- test that create new connection
@@ -13,6 +14,79 @@ function testcase.new()
     assert.match(c, '^postgres%.connection: ', false)
 end
 
+function testcase.new_nonblock()
+    -- test that the connection yields the running coroutine instead of
+    -- blocking in non-blocking mode
+    local fds = {}
+    local co = coroutine.create(function()
+        local c = assert(new_connection(nil, true))
+        assert.is_true(c:is_nonblock())
+        fds[#fds + 1] = c:fd()
+        local res = assert(c:query('SELECT 1 AS a'))
+        assert.equal(res.type, 'RowDescription')
+        local rows = res:get_rows()
+        assert.is_true(rows:next())
+        assert.equal(rows:scan_row(), {
+            1,
+        })
+        assert.is_false(rows:next())
+        assert(c:wait_ready())
+        assert(c:close())
+        return 'done'
+    end)
+
+    local nyield = 0
+    while true do
+        local ok, fd, want = coroutine.resume(co)
+        assert(ok, fd)
+        if coroutine.status(co) == 'dead' then
+            assert.equal(fd, 'done')
+            break
+        end
+        nyield = nyield + 1
+        assert.is_int(fd)
+        assert(want == 'read' or want == 'write')
+    end
+    assert.greater(nyield, 0)
+    assert.is_int(fds[1])
+
+    -- test that the connection is in blocking mode by default
+    local c = assert(new_connection())
+    assert.is_false(c:is_nonblock())
+    assert.is_int(c:fd())
+    c:close()
+    assert.is_nil(c:fd())
+end
+
+function testcase.new_multi_host()
+    local info = assert(parse_conninfo(''))
+    local conninfo = string.format('postgres://127.0.0.1:1,%s:%s/%s?user=%s',
+                                   info.host, info.port, info.dbname, info.user)
+
+    -- test that try the hosts in order and skip the unreachable host
+    local c = assert(new_connection(conninfo))
+    assert.equal(c:get_host().port, info.port)
+    assert.is_false(c:is_in_hot_standby())
+    assert.is_false(c:is_read_only())
+    c:close()
+
+    -- test that connect to the primary server
+    c = assert(new_connection(conninfo .. '&target_session_attrs=primary'))
+    assert.equal(c:get_host().port, info.port)
+    c:close()
+
+    -- test that return error if no host satisfies target_session_attrs
+    local err
+    c, err = new_connection(conninfo .. '&target_session_attrs=standby')
+    assert.is_nil(c)
+    assert.match(err, 'do not satisfy target_session_attrs "standby"')
+
+    -- test that prefer-standby falls back to the primary server
+    c = assert(new_connection(conninfo .. '&target_session_attrs=prefer-standby'))
+    assert.equal(c:get_host().port, info.port)
+    c:close()
+end
+
 function testcase.close()
     local c = assert(new_connection())
 
@@ -72,6 +146,38 @@ function testcase.replace_named_params()
         'NULL',
     })
     assert.is_nil(err)
+
+    -- test that replace scalar parameters by the compiled template
+    qry, err, newparams = c:replace_named_params('SELECT ${foo}, $1, ${foo}',
+                                                 params)
+    assert.equal(qry, 'SELECT $2, $1, $2')
+    assert.equal(newparams, {
+        'hello',
+        'foo',
+    })
+    assert.is_nil(err)
+
+    -- test that accept postgres.connection.template
+    local tmpl = require('postgres.connection.template').new(
+                     'SELECT ${baz}, ${foo}')
+    qry, err, newparams = c:replace_named_params(tmpl, {
+        foo = true,
+        baz = 1,
+    })
+    assert.equal(qry, 'SELECT $1, $2')
+    assert.equal(newparams, {
+        '1',
+        'TRUE',
+    })
+    assert.is_nil(err)
+
+    -- test that return error if parameter type is not supported
+    qry, err = c:replace_named_params('SELECT ${foo}', {
+        foo = function()
+        end,
+    })
+    assert.is_nil(qry)
+    assert.match(err, 'invalid parameter "foo": data type "function"')
 end
 
 function testcase.query()
@@ -108,6 +214,267 @@ function testcase.query()
     assert.match(rows.complete, '^postgres%.message%.command_complete: ', false)
 end
 
+function testcase.query_binary()
+    local c = assert(new_connection())
+    local decoder = assert(require('postgres.decoder').new())
+
+    -- test that request binary format for the columns that have binary decoder
+    local res, err, timeout = c:query([[
+        SELECT ${int}::integer AS int, 1.5::float8 AS float, 'foo'::text AS str,
+               '1999-12-01 13:59:59.123456+00'::timestamptz AS ts,
+               ARRAY[1, NULL, 3]::bigint[] AS arr
+    ]], {
+        int = 123,
+    }, nil, true)
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(res.fields.int.format, 'binary')
+    assert.equal(res.fields.float.format, 'binary')
+    assert.equal(res.fields.str.format, 'text')
+    assert.equal(res.fields.ts.format, 'binary')
+    assert.equal(res.fields.arr.format, 'binary')
+
+    local rows = assert(res:get_rows())
+    assert(rows:next())
+    local cols = {}
+    for _ = 1, 5 do
+        local field, val = rows:scan(decoder)
+        cols[field.name] = val
+    end
+    assert.equal(cols, {
+        int = 123,
+        float = 1.5,
+        str = 'foo',
+        ts = {
+            year = 1999,
+            month = 12,
+            day = 1,
+            hour = 13,
+            min = 59,
+            sec = 59,
+            usec = 123456,
+            tz = '+',
+            tzhour = 0,
+            tzmin = 0,
+            tzsec = 0,
+        },
+        arr = {
+            [1] = 1,
+            [3] = 3,
+        },
+    })
+    assert.is_false(rows:next())
+    assert.match(rows.complete, '^postgres%.message%.command_complete: ', false)
+
+    -- test that return ErrorResponse if failed to describe the query
+    res, err, timeout = c:query('SELECT * FROM unknown_table', nil, nil, true)
+    assert.match(res, '^postgres%.message%.error_response: ', false)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert(c:ping())
+end
+
+function testcase.query_binary_params()
+    local c = assert(new_connection())
+    local ids = {}
+    for i = 1, 10000 do
+        ids[i] = i
+    end
+
+    -- test that send parameters in binary format
+    local res, err, timeout = c:query([[
+        SELECT count(*) AS n, sum(v) AS total, ${flag} AS flag, ${name} AS name
+        FROM unnest(${ids}::bigint[]) AS v WHERE v > ${min}
+    ]], {
+        ids = ids,
+        flag = true,
+        name = 'foo',
+        min = 5000,
+    }, nil, true)
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+
+    local rows = assert(res:get_rows())
+    assert(rows:next())
+    local cols = {}
+    for _ = 1, 4 do
+        local field, val = rows:scan()
+        cols[field.name] = val
+    end
+    assert.equal(cols, {
+        n = 5000,
+        total = 37502500,
+        flag = true,
+        name = 'foo',
+    })
+    assert.is_false(rows:next())
+
+    -- test that the type of number parameter is inferred by the server
+    res = assert(c:query([[
+        SELECT repeat('a', ${n}) AS s, ${x}::numeric::text AS x
+    ]], {
+        n = 3,
+        x = 0.1,
+    }, nil, true))
+    rows = assert(res:get_rows())
+    assert(rows:next())
+    assert.equal(rows:scan_row(true), {
+        s = 'aaa',
+        x = '0.1',
+    })
+    assert(c:wait_ready())
+
+    -- test that return error if parameter is not an array table
+    res, err = c:query('SELECT ${foo}', {
+        foo = {
+            bar = 'baz',
+        },
+    }, nil, true)
+    assert.is_nil(res)
+    assert.match(err, 'non-array table')
+
+    -- test that return error if parameter type is not supported
+    res, err = c:query('SELECT ${foo}', {
+        foo = function()
+        end,
+    }, nil, true)
+    assert.is_nil(res)
+    assert.match(err, 'invalid parameter "foo": function type is not supported')
+end
+
+function testcase.stmt_cache()
+    local c = assert(new_connection())
+    c:set_stmt_cache_size(2)
+
+    local function query(qry, params)
+        local res = assert(c:query(qry, params))
+        repeat
+            local msg = assert(c:next())
+        until msg.type == 'ReadyForQuery'
+        return res
+    end
+
+    -- test that the prepared statement is reused
+    for i = 1, 3 do
+        local res = query('SELECT ${v}::int AS v', {
+            v = tostring(i),
+        })
+        assert.match(res, '^postgres%.message%.row_description: ', false)
+    end
+    assert.equal(c:stmt_cache_stats(), {
+        capacity = 2,
+        size = 1,
+        hits = 2,
+        misses = 1,
+        evictions = 0,
+    })
+
+    -- test that the least recently used statement is evicted
+    query('SELECT $1::int + 1', {
+        '1',
+    })
+    query('SELECT $1::int + 2', {
+        '1',
+    })
+    assert.equal(c:stmt_cache_stats().evictions, 1)
+    assert.equal(c:stmt_cache_stats().size, 2)
+
+    -- test that the statement is removed if the result type is changed
+    query('CREATE TEMP TABLE stmt_cache_test (a int)')
+    query('SELECT * FROM stmt_cache_test WHERE a = $1', {
+        '1',
+    })
+    query('ALTER TABLE stmt_cache_test ADD COLUMN b int')
+    local res = query('SELECT * FROM stmt_cache_test WHERE a = $1', {
+        '1',
+    })
+    assert.match(res, '^postgres%.message%.error_response: ', false)
+    assert.equal(res.code, '0A000')
+    res = query('SELECT * FROM stmt_cache_test WHERE a = $1', {
+        '1',
+    })
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    assert.equal(#res.fields, 2)
+
+    -- test that all statements are removed if they have been discarded
+    query('DEALLOCATE ALL')
+    res = query('SELECT * FROM stmt_cache_test WHERE a = $1', {
+        '1',
+    })
+    assert.match(res, '^postgres%.message%.error_response: ', false)
+    assert.equal(res.code, '26000')
+    assert.equal(c:stmt_cache_stats().size, 0)
+    res = query('SELECT * FROM stmt_cache_test WHERE a = $1', {
+        '1',
+    })
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+end
+
+function testcase.query_stats()
+    local c = assert(new_connection())
+
+    -- test that query statistics are disabled by default
+    assert.is_nil(c:query_stats())
+
+    -- test that record the query phases and bytes
+    c:set_query_stats(true)
+    local res = assert(c:query('SELECT * FROM generate_series(1, 10)'))
+    local rows = res:get_rows()
+    while rows:next() do
+        assert(rows:scan_row())
+    end
+    assert(c:wait_ready())
+    local stats, rec = c:query_stats()
+    assert.equal(stats.queries, 1)
+    assert.equal(stats.rows, 10)
+    assert.greater(stats.bytes_sent, 0)
+    assert.greater(stats.bytes_recv, 0)
+    assert.equal(rec.query, 'SELECT * FROM generate_series(1, 10)')
+    assert.equal(rec.rows, 10)
+    assert.greater_or_equal(rec.ttfb, 0)
+    assert.greater_or_equal(rec.rowdesc_time, rec.ttfb)
+    assert.greater_or_equal(rec.complete_time, rec.rowdesc_time)
+    assert.greater_or_equal(rec.total_time, rec.complete_time)
+    assert.greater(rec.decode_time, 0)
+
+    -- test that call the slow query handler if the query exceeds threshold
+    local slow = {}
+    c:set_slow_query_handler(function(r)
+        slow[#slow + 1] = r
+    end, 0.1)
+    assert(c:ping())
+    assert.equal(#slow, 0)
+    res = assert(c:query('SELECT pg_sleep(0.2)'))
+    rows = res:get_rows()
+    while rows:next() do
+    end
+    assert(c:wait_ready())
+    assert.equal(#slow, 1)
+    assert.equal(slow[1].query, 'SELECT pg_sleep(0.2)')
+    assert.greater_or_equal(slow[1].total_time, 0.2)
+    stats = c:query_stats()
+    assert.equal(stats.queries, 3)
+    assert.equal(stats.slow_queries, 1)
+
+    -- test that the label of the query that failed before sending is not
+    -- used for the next query record
+    res = assert(c:query('SELECT 1'))
+    local _, err = c:query('SELECT 2')
+    assert.match(err, 'connection is not ready')
+    while not c:wait_ready() do
+    end
+    assert(c:ping())
+    rec = select(2, c:query_stats())
+    assert.equal(rec.query, '')
+
+    -- test that disable the query statistics
+    c:set_query_stats(false)
+    assert.is_nil(c:query_stats())
+    c:close()
+end
+
 function testcase.ping()
     local c = assert(new_connection())
 
@@ -116,6 +483,16 @@ function testcase.ping()
     assert.is_true(ok)
     assert.is_nil(err)
     assert.is_nil(timeout)
+
+    -- test that recv_ping returns timeout=true if the response is not
+    -- received in time
+    assert(c:send(require('postgres.message').encode.query(
+                      'SELECT pg_sleep(0.5)')))
+    ok, err, timeout = c:recv_ping(0.1)
+    assert.is_false(ok)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    c:close()
 end
 
 function testcase.next()
@@ -142,6 +519,73 @@ function testcase.next()
     assert.is_nil(timeout)
 end
 
+function testcase.wait_notification()
+    local c = assert(new_connection())
+    local other = assert(new_connection())
+    assert(c:query('LISTEN test_channel'))
+    assert(c:wait_ready())
+
+    -- test that return timeout if no notification arrives
+    local msg, err, timeout = c:wait_notification(0.1)
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+
+    -- test that wait for the notification without the query
+    assert(other:query([[NOTIFY test_channel, 'hello']]))
+    assert(other:wait_ready())
+    msg, err, timeout = c:wait_notification(5)
+    assert.match(msg, '^postgres%.message%.notification_response: ', false)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(msg.channel, 'test_channel')
+    assert.equal(msg.payload, 'hello')
+    assert.equal(msg.pid, other:backend_pid())
+
+    -- test that the notifications received during the query are queued
+    -- without interrupting the rows
+    local res = assert(c:query([[
+        SELECT pg_notify('test_channel', 'in query'), n
+          FROM generate_series(1, 3) n
+    ]]))
+    local rows = assert(res:get_rows())
+    local n = 0
+    while rows:next() do
+        n = n + 1
+    end
+    assert.equal(n, 3)
+    assert.match(rows.complete, '^postgres%.message%.command_complete: ', false)
+
+    -- test that return an error while the query is in progress
+    msg, err = c:wait_notification(0)
+    assert.is_nil(msg)
+    assert.match(err, 'query is in progress')
+
+    assert(c:wait_ready())
+    msg = assert(c:wait_notification(0))
+    assert.equal(msg.payload, 'in query')
+    assert.is_nil(c:wait_notification(0))
+
+    -- test that the oldest notifications are dropped if the queue is full
+    assert.equal(c:dropped_notifications(), 0)
+    c:set_max_notifications(1)
+    assert(c:query([[
+        SELECT pg_notify('test_channel', n::text) FROM generate_series(1, 3) n
+    ]]))
+    assert(c:wait_ready())
+    assert.equal(c:dropped_notifications(), 2)
+    msg = assert(c:wait_notification(0))
+    assert.equal(msg.payload, '3')
+    assert.is_nil(c:wait_notification(0))
+
+    -- test that throws an error if n is invalid
+    err = assert.throws(c.set_max_notifications, c, -1)
+    assert.match(err, 'n must be a unsigned integer')
+
+    c:close()
+    other:close()
+end
+
 function testcase.set_recv_timeout()
     local c = assert(new_connection())
 
@@ -91,3 +91,110 @@ function testcase.parse_conninfo()
     assert.match(err, 'illegal character "@" found')
     assert.is_nil(conninfo)
 end
+
+function testcase.unix_socket()
+    setenv('PGHOST')
+    setenv('PGDATABASE')
+
+    -- test that a host that starts with a slash is the socket directory
+    local info, err, conninfo = parse_conninfo(
+                                    'postgres://user@%2Fvar%2Frun%2Fpostgresql:5433/dbname')
+    assert.is_nil(err)
+    assert.equal(info.host, '/var/run/postgresql')
+    assert.equal(info.socket, '/var/run/postgresql/.s.PGSQL.5433')
+    assert.match(conninfo,
+                 '^postgres://user@%%2Fvar%%2Frun%%2Fpostgresql:5433/dbname', false)
+
+    -- test that the normalized conninfo can be parsed again
+    local info2
+    info2, err = parse_conninfo(conninfo)
+    assert.is_nil(err)
+    assert.equal(info2.socket, info.socket)
+
+    -- test that the socket directory can be specified by the host parameter
+    info = assert(parse_conninfo('postgres://user@localhost/dbname?host=/tmp'))
+    assert.equal(info.socket, '/tmp/.s.PGSQL.5432')
+
+    -- test that the hostaddr parameter takes precedence over the socket
+    info = assert(parse_conninfo(
+                      'postgres://user@%2Ftmp/dbname?hostaddr=127.0.0.1'))
+    assert.is_nil(info.socket)
+
+    -- test that the socket directory can be specified by PGHOST
+    setenv('PGHOST', '/tmp')
+    info = assert(parse_conninfo(''))
+    assert.equal(info.socket, '/tmp/.s.PGSQL.5432')
+
+    -- test that the user name of the operating system is used by default
+    local user = os.getenv('USER')
+    setenv('USER', 'peer_user')
+    info = assert(parse_conninfo(''))
+    setenv('USER', user)
+    setenv('PGHOST')
+    assert.equal(info.user, 'peer_user')
+end
+
+function testcase.multi_host()
+    setenv('PGHOST')
+    setenv('PGPORT')
+    setenv('PGDATABASE')
+
+    -- test that parse the comma-separated list of hostspecs
+    local info, err, conninfo = parse_conninfo(
+                                    'postgres://user@host1:5432,host2,[::1]:5434/dbname')
+    assert.is_nil(err)
+    assert.equal(info.host, 'host1')
+    assert.equal(info.port, '5432')
+    assert.equal(info.hosts, {
+        {
+            host = 'host1',
+            port = '5432',
+        },
+        {
+            host = 'host2',
+            port = '5432',
+        },
+        {
+            host = '::1',
+            port = '5434',
+        },
+    })
+    assert.match(conninfo,
+                 '^postgres://user@host1:5432,host2:5432,%[::1%]:5434/dbname',
+                 false)
+
+    -- test that the normalized conninfo can be parsed again
+    local info2 = assert(parse_conninfo(conninfo))
+    assert.equal(info2.hosts, info.hosts)
+
+    -- test that a single port is used for all hosts
+    info = assert(parse_conninfo(
+                      'postgres://user@localhost/dbname?host=host1,host2&port=6543'))
+    assert.equal(info.hosts[1].port, '6543')
+    assert.equal(info.hosts[2].port, '6543')
+
+    -- test that return error if the number of ports does not match
+    info, err = parse_conninfo(
+                    'postgres://user@localhost/dbname?host=a,b,c&port=1,2')
+    assert.is_nil(info)
+    assert.match(err, 'could not match 2 port numbers to 3 hosts')
+
+    -- test that hostaddr is paired with the hosts
+    info = assert(parse_conninfo(
+                      'postgres://user@a,b/dbname?hostaddr=10.0.0.1,10.0.0.2'))
+    assert.equal(info.hosts[2].hostaddr, '10.0.0.2')
+    info, err = parse_conninfo('postgres://user@a,b/dbname?hostaddr=10.0.0.1')
+    assert.is_nil(info)
+    assert.match(err, 'could not match 2 host names to 1 hostaddr values')
+
+    -- test that return error if target_session_attrs or load_balance_hosts is
+    -- invalid
+    info, err = parse_conninfo(
+                    'postgres://user@a,b/dbname?target_session_attrs=foo')
+    assert.is_nil(info)
+    assert.match(err, 'invalid target_session_attrs value: "foo"')
+    info, err = parse_conninfo(
+                    'postgres://user@a,b/dbname?load_balance_hosts=foo')
+    assert.is_nil(info)
+    assert.match(err, 'invalid load_balance_hosts value: "foo"')
+end
@@ -0,0 +1,157 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local new_connection = require('postgres.connection').new
+
+local function exec(c, qry)
+    local res = assert(c:query(qry))
+    assert.not_equal(res.type, 'ErrorResponse')
+    repeat
+        res = assert(c:next())
+    until res.type == 'ReadyForQuery'
+end
+
+function testcase.writer()
+    local c = assert(new_connection())
+    exec(c, 'CREATE TEMP TABLE copy_test (id int, name text)')
+
+    -- test that return CopyInResponse message
+    local res = assert(c:query('COPY copy_test FROM STDIN'))
+    assert.match(res, '^postgres%.message%.copy_response: ', false)
+    assert.equal(res.type, 'CopyInResponse')
+    assert.equal(res.format, 'text')
+    assert.is_nil(res:get_reader())
+
+    -- test that write rows and chunks
+    local w = assert(res:get_writer(16))
+    assert.match(w, '^postgres%.copy%.writer: ', false)
+    for i = 1, 100 do
+        assert(w:write_row({
+            i,
+            i % 2 == 0 and 'foo\tbar\n' or nil,
+        }))
+    end
+    assert(w:write('101\tbaz\n'))
+    local ok, err, timeout = w:close()
+    assert.is_true(ok)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(w.complete.tag, 'COPY')
+    assert.equal(w.complete.nrow, 101)
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that the values are escaped
+    res = assert(c:query('SELECT name FROM copy_test WHERE id IN (1, 2, 101) ORDER BY id'))
+    local rows = res:get_rows()
+    local vals = {}
+    for i = 1, 3 do
+        assert(rows:next())
+        local _, v = rows:scan()
+        vals[i] = v or 'NULL'
+    end
+    assert.equal(vals, {
+        'NULL',
+        'foo\tbar\n',
+        'baz',
+    })
+    assert.is_false(rows:next())
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that abort COPY command
+    res = assert(c:query('COPY copy_test FROM STDIN (FORMAT csv)'))
+    w = assert(res:get_writer())
+    assert(w:write('200,"qux"\n'))
+    ok, err = w:abort('cancelled by client')
+    assert.is_true(ok)
+    assert.is_nil(err)
+    assert.match(w.error, 'cancelled by client')
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that write rows in binary format
+    res = assert(c:query('COPY copy_test FROM STDIN (FORMAT binary)'))
+    assert.equal(res.format, 'binary')
+    w = assert(res:get_writer())
+    assert(w:write_row({
+        '\0\0\1\44', -- 300
+        'qux',
+    }))
+    assert(w:close())
+    assert.equal(w.complete.nrow, 1)
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that write the header with the first valid row if the first row
+    -- is invalid
+    res = assert(c:query('COPY copy_test FROM STDIN (FORMAT binary)'))
+    w = assert(res:get_writer())
+    ok, err = w:write_row({
+        300,
+        'qux',
+    })
+    assert.is_false(ok)
+    assert.match(err, 'column#1 must be string or nil')
+    assert(w:write_row({
+        '\0\0\1\44', -- 300
+        'qux',
+    }))
+    assert(w:close())
+    assert.equal(w.complete.nrow, 1)
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that write the header and trailer without rows in binary format
+    res = assert(c:query('COPY copy_test FROM STDIN (FORMAT binary)'))
+    w = assert(res:get_writer())
+    assert(w:close())
+    assert.equal(w.complete.nrow, 0)
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that return error if data is invalid
+    res = assert(c:query('COPY copy_test FROM STDIN'))
+    w = assert(res:get_writer())
+    assert(w:write('foo\tbar\n'))
+    ok, err = w:close()
+    assert.is_false(ok)
+    assert.match(err, 'invalid input syntax')
+    assert.equal(c:next().type, 'ReadyForQuery')
+end
+
+function testcase.reader()
+    local c = assert(new_connection())
+
+    -- test that return CopyOutResponse message
+    local res = assert(c:query(
+                           'COPY (SELECT generate_series(1, 3), 1) TO STDOUT (FORMAT csv)'))
+    assert.match(res, '^postgres%.message%.copy_response: ', false)
+    assert.equal(res.type, 'CopyOutResponse')
+    assert.is_nil(res:get_writer())
+
+    -- test that read the data
+    local r = assert(res:get_reader())
+    assert.match(r, '^postgres%.copy%.reader: ', false)
+    local data = {}
+    while true do
+        local s, err, timeout = r:read()
+        assert.is_nil(err)
+        assert.is_nil(timeout)
+        if not s then
+            break
+        end
+        data[#data + 1] = s
+    end
+    assert.equal(data, {
+        '1,1\n',
+        '2,1\n',
+        '3,1\n',
+    })
+    assert.equal(r.complete.nrow, 3)
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that close discards the remaining data
+    res = assert(c:query('COPY (SELECT generate_series(1, 1000)) TO STDOUT'))
+    r = assert(res:get_reader())
+    assert(r:read())
+    local ok, err, timeout = r:close()
+    assert.is_true(ok)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(c:next().type, 'ReadyForQuery')
+end
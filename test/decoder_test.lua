@@ -31,6 +31,87 @@ function testcase.no_decode()
     assert.equal(v, 'hello')
 end
 
+function testcase.decode_by_field()
+    local decoder = assert(new_decoder())
+
+    -- test that decode text format value by type oid
+    local v, err = decoder:decode_by_field({
+        type_oid = 23,
+        format = 'text',
+    }, '123')
+    assert.is_nil(err)
+    assert.equal(v, 123)
+
+    -- test that decode binary format value by type oid
+    v, err = decoder:decode_by_field({
+        type_oid = 23,
+        format = 'binary',
+    }, '\0\0\0\123')
+    assert.is_nil(err)
+    assert.equal(v, 123)
+
+    -- test that return binary format value as is if no binary decoder
+    v, err = decoder:decode_by_field({
+        type_oid = 25,
+        format = 'binary',
+    }, 'hello')
+    assert.is_nil(err)
+    assert.equal(v, 'hello')
+end
+
+function testcase.get_decodefn()
+    local decoder = assert(new_decoder())
+
+    -- test that return decode function of text format
+    local decodefn = assert(decoder:get_decodefn({
+        type_oid = 23,
+        format = 'text',
+    }))
+    assert.equal(decodefn('123'), 123)
+
+    -- test that return decode function of binary format
+    decodefn = assert(decoder:get_decodefn({
+        type_oid = 23,
+        format = 'binary',
+    }))
+    assert.equal(decodefn('\0\0\0\123'), 123)
+
+    -- test that return nil if no decode function
+    assert.is_nil(decoder:get_decodefn({
+        type_oid = 25,
+        format = 'binary',
+    }))
+    assert.is_nil(decoder:get_decodefn({
+        type_oid = 0,
+        format = 'text',
+    }))
+end
+
+function testcase.get_decodefn_user_registered()
+    local decoder = assert(new_decoder())
+    local has_binary = require('postgres.decoder').has_binary
+
+    -- test that the user registered decode function is used for the text
+    -- format
+    local fn = function(val)
+        return 'user:' .. val
+    end
+    decoder:register(700, 'my_float4', fn)
+    assert.is_true(decoder:get_decodefn({
+        type_oid = 700,
+        format = 'text',
+    }) == fn)
+
+    -- test that the binary format is always decoded by the binary decoder
+    assert.equal(decoder:decode_by_field({
+        type_oid = 700,
+        format = 'binary',
+    }, '\63\192\0\0'), 1.5)
+
+    -- test that the registration does not affect the result formats
+    assert.is_true(has_binary(700))
+end
+
 function testcase.decode_boolean_array()
     local decoder = assert(new_decoder())
     local c = assert(new_connection())
@@ -269,5 +269,63 @@ function testcase.encode_decode()
         123,
     })
     assert.match(err, 'values#2 must be string')
+
+    -- test that encode Bind message with result-column format codes
+    s = encode('foo', 'bar', {
+        'hello',
+    }, {
+        1,
+        0,
+    })
+    msg = assert(decode(s))
+    assert.contains(msg, {
+        consumed = #s,
+        values = {
+            'hello',
+        },
+        results = {
+            'binary',
+            'text',
+        },
+    })
+
+    -- test that throw error if result-column format code is invalid
+    err = assert.throws(encode, 'foo', 'bar', {}, {
+        1,
+        2,
+    })
+    assert.match(err, 'results#2 must be 0 or 1')
+
+    -- test that encode Bind message with parameter format codes
+    s = encode('foo', 'bar', {
+        'hello',
+        nil,
+        '\1',
+    }, nil, {
+        0,
+        0,
+        1,
+    })
+    msg = assert(decode(s))
+    assert.contains(msg, {
+        consumed = #s,
+        formats = {
+            'text',
+            'text',
+            'binary',
+        },
+        values = {
+            [1] = 'hello',
+            [2] = nil,
+            [3] = '\1',
+        },
+        results = {},
+    })
+
+    -- test that throw error if parameter format code is invalid
+    err = assert.throws(encode, 'foo', 'bar', {}, nil, {
+        2,
+    })
+    assert.match(err, 'formats#1 must be 0 or 1')
 end
 
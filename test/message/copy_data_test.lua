@@ -0,0 +1,63 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local encode = require('postgres.message').encode.copy_data
+local decode = require('postgres.message').decode.copy_data
+
+function testcase.decode()
+    -- test that decode CopyData message
+    local s = 'd' .. htonl(4 + 7) .. 'foo\tbar'
+    local msg, err, again = decode(s .. 'baz')
+    assert.match(msg, '^postgres%.message%.copy_data: ', false)
+    assert.is_nil(err)
+    assert.is_nil(again)
+    assert.contains(msg, {
+        consumed = #s,
+        type = 'CopyData',
+        data = 'foo\tbar',
+    })
+
+    -- test that decode empty CopyData message
+    msg = assert(decode('d' .. htonl(4)))
+    assert.equal(msg.data, '')
+
+    -- test that return again=true if message length is less than 1
+    msg, err, again = decode('')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if message is not CopyData message
+    msg, err, again = decode('1')
+    assert.is_nil(msg)
+    assert.match(err, 'invalid CopyData message')
+    assert.is_nil(again)
+
+    -- test that return again=true if message is not yet complete
+    msg, err, again = decode('d' .. htonl(4 + 7) .. 'foo')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if length is invalid
+    msg, err, again = decode('d' .. htonl(3))
+    assert.is_nil(msg)
+    assert.match(err, 'length must be greater than or equal to its own length')
+    assert.is_nil(again)
+end
+
+function testcase.encode_decode()
+    -- test that encode CopyData message
+    local s = encode('hello\n')
+    local msg = assert(decode(s))
+    assert.contains(msg, {
+        consumed = #s,
+        type = 'CopyData',
+        data = 'hello\n',
+    })
+
+    -- test that throws an error if data is not string
+    local err = assert.throws(encode, 1)
+    assert.match(err, 'data must be string')
+end
@@ -0,0 +1,43 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local encode = require('postgres.message').encode.copy_done
+local decode = require('postgres.message').decode.copy_done
+
+function testcase.decode()
+    -- test that return again=true if message length is less than 1
+    local msg, err, again = decode('')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if message is not CopyDone message
+    msg, err, again = decode('1')
+    assert.is_nil(msg)
+    assert.match(err, 'invalid CopyDone message')
+    assert.is_nil(again)
+
+    -- test that return again=true if message length is less than 5
+    msg, err, again = decode('c')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if message length is not 4
+    msg, err, again = decode('c' .. htonl(3))
+    assert.is_nil(msg)
+    assert.match(err, 'invalid CopyDone message')
+    assert.is_nil(again)
+end
+
+function testcase.encode_decode()
+    -- test that encode CopyDone message
+    local s = encode()
+    local msg = assert(decode(s))
+    assert.match(msg, 'postgres.message.copy_done')
+    assert.contains(msg, {
+        consumed = #s,
+        type = 'CopyDone',
+    })
+end
@@ -0,0 +1,65 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local encode = require('postgres.message').encode.copy_fail
+local decode = require('postgres.message').decode.copy_fail
+
+function testcase.decode()
+    -- test that decode CopyFail message
+    local s = 'f' .. htonl(4 + 4) .. 'foo\0'
+    local msg, err, again = decode(s)
+    assert.match(msg, '^postgres%.message%.copy_fail: ', false)
+    assert.contains(msg, {
+        consumed = #s,
+        type = 'CopyFail',
+        message = 'foo',
+    })
+    assert.is_nil(err)
+    assert.is_nil(again)
+
+    -- test that return again=true if message length is less than 1
+    msg, err, again = decode('')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if message is not CopyFail message
+    msg, err, again = decode('1')
+    assert.is_nil(msg)
+    assert.match(err, 'invalid CopyFail message')
+    assert.is_nil(again)
+
+    -- test that return again=true if message is not yet complete
+    msg, err, again = decode('f' .. htonl(4 + 4) .. 'fo')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if length is less than 5
+    msg, err, again = decode('f' .. htonl(4))
+    assert.is_nil(msg)
+    assert.match(err, 'length is not greater than 4')
+    assert.is_nil(again)
+
+    -- test that return error if message is not null-terminated
+    msg, err, again = decode('f' .. htonl(4 + 3) .. 'foo')
+    assert.is_nil(msg)
+    assert.match(err, 'insufficient to unpack the string')
+    assert.is_nil(again)
+end
+
+function testcase.encode_decode()
+    -- test that encode CopyFail message
+    local s = encode('aborted')
+    local msg = assert(decode(s))
+    assert.contains(msg, {
+        consumed = #s,
+        type = 'CopyFail',
+        message = 'aborted',
+    })
+
+    -- test that throws an error if message is not string
+    local err = assert.throws(encode)
+    assert.match(err, 'message must be string')
+end
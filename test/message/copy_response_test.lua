@@ -0,0 +1,96 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local encode = require('postgres.message').encode.copy_response
+local decode = require('postgres.message').decode.copy_response
+
+function testcase.decode()
+    -- test that decode CopyInResponse, CopyOutResponse and CopyBothResponse
+    for c, ident in pairs({
+        G = 'CopyInResponse',
+        H = 'CopyOutResponse',
+        W = 'CopyBothResponse',
+    }) do
+        local s = c .. htonl(4 + 1 + 2 + 4) .. '\1' .. htons(2) .. htons(1) ..
+                      htons(1)
+        local msg, err, again = decode(s)
+        assert.match(msg, '^postgres%.message%.copy_response: ', false)
+        assert.contains(msg, {
+            consumed = #s,
+            type = ident,
+            format = 'binary',
+            formats = {
+                'binary',
+                'binary',
+            },
+        })
+        assert.is_nil(err)
+        assert.is_nil(again)
+    end
+
+    -- test that return again=true if message length is less than 1
+    local msg, err, again = decode('')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if message is not CopyResponse message
+    msg, err, again = decode('1')
+    assert.is_nil(msg)
+    assert.match(err, 'invalid CopyResponse message')
+    assert.is_nil(again)
+
+    -- test that return again=true if message is not yet complete
+    msg, err, again = decode('G' .. htonl(4 + 1 + 2) .. '\0')
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if message has extra bytes after the format
+    -- codes
+    msg, err, again = decode('G' .. htonl(4 + 1 + 2 + 4 + 2) .. '\0' ..
+                                 htons(2) .. htons(0) .. htons(0) .. htons(0))
+    assert.is_nil(msg)
+    assert.match(err,
+                 'invalid CopyInResponse message: length 13 does not match the number of columns 2')
+    assert.is_nil(again)
+
+    -- test that return error if number of columns exceeds the message length
+    msg, err, again = decode('G' .. htonl(4 + 1 + 2 + 2) .. '\0' .. htons(2) ..
+                                 htons(0) .. htons(0))
+    assert.is_nil(msg)
+    assert.match(err, 'does not match the number of columns 2')
+    assert.is_nil(again)
+
+    -- test that return error if length is less than 7
+    msg, err, again = decode('G' .. htonl(6))
+    assert.is_nil(msg)
+    assert.match(err, 'invalid CopyInResponse message: length is not greater')
+    assert.is_nil(again)
+end
+
+function testcase.encode_decode()
+    -- test that encode CopyInResponse message
+    local s = encode('CopyInResponse', 'text', 3)
+    local msg = assert(decode(s))
+    assert.contains(msg, {
+        consumed = #s,
+        type = 'CopyInResponse',
+        format = 'text',
+        formats = {
+            'text',
+            'text',
+            'text',
+        },
+    })
+
+    -- test that throws an error if arguments are invalid
+    local err = assert.throws(encode, 'foo', 'text', 1)
+    assert.match(err, 'ident must be')
+    err = assert.throws(encode, 'CopyInResponse', 'csv', 1)
+    assert.match(err, 'format must be "text" or "binary"')
+    err = assert.throws(encode, 'CopyInResponse', 'text', -1)
+    assert.match(err, 'ncol must be unsigned integer')
+end
@@ -0,0 +1,110 @@
+require('luacov')
+local concat = table.concat
+local sub = string.sub
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local decode = require('postgres.message').decode.row_description
+
+local function field(name, table_oid, table_col, type_oid, size, modifier,
+                     format)
+    return concat({
+        name .. '\0', -- field name
+        htonl(table_oid), -- table object ID
+        htons(table_col), -- attribute number of the column
+        htonl(type_oid), -- object ID of the field's data type
+        htons(size), -- data type size
+        htonl(modifier), -- type modifier
+        htons(format), -- format code
+    })
+end
+
+function testcase.decode()
+    -- test that decode RowDescription message
+    local s = concat({
+        htons(2), -- number of fields
+        field('foo', 16384, 1, 23, 4, -1, 0),
+        field('bar', 0, 0, 25, -1, -1, 1),
+    })
+    s = 'T' .. htonl(4 + #s) .. s
+    local msg, err, again = decode(s .. 'foobarbaz')
+    assert.match(msg, '^postgres%.message%.row_description: ', false)
+    assert.is_nil(err)
+    assert.is_nil(again)
+    assert.equal(msg.consumed, #s)
+    assert.equal(msg.type, 'RowDescription')
+    assert.equal(msg.fields[1], {
+        col = 1,
+        name = 'foo',
+        table_oid = 16384,
+        table_col = 1,
+        type_oid = 23,
+        size = 4,
+        modifier = -1,
+        format = 'text',
+    })
+    assert.equal(msg.fields[2], {
+        col = 2,
+        name = 'bar',
+        table_oid = 0,
+        table_col = 0,
+        type_oid = 25,
+        size = -1,
+        modifier = -1,
+        format = 'binary',
+    })
+    assert.equal(msg.fields.foo, msg.fields[1])
+    assert.equal(msg.fields.bar, msg.fields[2])
+
+    -- test that decode RowDescription message without fields
+    msg, err, again = decode('T' .. htonl(6) .. htons(0))
+    assert.is_nil(err)
+    assert.is_nil(again)
+    assert.equal(msg.fields, {})
+
+    -- test that return again=true if message length is less than 5
+    for _, v in ipairs({
+        '',
+        'T',
+        'T' .. sub(htonl(6), 1, 3),
+    }) do
+        msg, err, again = decode(v)
+        assert.is_nil(msg)
+        assert.is_nil(err)
+        assert.is_true(again)
+    end
+
+    -- test that return error if message is not RowDescription message
+    msg, err, again = decode('D' .. htonl(6) .. htons(0))
+    assert.is_nil(msg)
+    assert.match(err, 'invalid RowDescription message')
+    assert.is_nil(again)
+
+    -- test that return error if length is less than 6
+    msg, err, again = decode('T' .. htonl(5))
+    assert.is_nil(msg)
+    assert.match(err, 'length is not greater than 5')
+    assert.is_nil(again)
+
+    -- test that return again=true if message length is not enough
+    msg, err, again = decode(sub(s, 1, #s - 1))
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(again)
+
+    -- test that return error if field name is not null-terminated
+    s = htons(1) .. 'foo'
+    msg, err, again = decode('T' .. htonl(4 + #s) .. s)
+    assert.is_nil(msg)
+    assert.match(err, 'field name is not null-terminated')
+    assert.is_nil(again)
+
+    -- test that return error if message length is not enough to decode field
+    -- attributes
+    s = htons(1) .. sub(field('foo', 0, 0, 25, -1, -1, 0), 1, -3)
+    msg, err, again = decode('T' .. htonl(4 + #s) .. s)
+    assert.is_nil(msg)
+    assert.match(err, 'message length is not enough to decode field attributes')
+    assert.is_nil(again)
+end
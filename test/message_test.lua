@@ -0,0 +1,202 @@
+require('luacov')
+local concat = table.concat
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local new_buffer = require('postgres.buffer').new
+local decode_many = require('postgres.message').decode_many
+local skip_many = require('postgres.message').skip_many
+
+local function data_row(...)
+    local s = {
+        htons(select('#', ...)),
+    }
+    for _, v in ipairs({
+        ...,
+    }) do
+        s[#s + 1] = htonl(#v)
+        s[#s + 1] = v
+    end
+    s = concat(s)
+    return 'D' .. htonl(4 + #s) .. s
+end
+
+local function row_description(name)
+    local s = concat({
+        htons(1), -- number of fields
+        name .. '\0',
+        htonl(0), -- table object ID
+        htons(0), -- attribute number of the column
+        htonl(25), -- object ID of the field's data type
+        htons(-1), -- data type size
+        htonl(-1), -- type modifier
+        htons(0), -- format code
+    })
+    return 'T' .. htonl(4 + #s) .. s
+end
+
+local function command_complete(tag)
+    return 'C' .. htonl(4 + #tag + 1) .. tag .. '\0'
+end
+
+function testcase.decode_many()
+    local s = concat({
+        row_description('foo'),
+        data_row('hello'),
+        data_row('world'),
+        command_complete('SELECT 2'),
+    })
+
+    -- test that decode all complete messages
+    local msgs, pos = decode_many(s .. 'Z' .. htonl(5))
+    assert.equal(#msgs, 4)
+    assert.equal(pos, #s + 1)
+    assert.match(msgs[1], '^postgres%.message%.row_description: ', false)
+    assert.equal(msgs[1].type, 'RowDescription')
+    assert.equal(msgs[1].fields.foo.type_oid, 25)
+    assert.match(msgs[2], '^postgres%.message%.data_row: ', false)
+    assert.equal(msgs[2].type, 'DataRow')
+    assert.equal(msgs[2].values, {
+        'hello',
+    })
+    assert.equal(msgs[3].values, {
+        'world',
+    })
+    assert.equal(msgs[4].type, 'CommandComplete')
+    assert.equal(msgs[4].tag, 'SELECT')
+    assert.equal(msgs[4].nrow, 2)
+
+    -- test that decode messages from the offset
+    msgs, pos = decode_many(s, #row_description('foo') + 1)
+    assert.equal(#msgs, 3)
+    assert.equal(msgs[1].type, 'DataRow')
+    assert.equal(pos, #s + 1)
+
+    -- test that decode messages up to the limit
+    msgs, pos = decode_many(s, nil, 2)
+    assert.equal(#msgs, 2)
+    assert.equal(pos, #row_description('foo') + #data_row('hello') + 1)
+
+    -- test that decode the column values of DataRow lazily
+    msgs, pos = decode_many(s .. data_row('foo', 'bar'), nil, nil, true)
+    assert.equal(#msgs, 5)
+    assert.equal(msgs[2].type, 'DataRow')
+    assert.match(msgs[2].values, '^postgres%.data_row: ', false)
+    assert.equal(#msgs[2].values, 1)
+    assert.equal(msgs[2].values[1], 'hello')
+    assert.is_nil(msgs[2].values[2])
+    assert.equal(msgs[3].values[1], 'world')
+    assert.equal(#msgs[5].values, 2)
+    assert.equal(msgs[5].values[1], 'foo')
+    assert.equal(msgs[5].values[2], 'bar')
+
+    -- test that return empty array if there is no complete message
+    msgs, pos = decode_many('D' .. htonl(100))
+    assert.equal(msgs, {})
+    assert.equal(pos, 1)
+
+    -- test that decode messages in the postgres.buffer
+    local buf = new_buffer()
+    buf:write(s)
+    msgs, pos = decode_many(buf)
+    assert.equal(#msgs, 4)
+    assert.equal(pos, #s + 1)
+    assert.equal(buf:consume(pos - 1), #s)
+
+    -- test that return error if message is invalid
+    local err
+    msgs, err = decode_many(s .. 'D' .. htonl(5) .. 'x')
+    assert.is_nil(msgs)
+    assert.match(err, 'invalid DataRow message: length is not greater than 5')
+
+    -- test that return NULL column value as nil and error of the lazy DataRow
+    msgs = assert(decode_many('D' .. htonl(15) .. htons(2) .. htonl(-1) ..
+                                  htonl(1) .. 'x', nil, nil, true))
+    assert.is_nil(msgs[1].values[1])
+    assert.equal(msgs[1].values[2], 'x')
+    -- test that return nil for the non-integral column number
+    assert.is_nil(msgs[1].values[1.5])
+    assert.is_nil(msgs[1].values['2'])
+    msgs, err = decode_many('D' .. htonl(11) .. htons(1) .. htonl(2) .. 'x',
+                            nil, nil, true)
+    assert.is_nil(msgs)
+    assert.match(err,
+                 'invalid DataRow message: message length is not enough to decode column values')
+
+    -- test that return error if message type is unknown
+    msgs, err = decode_many(s .. 'x' .. htonl(4))
+    assert.is_nil(msgs)
+    assert.match(err, "unknown message type 'x'")
+
+    -- test that return error if message length is invalid
+    msgs, err = decode_many('D' .. htonl(3))
+    assert.is_nil(msgs)
+    assert.match(err, 'length must be greater than or equal to its own length')
+
+    -- test that decode CopyData messages natively
+    msgs, pos = decode_many(concat({
+        'd' .. htonl(4 + 4) .. 'foo\n',
+        'd' .. htonl(4),
+        'c' .. htonl(4),
+    }))
+    assert.equal(#msgs, 3)
+    assert.equal(pos, 9 + 5 + 5 + 1)
+    assert.match(msgs[1], '^postgres%.message%.copy_data: ', false)
+    assert.contains(msgs[1], {
+        type = 'CopyData',
+        data = 'foo\n',
+    })
+    assert.equal(msgs[2].data, '')
+    assert.equal(msgs[3].type, 'CopyDone')
+
+    -- test that throws an error if limit is invalid
+    err = assert.throws(decode_many, s, 1, 0)
+    assert.match(err, 'limit must be greater than 0')
+end
+
+function testcase.skip_many()
+    local rows = concat({
+        data_row('hello'),
+        data_row('world'),
+    })
+    local s = concat({
+        row_description('foo'),
+        rows,
+        command_complete('SELECT 2'),
+    })
+
+    -- test that skip the consecutive DataRow messages from the offset
+    local n, pos = skip_many('D', s, #row_description('foo') + 1)
+    assert.equal(n, 2)
+    assert.equal(pos, #row_description('foo') + #rows + 1)
+    local msgs = assert(decode_many(s, pos))
+    assert.equal(#msgs, 1)
+    assert.equal(msgs[1].type, 'CommandComplete')
+
+    -- test that return 0 if the first message is not of the type
+    n, pos = skip_many('D', s)
+    assert.equal(n, 0)
+    assert.equal(pos, 1)
+
+    -- test that stop at the incomplete message
+    n, pos = skip_many('D', rows .. 'D' .. htonl(100))
+    assert.equal(n, 2)
+    assert.equal(pos, #rows + 1)
+
+    -- test that stop at the message with the invalid length
+    n, pos = skip_many('D', rows .. 'D' .. htonl(3))
+    assert.equal(n, 2)
+    assert.equal(pos, #rows + 1)
+
+    -- test that skip messages in the postgres.buffer
+    local buf = new_buffer()
+    buf:write(rows)
+    n, pos = skip_many('D', buf)
+    assert.equal(n, 2)
+    assert.equal(buf:consume(pos - 1), #rows)
+
+    -- test that throws an error if type is invalid
+    local err = assert.throws(skip_many, 'DC', s)
+    assert.match(err, 'type must be a single character')
+end
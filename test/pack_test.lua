@@ -0,0 +1,82 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local htonl = require('postgres.htonl')
+local htons = require('postgres.htons')
+local new_pack = require('postgres.pack').new
+
+function testcase.new()
+    -- test that create new pack
+    local p = new_pack()
+    assert.match(p, '^postgres%.pack: ', false)
+    assert.equal(#p, 0)
+    assert.equal(p:len(), 0)
+    assert.equal(p:data(), '')
+end
+
+function testcase.append()
+    local p = new_pack()
+
+    -- test that append typed values in network byte order
+    assert.equal(p:int16(-2):int32(70000):cstring('foo'):bytes('bar'), p)
+    assert.equal(p:data(),
+                 htons(-2) .. htonl(70000) .. 'foo\0' .. 'bar')
+    assert.equal(#p, 2 + 4 + 4 + 3)
+
+    -- test that throws an error if value is out of range
+    local err = assert.throws(p.int16, p, 0x8000)
+    assert.match(err, 'int16')
+    err = assert.throws(p.int32, p, 0x80000000)
+    assert.match(err, 'int32')
+
+    -- test that throws an error if cstring contains the null character
+    err = assert.throws(p.cstring, p, 'foo\0bar')
+    assert.match(err, 'must not contain the null character')
+
+    -- test that discard the packed data
+    assert.equal(p:clear(), p)
+    assert.equal(p:data(), '')
+end
+
+function testcase.begin_finish()
+    local p = new_pack()
+
+    -- test that back-patch the length of the message
+    p:begin('E'):cstring('portal'):int32(0):finish()
+    p:begin('S'):finish()
+    assert.equal(p:data(), 'E' .. htonl(4 + 7 + 4) .. 'portal\0' ..
+                     htonl(0) .. 'S' .. htonl(4))
+
+    -- test that throws an error if the message is not finished
+    p:begin('H')
+    local err = assert.throws(p.data, p)
+    assert.match(err, "message 'H' is not finished")
+    err = assert.throws(p.begin, p, 'S')
+    assert.match(err, "message 'H' is not finished")
+    p:finish()
+
+    -- test that throws an error if no message is started
+    err = assert.throws(p.finish, p)
+    assert.match(err, 'no message to finish')
+
+    -- test that throws an error if type is not a single character
+    err = assert.throws(p.begin, p, 'SS')
+    assert.match(err, 'type must be a single character')
+
+    -- test that clear discards the unfinished message
+    p:begin('P'):clear()
+    assert.equal(p:begin('S'):finish():data(), 'S' .. htonl(4))
+end
+
+function testcase.large_data()
+    local p = new_pack()
+    local s = string.rep('x', 100000)
+
+    -- test that data is not corrupted while the buffer is grown
+    p:begin('d'):bytes(s):bytes(s):finish()
+    assert.equal(p:data(), 'd' .. htonl(4 + 200000) .. s .. s)
+
+    -- test that the large buffer is released by clear
+    p:clear()
+    assert.equal(p:begin('c'):finish():data(), 'c' .. htonl(4))
+end
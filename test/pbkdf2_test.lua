@@ -0,0 +1,44 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local pbkdf2 = require('postgres.pbkdf2')
+
+--- tohex
+--- @param s string
+--- @return string
+local function tohex(s)
+    return (string.gsub(s, '.', function(c)
+        return string.format('%02x', string.byte(c))
+    end))
+end
+
+function testcase.pbkdf2()
+    -- test that derive the key with PBKDF2-HMAC-SHA-256
+    for _, v in ipairs({
+        {
+            pswd = 'password',
+            salt = 'salt',
+            niter = 1,
+            exp = '120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b',
+        },
+        {
+            pswd = 'password',
+            salt = 'salt',
+            niter = 4096,
+            exp = 'c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a',
+        },
+        -- password that is longer than the block size
+        {
+            pswd = string.rep('k', 100),
+            salt = string.rep('s', 70),
+            niter = 3,
+            exp = '30840d1cd1869d520bed71b5ec0596c01d66cf8eec8fe36cbb94ceaa1fb9aebd',
+        },
+    }) do
+        assert.equal(tohex(pbkdf2(v.pswd, v.salt, v.niter)), v.exp)
+    end
+
+    -- test that throws an error if iteration count is not greater than 0
+    local err = assert.throws(pbkdf2, 'password', 'salt', 0)
+    assert.match(err, 'iteration count must be greater than 0')
+end
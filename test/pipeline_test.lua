@@ -0,0 +1,200 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local new_connection = require('postgres.connection').new
+
+function testcase.add()
+    local c = assert(new_connection())
+    local pl = c:pipeline()
+    assert.match(pl, '^postgres%.pipeline: ', false)
+
+    -- test that queue queries
+    assert.equal(pl:add('SELECT 1'), 1)
+    assert.equal(pl:add('SELECT ${v}::int', {
+        v = 2,
+    }), 2)
+    assert.equal(pl:size(), 2)
+
+    -- test that return error if params are invalid
+    local idx, err = pl:add('SELECT ${v}', {
+        v = function()
+        end,
+    })
+    assert.is_nil(idx)
+    assert.match(err, 'invalid parameter "v"')
+    assert.equal(pl:size(), 2)
+
+    -- test that return error if pipeline has already been synced
+    assert(pl:sync())
+    idx, err = pl:add('SELECT 3')
+    assert.is_nil(idx)
+    assert.match(err, 'pipeline has already been synced')
+    assert(pl:close())
+end
+
+function testcase.next()
+    local c = assert(new_connection())
+    local pl = c:pipeline()
+    pl:add('CREATE TEMP TABLE pipeline_test (v int)')
+    pl:add('INSERT INTO pipeline_test VALUES (${a}), (${b})', {
+        a = 1,
+        b = 2,
+    })
+    pl:add('SELECT v FROM pipeline_test ORDER BY v')
+    pl:add('SELECT 1')
+    pl:add('')
+
+    -- test that return error if pipeline is not synced
+    local res, err = pl:next()
+    assert.is_nil(res)
+    assert.match(err, 'pipeline is not synced')
+
+    -- test that retrieve the results in order
+    assert(pl:sync())
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.command_complete: ', false)
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.command_complete: ', false)
+    assert.equal(res.tag, 'INSERT')
+    assert.equal(res.nrow, 2)
+
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    local rows = assert(res:get_rows())
+    local vals = {}
+    while rows:next() do
+        local _, v = rows:scan()
+        vals[#vals + 1] = v
+    end
+    assert.equal(vals, {
+        1,
+        2,
+    })
+
+    -- test that the remaining rows are discarded
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.empty_query_response: ', false)
+
+    -- test that return nil after all results are retrieved
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.is_nil(err)
+    assert.equal(c:status(), 'idle')
+end
+
+function testcase.next_with_error()
+    local c = assert(new_connection())
+    local pl = c:pipeline()
+    pl:add('SELECT 1')
+    pl:add('SELECT * FROM unknown_table')
+    pl:add('SELECT 3')
+    assert(pl:sync())
+
+    -- test that the subsequent queries are not executed after an error
+    local res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.error_response: ', false)
+    local err
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.match(err, 'query#3 was not executed due to the previous error')
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.is_nil(err)
+
+    -- test that connection can be used after the pipeline
+    assert(c:ping())
+end
+
+function testcase.next_with_error_after_rows()
+    local c = assert(new_connection())
+    local pl = c:pipeline()
+    pl:add('SELECT * FROM generate_series(1, 3)')
+    pl:add('SELEC 2')
+    pl:add('SELECT 3')
+    assert(pl:sync())
+
+    -- test that the error of the next query is returned after the rows
+    -- object has retrieved the CommandComplete message
+    local res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    local rows = assert(res:get_rows())
+    local n = 0
+    while rows:next() do
+        n = n + 1
+    end
+    assert.equal(n, 3)
+    assert.match(rows.complete, '^postgres%.message%.command_complete: ',
+                 false)
+
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.error_response: ', false)
+    assert.match(res.message, 'syntax error')
+    local err
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.match(err, 'query#3 was not executed due to the previous error')
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.is_nil(err)
+
+    -- test that connection can be used after the pipeline
+    assert(c:ping())
+end
+
+function testcase.next_with_error_in_rows()
+    local c = assert(new_connection())
+    local pl = c:pipeline()
+    pl:add('SELECT 10 / (3 - i) FROM generate_series(1, 5) AS i')
+    pl:add('SELECT 2')
+    assert(pl:sync())
+
+    -- test that the error of the query that failed partway through its rows
+    -- is returned even if the rows are skipped
+    local res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.error_response: ', false)
+    assert.match(res.message, 'division by zero')
+    local err
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.match(err, 'query#2 was not executed due to the previous error')
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.is_nil(err)
+
+    -- test that the error of the last query is returned
+    pl = c:pipeline()
+    pl:add('SELECT 10 / (3 - i) FROM generate_series(1, 5) AS i')
+    assert(pl:sync())
+    res = assert(pl:next())
+    assert.match(res, '^postgres%.message%.row_description: ', false)
+    res = assert(pl:next())
+    assert.match(res.message, 'division by zero')
+    res, err = pl:next()
+    assert.is_nil(res)
+    assert.is_nil(err)
+
+    -- test that connection can be used after the pipeline
+    assert(c:ping())
+end
+
+function testcase.close()
+    local c = assert(new_connection())
+    local pl = c:pipeline()
+    pl:add('SELECT generate_series(1, 10)')
+    pl:add('SELECT generate_series(1, 10)')
+    assert(pl:sync())
+    assert(pl:next())
+
+    -- test that discard the remaining results
+    local ok, err, timeout = pl:close()
+    assert.is_true(ok)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert(c:ping())
+end
@@ -0,0 +1,108 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local new_stats = require('postgres.pool.stats').new
+
+function testcase.new()
+    -- test that create new stats with zero counters
+    local s = new_stats()
+    local snapshot = s:snapshot()
+    assert.equal(snapshot.hits, 0)
+    assert.equal(snapshot.misses, 0)
+    assert.equal(snapshot.connect_errors, 0)
+    assert.equal(snapshot.connect.count, 0)
+    assert.equal(snapshot.wait.count, 0)
+    assert.equal(#snapshot.connect.counts, #snapshot.bounds)
+    assert.equal(snapshot.evictions, {
+        dead = 0,
+        lifetime = 0,
+        maxidle = 0,
+        maxconn = 0,
+    })
+    assert.equal(snapshot.conninfo, {})
+end
+
+function testcase.hit_and_connect()
+    local s = new_stats()
+
+    -- test that count hits and new connections per conninfo
+    s:hit('foo')
+    s:hit('foo')
+    s:connect('foo', 0.002, true)
+    s:connect('bar', 0.2, true)
+    s:connect('bar', 0.3, false)
+    local snapshot = s:snapshot()
+    assert.equal(snapshot.hits, 2)
+    assert.equal(snapshot.misses, 2)
+    assert.equal(snapshot.connect_errors, 1)
+    assert.equal(snapshot.conninfo.foo.hits, 2)
+    assert.equal(snapshot.conninfo.foo.misses, 1)
+    assert.equal(snapshot.conninfo.bar.hits, 0)
+    assert.equal(snapshot.conninfo.bar.misses, 1)
+    assert.equal(snapshot.conninfo.bar.connect_errors, 1)
+
+    -- test that the durations are observed into the buckets
+    local connect = snapshot.connect
+    assert.equal(connect.count, 2)
+    assert.equal(connect.sum, 0.202)
+    assert.equal(connect.max, 0.2)
+    for i, bound in ipairs(snapshot.bounds) do
+        if bound == 0.005 or bound == 0.5 then
+            assert.equal(connect.counts[i], 1)
+        else
+            assert.equal(connect.counts[i], 0)
+        end
+    end
+end
+
+function testcase.wait()
+    local s = new_stats()
+
+    -- test that wait durations are observed
+    s:wait('foo', 0)
+    s:wait('foo', 100)
+    local snapshot = s:snapshot()
+    assert.equal(snapshot.wait.count, 2)
+    assert.equal(snapshot.wait.counts[1], 1)
+    assert.equal(snapshot.wait.counts[#snapshot.bounds], 1)
+    assert.equal(snapshot.conninfo.foo.wait.count, 2)
+end
+
+function testcase.evict()
+    local s = new_stats()
+
+    -- test that count evictions by reason
+    s:evict('foo', 'dead')
+    s:evict('foo', 'lifetime')
+    s:evict('bar', 'maxidle')
+    s:evict('bar', 'maxidle')
+    local snapshot = s:snapshot()
+    assert.equal(snapshot.evictions, {
+        dead = 1,
+        lifetime = 1,
+        maxidle = 2,
+        maxconn = 0,
+    })
+    assert.equal(snapshot.conninfo.bar.evictions.maxidle, 2)
+
+    -- test that throws an error if reason is unknown
+    local err = assert.throws(s.evict, s, 'foo', 'unknown')
+    assert.match(err, 'unknown eviction reason')
+end
+
+function testcase.snapshot_and_reset()
+    local s = new_stats()
+    s:hit('foo')
+
+    -- test that snapshot is a copy of the counters
+    local snapshot = s:snapshot()
+    s:hit('foo')
+    assert.equal(snapshot.hits, 1)
+    assert.equal(snapshot.conninfo.foo.hits, 1)
+
+    -- test that reset clears all counters
+    s:reset()
+    snapshot = s:snapshot()
+    assert.equal(snapshot.hits, 0)
+    assert.equal(snapshot.conninfo, {})
+end
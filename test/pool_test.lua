@@ -1,6 +1,7 @@
 require('luacov')
 local testcase = require('testcase')
 local assert = require('assert')
+local gettime = require('time.clock').gettime
 local new_pool = require('postgres.pool').new
 
 function testcase.new()
@@ -33,6 +34,15 @@ function testcase.new()
     -- test that throws an error if chkintvl argument is not number
     err = assert.throws(new_pool, nil, nil, 0 / 0)
     assert.match(err, 'chkintvl must be positive number or nil')
+
+    -- test that throws an error if minidle argument is greater than maxidle
+    err = assert.throws(new_pool, 3, 1, nil, 2)
+    assert.match(err,
+                 'minidle must be nil or number less than or equal to maxidle')
+
+    -- test that throws an error if maxlife argument is not positive number
+    err = assert.throws(new_pool, nil, nil, nil, nil, -1)
+    assert.match(err, 'maxlife must be positive number or nil')
 end
 
 function testcase.get()
@@ -92,6 +102,168 @@ function testcase.get()
     assert.is_nil(again)
 end
 
+function testcase.get_with_timeout()
+    local pool = assert(new_pool(1, 1))
+    local conn = assert(pool:get())
+
+    -- test that return again=true immediately in the main thread
+    local c, err, again, timeout = pool:get(nil, 1)
+    assert.is_nil(c)
+    assert.is_nil(err)
+    assert.is_true(again)
+    assert.is_nil(timeout)
+
+    -- test that the waiter yields the running coroutine until the connection
+    -- is handed off
+    local res = {}
+    local co1 = coroutine.create(function()
+        res[1] = {
+            pool:get(nil, 10),
+        }
+    end)
+    local ok, fd, want, remain = coroutine.resume(co1)
+    assert.is_true(ok)
+    assert.is_nil(fd)
+    assert.equal(want, 'wait')
+    assert.greater(remain, 0)
+    assert.equal(pool:size_waiting(), 1)
+
+    -- test that return timeout=true if the deadline is expired
+    local co2 = coroutine.create(function()
+        res[2] = {
+            pool:get(nil, 0),
+        }
+    end)
+    assert(coroutine.resume(co2))
+    assert.equal(coroutine.status(co2), 'dead')
+    assert.equal(res[2], {
+        nil,
+        nil,
+        nil,
+        true,
+    })
+    assert.equal(pool:size_waiting(), 1)
+
+    -- test that release hands off the connection to the oldest waiter
+    assert(pool:release(conn))
+    assert.equal(pool:size_waiting(), 0)
+    assert.equal(pool:size_idle(), 0)
+    assert.equal(pool:size_used(), 1)
+    assert(coroutine.resume(co1))
+    assert.equal(coroutine.status(co1), 'dead')
+    assert.equal(res[1][1], conn)
+
+    -- test that the wait statistics are reported
+    local stats = pool:wait_stats()
+    assert.equal(stats.waiting, 0)
+    assert.equal(stats.waits, 2)
+    assert.equal(stats.handoffs, 1)
+    assert.equal(stats.timeouts, 1)
+    assert.greater_or_equal(stats.max_wait, 0)
+    assert.greater_or_equal(stats.total_wait, stats.max_wait)
+
+    -- test that the waiter gets an error if the pool is closed
+    local co3 = coroutine.create(function()
+        res[3] = {
+            pool:get(nil, 10),
+        }
+    end)
+    assert(coroutine.resume(co3))
+    pool:close()
+    assert(coroutine.resume(co3))
+    assert.is_nil(res[3][1])
+    assert.match(res[3][2], 'from closed or shutdown pool')
+
+    -- test that throws an error if timeout argument is invalid
+    err = assert.throws(pool.get, pool, nil, -1)
+    assert.match(err, 'timeout must be unsigned number or nil')
+end
+
+function testcase.get_with_timeout_per_conninfo()
+    local pool = assert(new_pool(2, 2))
+    local woken = {}
+    pool:set_wake_handler(function(co)
+        woken[#woken + 1] = co
+    end)
+    local w = assert(pool:get())
+    local r = assert(pool:get_reader())
+
+    -- test that the waiter waits in the queue of its conninfo
+    local res = {}
+    local co1 = coroutine.create(function()
+        res[1] = {
+            pool:get(nil, 10),
+        }
+    end)
+    assert(coroutine.resume(co1))
+    assert.equal(coroutine.status(co1), 'suspended')
+    assert.equal(pool:size_waiting(), 1)
+
+    -- test that release wakes the waiter for the other conninfo
+    assert(pool:release(r))
+    assert.equal(#woken, 1)
+    assert.is_true(woken[1] == co1)
+
+    -- test that the waiter for the other conninfo does not block get
+    local co2 = coroutine.create(function()
+        res[2] = {
+            pool:get_reader(nil, 10),
+        }
+    end)
+    assert(coroutine.resume(co2))
+    assert.equal(coroutine.status(co2), 'dead')
+    assert.equal(res[2][1], r)
+    assert.equal(pool:size_waiting(), 1)
+
+    -- test that release hands off the connection and wakes the waiter
+    woken = {}
+    assert(pool:release(w))
+    assert.equal(#woken, 1)
+    assert.is_true(woken[1] == co1)
+    assert(coroutine.resume(co1))
+    assert.equal(coroutine.status(co1), 'dead')
+    assert.equal(res[1][1], w)
+    pool:close()
+end
+
+function testcase.get_with_timeout_reclaim()
+    local pool = assert(new_pool(1, 1))
+    local conn = assert(pool:get())
+
+    -- test that the connection is handed off to the waiter
+    local res = {}
+    local co = coroutine.create(function()
+        res[1] = {
+            pool:get(nil, 0.01),
+        }
+    end)
+    assert(coroutine.resume(co))
+    assert(pool:release(conn))
+    assert.equal(pool:size_waiting(), 0)
+    assert.equal(pool:size_used(), 1)
+
+    -- test that the connection is reclaimed if the waiter does not take it
+    -- by the deadline
+    local t = gettime() + 0.02
+    while gettime() < t do
+    end
+    assert.equal(assert(pool:get()), conn)
+    assert.equal(pool:size(), 1)
+    assert.equal(pool:size_used(), 1)
+    assert.equal(pool:size_idle(), 0)
+
+    -- test that the abandoned waiter returns timeout=true when resumed
+    assert(coroutine.resume(co))
+    assert.equal(coroutine.status(co), 'dead')
+    assert.equal(res[1], {
+        nil,
+        nil,
+        nil,
+        true,
+    })
+    pool:close()
+end
+
 function testcase.release()
     local pool = assert(new_pool(2, 1))
     local conn1 = assert(pool:get())
@@ -148,6 +320,26 @@ function testcase.release()
     assert.is_false(conn:is_connected())
 end
 
+function testcase.get_reader()
+    local p = new_pool(4, 4)
+
+    -- test that the reader connections are pooled separately
+    local w = assert(p:get())
+    local r = assert(p:get_reader())
+    assert.not_equal(r, w)
+    assert.match(r:get_conninfo(),
+                 'load_balance_hosts=random&target_session_attrs=prefer%-standby',
+                 false)
+    assert(p:release(r))
+    assert.equal(assert(p:get_reader()), r)
+    p:close()
+
+    -- test that return error if conninfo is invalid
+    local conn, err = p:get_reader('foo://')
+    assert.is_nil(conn)
+    assert.match(err, 'scheme must be start with')
+end
+
 function testcase.evict()
     local pool = assert(new_pool(0, 3, 0))
     local conn1 = assert(pool:get())
@@ -178,3 +370,91 @@ function testcase.evict()
     assert.equal(n, 0)
     assert.is_true(timeout)
 end
+
+function testcase.maintain()
+    local pool = assert(new_pool(3, 3, 0, 2))
+
+    -- test that open new connections up to minidle
+    local nevict, nopen, err, timeout = pool:maintain()
+    assert.equal(nevict, 0)
+    assert.equal(nopen, 2)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(pool:size_idle(), 2)
+
+    -- test that pre-warmed connection is used
+    local conn = assert(pool:get())
+    assert.equal(pool:size_idle(), 1)
+    assert(pool:release(conn))
+
+    -- test that health-check idle connections and replace dead connections
+    assert(conn:close())
+    nevict, nopen = pool:maintain()
+    assert.equal(nevict, 1)
+    assert.equal(nopen, 1)
+    assert.equal(pool:size_idle(), 2)
+
+    -- test that return timeout=true if reaches timeout
+    pool:shutdown()
+    pool = assert(new_pool(3, 3, 0, 2))
+    nevict, nopen, err, timeout = pool:maintain(0)
+    assert.equal(nevict, 0)
+    assert.equal(nopen, 0)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+
+    -- test that close connections that exceed the max lifetime
+    pool = assert(new_pool(3, 3, 0, 1, 0.01))
+    assert.equal(select(2, pool:maintain()), 1)
+    conn = assert(pool:get())
+    local t = gettime() + 0.02
+    while gettime() < t do
+    end
+    assert(pool:release(conn))
+    assert.is_false(conn:is_connected())
+    assert.equal(pool:size(), 0)
+
+    -- test that return error if pool is shutdown
+    pool:shutdown()
+    nevict, nopen, err = pool:maintain()
+    assert.equal(nevict, 0)
+    assert.equal(nopen, 0)
+    assert.match(err, 'closed or shutdown pool')
+end
+
+function testcase.get_stats()
+    local pool = assert(new_pool(2, 1))
+
+    -- test that count new connections and idle hits
+    local conn1 = assert(pool:get())
+    local conn2 = assert(pool:get())
+    assert(pool:release(conn1))
+    assert(pool:release(conn2))
+    conn1 = assert(pool:get())
+    local stats = pool:get_stats()
+    assert.equal(stats.misses, 2)
+    assert.equal(stats.hits, 1)
+    assert.equal(stats.connect.count, 2)
+    assert.greater(stats.connect.sum, 0)
+    assert.equal(stats.evictions.maxidle, 1)
+
+    -- test that the counters are broken down by conninfo
+    local info = stats.conninfo[conn1:get_conninfo()]
+    assert.equal(info.misses, 2)
+    assert.equal(info.hits, 1)
+
+    -- test that count dead connections
+    assert(pool:release(conn1))
+    assert(conn1:close())
+    conn1 = assert(pool:get())
+    stats = pool:get_stats()
+    assert.equal(stats.evictions.dead, 1)
+    assert.equal(stats.misses, 3)
+
+    -- test that reset the counters
+    pool:reset_stats()
+    stats = pool:get_stats()
+    assert.equal(stats.hits, 0)
+    assert.equal(stats.misses, 0)
+    pool:close()
+end
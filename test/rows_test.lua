@@ -34,6 +34,47 @@ function testcase.next()
     assert.is_false(rows:next())
 end
 
+function testcase.next_with_max_rows()
+    local c = assert(new_connection())
+    local res = assert(c:query([[
+        SELECT generate_series(1, 10) AS v
+    ]], nil, 3))
+    local rows = assert(res:get_rows())
+
+    -- test that retrieve all rows that are fetched in chunks
+    local vals = {}
+    while rows:next() do
+        local _, v = rows:scan()
+        vals[#vals + 1] = v
+    end
+    assert.is_nil(rows.error)
+    assert.equal(vals, {
+        1,
+        2,
+        3,
+        4,
+        5,
+        6,
+        7,
+        8,
+        9,
+        10,
+    })
+    assert.match(rows.complete, '^postgres%.message%.command_complete: ', false)
+    assert.equal(c:next().type, 'ReadyForQuery')
+
+    -- test that close the portal without fetching the remaining rows
+    res = assert(c:query([[
+        SELECT generate_series(1, 10) AS v
+    ]], nil, 3))
+    rows = assert(res:get_rows())
+    assert.is_true(rows:next())
+    assert.is_true(rows:close())
+    assert.match(rows.complete, '^postgres%.message%.portal_suspended: ', false)
+    assert.equal(c:next().type, 'ReadyForQuery')
+    assert(c:ping())
+end
+
 function testcase.readat()
     local c = assert(new_connection())
     local res = assert(c:query([[
@@ -165,3 +206,148 @@ function testcase.scan()
     assert.is_nil(err)
     assert.is_nil(field)
 end
+
+function testcase.scan_with_oid_decoder()
+    local c = assert(new_connection())
+    local res = assert(c:query([[
+        SELECT 123::integer AS a, 'foo' AS b
+    ]]))
+    local rows = assert(res:get_rows())
+    assert(rows:next())
+
+    -- test that the decoder that implements only decode_by_oid can be used
+    local decoder = {
+        decode_by_oid = function(_, oid, val)
+            return oid .. ':' .. val
+        end,
+    }
+    local field, v, err = rows:scanat(1, decoder)
+    assert.is_nil(err)
+    assert.equal(field.name, 'a')
+    assert.equal(v, '23:123')
+    field, v, err = rows:scan(decoder)
+    assert.is_nil(err)
+    assert.equal(field.name, 'a')
+    assert.equal(v, '23:123')
+    assert.equal(rows:scan_row(true, decoder), {
+        a = '23:123',
+        b = '25:foo',
+    })
+
+    -- test that the binary format values are decoded by the native binary
+    -- decoders
+    res = assert(c:query([[
+        SELECT 123::integer AS a, 'foo' AS b
+    ]], nil, nil, true))
+    rows = assert(res:get_rows())
+    assert(rows:next())
+    field, v, err = rows:scanat(1, decoder)
+    assert.is_nil(err)
+    assert.equal(field.format, 'binary')
+    assert.equal(v, 123)
+    assert.equal(rows:scan_row(true, decoder), {
+        a = 123,
+        b = '25:foo',
+    })
+end
+
+function testcase.scan_into()
+    local c = assert(new_connection())
+    local res = assert(c:query([[
+        SELECT * FROM (VALUES
+            (1, 'foo', '1999-05-12'::date),
+            (2, NULL, NULL)
+        ) AS t(a, b, c)
+    ]]))
+    local rows = assert(res:get_rows())
+
+    -- test that return nil if no current row
+    assert.is_nil(rows:scan_into({}))
+
+    -- test that scan all column values into the table
+    assert(rows:next())
+    local tbl = {}
+    assert.equal(rows:scan_into(tbl), tbl)
+    assert.equal(tbl, {
+        1,
+        'foo',
+        {
+            year = 1999,
+            month = 5,
+            day = 12,
+        },
+    })
+
+    -- test that NULL values clear the previous values
+    assert(rows:next())
+    assert.equal(rows:scan_into(tbl), {
+        2,
+    })
+
+    -- test that scan into the table keyed by column names
+    assert.equal(rows:scan_into({}, true), {
+        a = 2,
+    })
+    assert.is_false(rows:next())
+end
+
+function testcase.scan_row()
+    local c = assert(new_connection())
+    local res = assert(c:query([[
+        SELECT 1 AS a, 'foo' AS b
+    ]]))
+    local rows = assert(res:get_rows())
+    assert(rows:next())
+
+    -- test that scan all column values into a new table
+    assert.equal(rows:scan_row(), {
+        1,
+        'foo',
+    })
+    assert.equal(rows:scan_row(true), {
+        a = 1,
+        b = 'foo',
+    })
+end
+
+function testcase.lazy_rows()
+    local c = assert(new_connection())
+    c:set_lazy_rows(true)
+    local res = assert(c:query([[
+        SELECT * FROM (VALUES
+            (1, 'foo', '1999-05-12'::date),
+            (2, NULL, NULL),
+            (3, 'baz', NULL)
+        ) AS t(a, b, c)
+    ]]))
+    local rows = assert(res:get_rows())
+
+    -- test that read the column values of the lazy DataRow
+    assert(rows:next())
+    assert.match(rows.row.values, '^postgres%.data_row: ', false)
+    local field, v = rows:readat('b')
+    assert.equal(field.name, 'b')
+    assert.equal(v, 'foo')
+    field, v = rows:scan()
+    assert.equal(field.name, 'a')
+    assert.equal(v, 1)
+
+    -- test that scan all column values of the lazy DataRow
+    assert(rows:next())
+    assert.equal(rows:scan_row(true), {
+        a = 2,
+    })
+
+    -- test that discard the remaining rows
+    assert(rows:close())
+
+    -- test that the values is the array of strings if disabled
+    c:set_lazy_rows(false)
+    res = assert(c:query('SELECT 1'))
+    rows = assert(res:get_rows())
+    assert(rows:next())
+    assert.equal(rows.row.values, {
+        '1',
+    })
+    assert(rows:close())
+end